@@ -9,6 +9,8 @@ import sys
 import os
 import threading
 import subprocess
+import socket
+import signal
 from pathlib import Path
 from typing import List, Optional
 import tkinter as tk
@@ -34,6 +36,8 @@ class CompressionGUI:
         # Progress tracking
         self.progress_queue = queue.Queue()
         self.is_compressing = False
+        self.current_process = None
+        self.current_job = None
         
         self.create_widgets()
         self.center_window()
@@ -57,6 +61,8 @@ class CompressionGUI:
             'threads': self.threads_var.get(),
             'concurrent_files': self.concurrent_files_var.get()
         }
+        if self.config.get('daemon_socket'):
+            config['daemon_socket'] = self.config['daemon_socket']
         
         config_file = Path(__file__).parent / "config.json"
         try:
@@ -316,6 +322,7 @@ class CompressionGUI:
     def stop_compression(self):
         """Stop the compression process"""
         self.is_compressing = False
+        self.cancel_current_job()
         self.start_button.config(state='normal')
         self.stop_button.config(state='disabled')
         self.status_label.config(text="Stopped")
@@ -338,11 +345,12 @@ class CompressionGUI:
                 output_ext = '.cso' if self.format_var.get() == 'cso' else '.chd'
                 output_file = Path(self.output_folder.get()) / f"{Path(file_path).stem}{output_ext}"
                 
-                # Build command
-                cmd = self.build_compression_command(file_path, str(output_file))
-                
-                # Execute compression
-                result = self.execute_compression(cmd)
+                # Execute compression (through the daemon when one is configured)
+                if self.config.get('daemon_socket') and hasattr(socket, 'AF_UNIX'):
+                    result = self.execute_via_daemon(file_path, str(output_file), filename)
+                else:
+                    cmd = self.build_compression_command(file_path, str(output_file))
+                    result = self.execute_compression(cmd)
                 
                 completed += 1
                 progress = (completed / total_files) * 100
@@ -374,16 +382,93 @@ class CompressionGUI:
     def execute_compression(self, cmd: List[str]) -> bool:
         """Execute the compression command"""
         try:
-            result = subprocess.run(
+            # A separate process group lets Stop send Ctrl+Break on Windows
+            flags = subprocess.CREATE_NEW_PROCESS_GROUP if os.name == 'nt' else 0
+            self.current_process = subprocess.Popen(
                 cmd,
-                capture_output=True,
-                text=True,
-                timeout=3600  # 1 hour timeout
+                stdout=subprocess.DEVNULL,
+                stderr=subprocess.DEVNULL,
+                creationflags=flags
             )
-            return result.returncode == 0
+            try:
+                return self.current_process.wait(timeout=3600) == 0  # 1 hour timeout
+            except subprocess.TimeoutExpired:
+                self.cancel_current_job()
+                self.current_process.wait()
+                return False
         except Exception as e:
             print(f"Compression error: {e}")
             return False
+        finally:
+            self.current_process = None
+    
+    def cancel_current_job(self):
+        """Ask the running compression to stop; the output stays resumable with --resume"""
+        process = self.current_process
+        if process and process.poll() is None:
+            try:
+                if os.name == 'nt':
+                    process.send_signal(signal.CTRL_BREAK_EVENT)
+                else:
+                    process.terminate()
+            except Exception as e:
+                print(f"Stop error: {e}")
+        
+        job = self.current_job
+        if job is not None:
+            try:
+                with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+                    sock.connect(self.config['daemon_socket'])
+                    sock.sendall((json.dumps({'cmd': 'cancel', 'job': job}) + '\n').encode('utf-8'))
+                    sock.recv(4096)
+            except Exception as e:
+                print(f"Stop error: {e}")
+    
+    def execute_via_daemon(self, input_file: str, output_file: str, filename: str) -> bool:
+        """Submit the job to a running daemon (--daemon) and wait for its completion"""
+        try:
+            with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+                sock.connect(self.config['daemon_socket'])
+                stream = sock.makefile('rw', encoding='utf-8')
+
+                def request(message: dict) -> dict:
+                    stream.write(json.dumps(message) + '\n')
+                    stream.flush()
+                    while True:
+                        reply = json.loads(stream.readline())
+                        if 'event' not in reply:
+                            return reply
+
+                if not request({'cmd': 'watch'}).get('ok'):
+                    return False
+                reply = request({
+                    'cmd': 'submit',
+                    'input': str(Path(input_file).resolve()),
+                    'output': str(Path(output_file).resolve()),
+                    'args': [f"--type={self.format_var.get()}"]
+                })
+                if not reply.get('ok'):
+                    print(f"Compression error: {reply.get('error')}")
+                    return False
+                job = reply['job']
+                self.current_job = job
+                if not self.is_compressing:
+                    self.cancel_current_job()
+
+                for line in stream:
+                    event = json.loads(line)
+                    if event.get('job') != job:
+                        continue
+                    if event.get('event') == 'done':
+                        if event.get('error'):
+                            print(f"Compression error: {event['error']}")
+                        return event.get('state') == 'completed'
+                    self.progress_queue.put(('status', f"Compressing {filename}... {event.get('progress', 0)}%"))
+        except Exception as e:
+            print(f"Daemon error: {e}")
+        finally:
+            self.current_job = None
+        return False
     
     def monitor_progress(self):
         """Monitor progress from the worker thread"""
@@ -446,6 +531,7 @@ class CompressionGUI:
         if self.is_compressing:
             if messagebox.askokcancel("Quit", "Compression is in progress. Do you want to quit?"):
                 self.is_compressing = False
+                self.cancel_current_job()
                 self.root.destroy()
         else:
             self.save_config()
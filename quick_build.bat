@@ -30,24 +30,120 @@ if not exist "bin" mkdir bin
 if not exist "obj" mkdir obj
 
 REM Compila i file sorgente
-echo [1/4] Compilando universal_compressor.cpp...
+echo [1/28] Compilando universal_compressor.cpp...
 g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/universal_compressor.cpp -o obj/universal_compressor.o
 if %errorlevel% neq 0 goto :build_error
 
-echo [2/4] Compilando cso_compressor.cpp...
+echo [2/28] Compilando cso_compressor.cpp...
 g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/cso_compressor.cpp -o obj/cso_compressor.o
 if %errorlevel% neq 0 goto :build_error
 
-echo [3/4] Compilando chd_compressor.cpp...
+echo [3/28] Compilando chd_compressor.cpp...
 g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/chd_compressor.cpp -o obj/chd_compressor.o
 if %errorlevel% neq 0 goto :build_error
 
-echo [4/4] Compilando main.cpp...
+echo [4/28] Compilando codec_selector.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_selector.cpp -o obj/codec_selector.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [5/28] Compilando codec_registry.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_registry.cpp -o obj/codec_registry.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [6/28] Compilando codec_zlib.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_zlib.cpp -o obj/codec_zlib.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [7/28] Compilando codec_lz4.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_lz4.cpp -o obj/codec_lz4.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [8/28] Compilando codec_libdeflate.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_libdeflate.cpp -o obj/codec_libdeflate.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [9/28] Compilando codec_zopfli.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_zopfli.cpp -o obj/codec_zopfli.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [10/28] Compilando codec_lzma.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_lzma.cpp -o obj/codec_lzma.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [11/28] Compilando codec_zstd.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_zstd.cpp -o obj/codec_zstd.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [12/28] Compilando dictionary_trainer.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/dictionary_trainer.cpp -o obj/dictionary_trainer.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [13/28] Compilando sha1.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/sha1.cpp -o obj/sha1.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [14/28] Compilando journal.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/journal.cpp -o obj/journal.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [15/28] Compilando stream_io.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/stream_io.cpp -o obj/stream_io.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [16/28] Compilando disc_layout.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/disc_layout.cpp -o obj/disc_layout.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [17/28] Compilando cso_reader.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/cso_reader.cpp -o obj/cso_reader.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [18/28] Compilando chd_reader.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/chd_reader.cpp -o obj/chd_reader.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [19/28] Compilando image_source.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/image_source.cpp -o obj/image_source.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [20/28] Compilando daemon.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/daemon.cpp -o obj/daemon.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [21/28] Compilando job_control.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/job_control.cpp -o obj/job_control.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [22/28] Compilando numa_placement.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/numa_placement.cpp -o obj/numa_placement.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [23/28] Compilando codec_arena.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/codec_arena.cpp -o obj/codec_arena.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [24/28] Compilando block_sampler.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/block_sampler.cpp -o obj/block_sampler.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [25/28] Compilando auto_tuner.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/auto_tuner.cpp -o obj/auto_tuner.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [26/28] Compilando block_cache.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/block_cache.cpp -o obj/block_cache.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [27/28] Compilando worker_pool.cpp...
+g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/worker_pool.cpp -o obj/worker_pool.o
+if %errorlevel% neq 0 goto :build_error
+
+echo [28/28] Compilando main.cpp...
 g++ -std=c++17 -O2 -Wall -Wextra -Isrc -DHAVE_ZLIB -c src/main.cpp -o obj/main.o
 if %errorlevel% neq 0 goto :build_error
 
 REM Link finale
-echo [5/5] Linking...
+echo [29/29] Linking...
 g++ obj/*.o -o bin/universal-compressor.exe -lz
 if %errorlevel% neq 0 goto :build_error
 
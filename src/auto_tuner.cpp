@@ -0,0 +1,322 @@
+#include "auto_tuner.h"
+#include "block_sampler.h"
+#include "chd_compressor.h"
+#include "cso_compressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <thread>
+
+namespace UniversalCompressor {
+
+// Settori contigui per porzione CSO: 256 porzioni = 1024 blocchi campionati
+static const uint32_t CSO_SAMPLE_SECTORS = 4;
+
+// Dimensioni hunk provate, in settori (2352 byte per le immagini CD, 2048 le altre)
+static const uint32_t CHD_SAMPLE_HUNK_SECTORS[] = {4, 8, 16};
+
+// Costo stimato di un blocco costante (riempimento CSO compresso una volta)
+// e della voce d'indice o di mappa di ogni blocco
+static const uint32_t CSO_FILL_ESTIMATE = 16;
+static const uint32_t CSO_INDEX_ENTRY = 4;
+static const uint32_t CHD_MAP_ENTRY_ESTIMATE = 4;
+
+// AUTO_BALANCED: alternative entro questa frazione del rapporto migliore
+static const double BALANCED_RATIO_TOLERANCE = 0.99;
+
+static const double MB = 1024.0 * 1024.0;
+
+// Dimensione stimata dei blocchi con il miglior codec dell'insieme mask
+static uint64_t EstimateOutput(const std::vector<SampleTrialResult>& results,
+                               const std::vector<size_t>& trials, uint32_t mask,
+                               uint32_t blockSize, uint32_t constantCost, uint32_t entryCost) {
+    const size_t blocks = results[trials[0]].sizes.size();
+    uint64_t total = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        int best = -1;
+        for (size_t i = 0; i < trials.size(); ++i) {
+            if (!(mask & (1u << i))) {
+                continue;
+            }
+            int size = results[trials[i]].sizes[b];
+            if (size == SAMPLE_CONSTANT_BLOCK) {
+                best = static_cast<int>(constantCost);
+                break;
+            }
+            if (size > 0 && (best < 0 || size < best)) {
+                best = size;
+            }
+        }
+        total += (best >= 0 ? static_cast<uint32_t>(best) : blockSize) + entryCost;
+    }
+    return std::max<uint64_t>(total, 1);
+}
+
+static double TrialSeconds(const std::vector<SampleTrialResult>& results,
+                           const std::vector<size_t>& trials, uint32_t mask) {
+    double seconds = 0.0;
+    for (size_t i = 0; i < trials.size(); ++i) {
+        if (mask & (1u << i)) {
+            seconds += results[trials[i]].seconds;
+        }
+    }
+    return seconds;
+}
+
+AutoTuner::AutoTuner(const AutoTuneConfig& config)
+    : config_(config), targetReached_(true) {
+}
+
+bool AutoTuner::TuneCSO(const std::string& inputFile, CSOConfig& config) {
+    std::vector<uint8_t> dictionary;
+    if (config.format == CSO_FORMAT_ZCSO && !config.dictionary.empty() &&
+        !Utils::ReadFileData(config.dictionary, dictionary)) {
+        lastError_ = "Impossibile leggere il dizionario: " + config.dictionary;
+        return false;
+    }
+
+    // Candidati ai due livelli (normale e --cso-fast): una prova per codec e
+    // livello, condivisa se i due livelli coincidono
+    std::vector<CSOCandidate> lists[2];
+    std::vector<size_t> trialOf[2];
+    std::vector<SampleTrial> trials;
+    const uint32_t blockSize = CSOCompressor::GetBlockSize(config.format);
+    for (int fast = 0; fast < 2; ++fast) {
+        CSOConfig variant = config;
+        variant.fastMode = (fast != 0);
+        if (!CSOCompressor::BuildCandidates(variant, dictionary, lists[fast]) || lists[fast].empty()) {
+            lastError_ = "Nessun codec CSO disponibile per la configurazione";
+            return false;
+        }
+        for (const auto& candidate : lists[fast]) {
+            auto same = std::find_if(trials.begin(), trials.end(), [&candidate](const SampleTrial& t) {
+                return t.codec == candidate.codec && t.options.level == candidate.options.level;
+            });
+            if (same == trials.end()) {
+                trials.push_back({candidate.codec, candidate.options, blockSize, blockSize});
+                same = trials.end() - 1;
+            }
+            trialOf[fast].push_back(static_cast<size_t>(same - trials.begin()));
+        }
+    }
+
+    BlockSampler sampler;
+    if (!sampler.Open(inputFile) ||
+        !sampler.Load(config_.samples, blockSize * CSO_SAMPLE_SECTORS, blockSize)) {
+        lastError_ = sampler.GetLastError();
+        return false;
+    }
+    std::vector<SampleTrialResult> results = sampler.Run(trials, 0);
+    const double sampleBytes = static_cast<double>(sampler.GetBlockCount(blockSize)) * blockSize;
+
+    // In ZCSO i blocchi non-LZ4 devono essere del codec indicato nell'header
+    const CodecFormat zcsoFamily = (config.zcsoCodec == ZCSO_CODEC_DEFLATE) ? CODEC_FORMAT_DEFLATE : CODEC_FORMAT_ZSTD;
+
+    struct Choice {
+        int fast;
+        uint32_t mask;
+    };
+    std::vector<Choice> choices;
+    std::vector<Alternative> alternatives;
+    for (int fast = 0; fast < 2; ++fast) {
+        const std::vector<CSOCandidate>& list = lists[fast];
+        for (uint32_t mask = 1; mask < (1u << list.size()); ++mask) {
+            if (config.format == CSO_FORMAT_ZCSO) {
+                bool hasFamily = false;
+                for (size_t i = 0; i < list.size(); ++i) {
+                    hasFamily |= (mask & (1u << i)) && list[i].codec->GetFormat() == zcsoFamily;
+                }
+                if (!hasFamily) {
+                    continue;
+                }
+            }
+            uint64_t output = EstimateOutput(results, trialOf[fast], mask, blockSize,
+                                             CSO_FILL_ESTIMATE, CSO_INDEX_ENTRY);
+            double seconds = TrialSeconds(results, trialOf[fast], mask);
+            choices.push_back({fast, mask});
+            alternatives.push_back({sampleBytes / output,
+                                    seconds > 0.0 ? sampleBytes / seconds : std::numeric_limits<double>::max()});
+        }
+    }
+    if (alternatives.empty()) {
+        lastError_ = "Nessuna combinazione di codec valida per il formato";
+        return false;
+    }
+
+    uint32_t threads = 1;
+    size_t index = Select(alternatives, threads);
+    const Choice& choice = choices[index];
+
+    uint32_t allFlags = 0;
+    uint32_t flags = 0;
+    std::string names;
+    for (size_t i = 0; i < lists[choice.fast].size(); ++i) {
+        const Codec* codec = lists[choice.fast][i].codec;
+        allFlags |= codec->GetAlgorithmFlag();
+        if (choice.mask & (1u << i)) {
+            flags |= codec->GetAlgorithmFlag();
+            names += (names.empty() ? "" : "+") + std::string(codec->GetName());
+        }
+    }
+    config.algorithms = (config.algorithms & ~allFlags) | flags;
+    config.fastMode = (choice.fast != 0);
+    config.threads = threads;
+
+    summary_ = Describe(names + (config.fastMode ? " (veloce)" : ""), alternatives[index], threads);
+    return true;
+}
+
+bool AutoTuner::TuneCHD(const std::string& inputFile, CHDConfig& config) {
+    std::vector<uint8_t> dictionary;
+    if ((config.codecs & CHD_CODEC_ZSTD) && !config.zstdDictionary.empty() &&
+        !Utils::ReadFileData(config.zstdDictionary, dictionary)) {
+        lastError_ = "Impossibile leggere il dizionario zstd: " + config.zstdDictionary;
+        return false;
+    }
+
+    BlockSampler sampler;
+    if (!sampler.Open(inputFile)) {
+        lastError_ = sampler.GetLastError();
+        return false;
+    }
+
+    // Hunk multipli dei settori dell'immagine, come in AnalyzeInput. Porzioni
+    // grandi quanto l'hunk più grande, quindi meno strati che per i CSO.
+    const uint32_t unit = (sampler.GetImageSize() % 2352 == 0) ? 2352 : 2048;
+    const uint32_t maxSectors = CHD_SAMPLE_HUNK_SECTORS[sizeof(CHD_SAMPLE_HUNK_SECTORS) / sizeof(uint32_t) - 1];
+    if (!sampler.Load(std::max(16u, config_.samples / 4), unit * maxSectors, unit)) {
+        lastError_ = sampler.GetLastError();
+        return false;
+    }
+
+    std::vector<std::vector<CHDCodecSlot>> slots;
+    std::vector<std::vector<size_t>> trialOf;
+    std::vector<SampleTrial> trials;
+    for (uint32_t sectors : CHD_SAMPLE_HUNK_SECTORS) {
+        const uint32_t hunkSize = unit * sectors;
+        slots.push_back(CHDCompressor::BuildCodecSlots(config, hunkSize, dictionary));
+        trialOf.emplace_back();
+        for (const auto& slot : slots.back()) {
+            // Stesso limite di CompressHunk: conveniente solo sotto il 90% dell'hunk
+            trials.push_back({slot.codec, slot.options, hunkSize, static_cast<uint32_t>(hunkSize * 0.9)});
+            trialOf.back().push_back(trials.size() - 1);
+        }
+    }
+    if (slots[0].empty()) {
+        lastError_ = "Nessun codec CHD disponibile per la configurazione";
+        return false;
+    }
+    std::vector<SampleTrialResult> results = sampler.Run(trials, 0);
+    const double sampleBytes = static_cast<double>(sampler.GetSampleBytes());
+
+    struct Choice {
+        size_t size;
+        uint32_t mask;
+    };
+    std::vector<Choice> choices;
+    std::vector<Alternative> alternatives;
+    for (size_t s = 0; s < slots.size(); ++s) {
+        const uint32_t hunkSize = unit * CHD_SAMPLE_HUNK_SECTORS[s];
+        for (uint32_t mask = 1; mask < (1u << slots[s].size()); ++mask) {
+            // Gli hunk costanti finiscono nella sola voce di mappa
+            uint64_t output = EstimateOutput(results, trialOf[s], mask, hunkSize, 0, CHD_MAP_ENTRY_ESTIMATE);
+            double seconds = TrialSeconds(results, trialOf[s], mask);
+            choices.push_back({s, mask});
+            alternatives.push_back({sampleBytes / output,
+                                    seconds > 0.0 ? sampleBytes / seconds : std::numeric_limits<double>::max()});
+        }
+    }
+
+    uint32_t threads = 1;
+    size_t index = Select(alternatives, threads);
+    const Choice& choice = choices[index];
+
+    uint32_t allFlags = 0;
+    uint32_t flags = 0;
+    std::string names;
+    for (size_t i = 0; i < slots[choice.size].size(); ++i) {
+        const CHDCodecSlot& slot = slots[choice.size][i];
+        allFlags |= slot.configFlag;
+        if (choice.mask & (1u << i)) {
+            flags |= slot.configFlag;
+            names += (names.empty() ? "" : "+") + std::string(slot.codec->GetName());
+        }
+    }
+    config.codecs = (config.codecs & ~allFlags) | flags;
+    config.hunkSize = unit * CHD_SAMPLE_HUNK_SECTORS[choice.size];
+    config.processors = threads;
+
+    summary_ = Describe("hunk " + std::to_string(config.hunkSize) + ", " + names, alternatives[index], threads);
+    return true;
+}
+
+size_t AutoTuner::Select(const std::vector<Alternative>& alternatives, uint32_t& threads) {
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    targetReached_ = true;
+    threads = cores;
+
+    auto bestBy = [&alternatives](auto better, auto eligible) {
+        size_t best = SIZE_MAX;
+        for (size_t i = 0; i < alternatives.size(); ++i) {
+            if (eligible(alternatives[i]) && (best == SIZE_MAX || better(alternatives[i], alternatives[best]))) {
+                best = i;
+            }
+        }
+        return best;
+    };
+    // A parità di rapporto la più veloce, e viceversa
+    auto higherRatio = [](const Alternative& a, const Alternative& b) {
+        return a.ratio != b.ratio ? a.ratio > b.ratio : a.throughput > b.throughput;
+    };
+    auto faster = [](const Alternative& a, const Alternative& b) {
+        return a.throughput != b.throughput ? a.throughput > b.throughput : a.ratio > b.ratio;
+    };
+    auto any = [](const Alternative&) { return true; };
+
+    size_t chosen = SIZE_MAX;
+    switch (config_.objective) {
+        case AUTO_MAX_RATIO: {
+            // Velocità complessiva = velocità di un thread per i core usati
+            const double needed = config_.target * MB;
+            chosen = bestBy(higherRatio, [&](const Alternative& a) { return a.throughput * cores >= needed; });
+            if (chosen == SIZE_MAX) {
+                targetReached_ = false;
+                chosen = bestBy(faster, any);
+            } else {
+                // Solo i thread necessari per la velocità richiesta
+                double required = std::ceil(needed / alternatives[chosen].throughput);
+                threads = static_cast<uint32_t>(std::clamp(required, 1.0, static_cast<double>(cores)));
+            }
+            break;
+        }
+        case AUTO_MIN_TIME:
+            chosen = bestBy(faster, [&](const Alternative& a) { return a.ratio >= config_.target; });
+            if (chosen == SIZE_MAX) {
+                targetReached_ = false;
+                chosen = bestBy(higherRatio, any);
+            }
+            break;
+        case AUTO_BALANCED:
+        default: {
+            const double best = alternatives[bestBy(higherRatio, any)].ratio;
+            chosen = bestBy(faster, [&](const Alternative& a) { return a.ratio >= best * BALANCED_RATIO_TOLERANCE; });
+            break;
+        }
+    }
+    return chosen;
+}
+
+std::string AutoTuner::Describe(const std::string& choice, const Alternative& alternative, uint32_t threads) const {
+    char estimate[96];
+    double speed = alternative.throughput * threads / MB;
+    if (alternative.throughput == std::numeric_limits<double>::max()) {
+        snprintf(estimate, sizeof(estimate), "rapporto stimato %.2f", alternative.ratio);
+    } else {
+        snprintf(estimate, sizeof(estimate), "rapporto stimato %.2f, ~%.0f MB/s", alternative.ratio, speed);
+    }
+    return "Auto: " + choice + ", " + std::to_string(threads) + " thread (" + estimate + ")";
+}
+
+} // namespace UniversalCompressor
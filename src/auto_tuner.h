@@ -0,0 +1,50 @@
+#ifndef AUTO_TUNER_H
+#define AUTO_TUNER_H
+
+#include "universal_compressor.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Scelta dei parametri di compressione per un'immagine (--auto). Ogni codec
+// candidato, a ogni livello o dimensione hunk, viene provato una volta sui
+// blocchi campionati (BlockSampler); le combinazioni di codec si valutano poi
+// dai risultati per blocco, senza altre compressioni. Tra le alternative si
+// sceglie quella che soddisfa l'obiettivo e i thread necessari per ottenerlo.
+class AutoTuner {
+public:
+    explicit AutoTuner(const AutoTuneConfig& config);
+
+    // config viene aggiornata solo in caso di successo
+    bool TuneCSO(const std::string& inputFile, CSOConfig& config);
+    bool TuneCHD(const std::string& inputFile, CHDConfig& config);
+
+    // Descrizione della scelta; false se nessuna alternativa soddisfa l'obiettivo
+    // (viene scelta la più vicina)
+    const std::string& GetSummary() const { return summary_; }
+    bool IsTargetReached() const { return targetReached_; }
+    const std::string& GetLastError() const { return lastError_; }
+
+private:
+    // Alternativa valutata sui campioni
+    struct Alternative {
+        double ratio;           // byte originali / byte stimati in output
+        double throughput;      // byte/s di un thread
+    };
+
+    // Indice dell'alternativa scelta e thread da usare
+    size_t Select(const std::vector<Alternative>& alternatives, uint32_t& threads);
+
+    std::string Describe(const std::string& choice, const Alternative& alternative, uint32_t threads) const;
+
+    AutoTuneConfig config_;
+    std::string summary_;
+    bool targetReached_;
+    std::string lastError_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // AUTO_TUNER_H
@@ -0,0 +1,388 @@
+#include "block_cache.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <unordered_set>
+#include <zlib.h>
+
+namespace UniversalCompressor {
+
+static const char SEGMENT_MAGIC[4] = {'U', 'C', 'B', '1'};
+static const char SEGMENT_END_MAGIC[4] = {'U', 'C', 'B', 'E'};
+static const uint32_t SEGMENT_VERSION = 1;
+
+// Oltre questi segmenti l'apertura li unisce in uno: un file aperto per segmento
+static const size_t CACHE_MERGE_SEGMENTS = 32;
+
+#pragma pack(push, 1)
+struct SegmentHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t fingerprint;
+};
+
+struct SegmentEntry {
+    uint8_t key[BlockCache::KEY_SIZE];
+    int32_t size;           // -1 = blocco non compresso, nessun dato
+    int32_t codec;
+    uint32_t crc;           // CRC32 dei dati
+};
+
+// In coda al file, dopo l'indice (coppie chiave ridotta / offset della voce)
+struct SegmentFooter {
+    uint64_t indexOffset;
+    uint64_t count;
+    uint32_t crc;           // CRC32 dell'indice
+    char magic[4];
+};
+#pragma pack(pop)
+
+typedef std::pair<uint64_t, uint64_t> IndexEntry;
+
+// fseek/ftell a 64 bit: i segmenti possono superare i 2 GB
+static int Seek64(FILE* file, uint64_t offset, int origin = SEEK_SET) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), origin);
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+static int64_t Tell64(FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+static uint32_t DataCRC(const void* data, size_t size) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    if (size > 0) {
+        crc = crc32(crc, static_cast<const Bytef*>(data), static_cast<uInt>(size));
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+static uint64_t ShortKey(const uint8_t key[BlockCache::KEY_SIZE]) {
+    uint64_t value;
+    memcpy(&value, key, sizeof(value));
+    return value;
+}
+
+// Nome univoco tra processi e lavori dello stesso processo
+static std::string UniqueSegmentName() {
+    static std::mutex mutex;
+    static std::mt19937_64 random(std::random_device{}());
+    std::lock_guard<std::mutex> lock(mutex);
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%016llx.seg",
+             static_cast<unsigned long long>(std::chrono::system_clock::now().time_since_epoch().count()),
+             static_cast<unsigned long long>(random()));
+    return name;
+}
+
+// Legge e controlla header e indice di un segmento
+static bool ReadSegmentIndex(FILE* file, uint64_t fingerprint, std::vector<IndexEntry>& index) {
+    SegmentHeader header;
+    SegmentFooter footer;
+    if (Seek64(file, 0) != 0 || fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, SEGMENT_MAGIC, 4) != 0 || header.version != SEGMENT_VERSION ||
+        header.fingerprint != fingerprint) {
+        return false;
+    }
+    int64_t end = (Seek64(file, 0, SEEK_END) == 0) ? Tell64(file) : -1;
+    if (end < static_cast<int64_t>(sizeof(header) + sizeof(footer)) ||
+        Seek64(file, end - sizeof(footer)) != 0 || fread(&footer, sizeof(footer), 1, file) != 1 ||
+        memcmp(footer.magic, SEGMENT_END_MAGIC, 4) != 0 ||
+        footer.count > (end - sizeof(header) - sizeof(footer)) / sizeof(IndexEntry)) {
+        return false;
+    }
+    index.resize(static_cast<size_t>(footer.count));
+    if (Seek64(file, footer.indexOffset) != 0 ||
+        (footer.count > 0 && fread(index.data(), sizeof(IndexEntry), index.size(), file) != index.size())) {
+        return false;
+    }
+    return DataCRC(index.data(), index.size() * sizeof(IndexEntry)) == footer.crc;
+}
+
+// Segmento in scrittura: voci in ordine, indice e coda alla chiusura. Il file
+// resta .tmp (ignorato dai lettori) finché non è completo.
+class CacheSegmentWriter {
+public:
+    ~CacheSegmentWriter() { Abort(); }
+
+    bool Create(const std::string& directory, uint64_t fingerprint) {
+        path_ = (std::filesystem::path(directory) / UniqueSegmentName()).string();
+        file_ = fopen((path_ + ".tmp").c_str(), "wb");
+        if (!file_) {
+            return false;
+        }
+        SegmentHeader header = {};
+        memcpy(header.magic, SEGMENT_MAGIC, 4);
+        header.version = SEGMENT_VERSION;
+        header.fingerprint = fingerprint;
+        pos_ = sizeof(header);
+        return fwrite(&header, sizeof(header), 1, file_) == 1;
+    }
+
+    bool Append(const uint8_t key[BlockCache::KEY_SIZE], const uint8_t* data, int size, int codec) {
+        SegmentEntry entry;
+        memcpy(entry.key, key, BlockCache::KEY_SIZE);
+        entry.size = size;
+        entry.codec = codec;
+        entry.crc = DataCRC(data, size > 0 ? size : 0);
+        if (fwrite(&entry, sizeof(entry), 1, file_) != 1 ||
+            (size > 0 && fwrite(data, 1, size, file_) != static_cast<size_t>(size))) {
+            return false;
+        }
+        index_.emplace_back(ShortKey(key), pos_);
+        pos_ += sizeof(entry) + (size > 0 ? size : 0);
+        return true;
+    }
+
+    size_t GetCount() const { return index_.size(); }
+
+    // Indice, coda e rename: da qui il segmento è visibile
+    bool Finish() {
+        SegmentFooter footer = {};
+        footer.indexOffset = pos_;
+        footer.count = index_.size();
+        footer.crc = DataCRC(index_.data(), index_.size() * sizeof(IndexEntry));
+        memcpy(footer.magic, SEGMENT_END_MAGIC, 4);
+        bool ok = (index_.empty() || fwrite(index_.data(), sizeof(IndexEntry), index_.size(), file_) == index_.size()) &&
+                  fwrite(&footer, sizeof(footer), 1, file_) == 1;
+        ok = (fclose(file_) == 0) && ok;
+        file_ = nullptr;
+
+        std::error_code error;
+        if (ok) {
+            std::filesystem::rename(path_ + ".tmp", path_, error);
+        }
+        if (!ok || error) {
+            std::filesystem::remove(path_ + ".tmp", error);
+            return false;
+        }
+        return true;
+    }
+
+    void Abort() {
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+            std::error_code error;
+            std::filesystem::remove(path_ + ".tmp", error);
+        }
+    }
+
+    const std::string& GetPath() const { return path_; }
+
+private:
+    FILE* file_ = nullptr;
+    std::string path_;
+    uint64_t pos_ = 0;
+    std::vector<IndexEntry> index_;
+};
+
+// Unisce i segmenti in uno. Ogni segmento viene prima rinominato: il rename
+// riesce a un solo processo, che così lo "prende"; gli altri lo ignorano.
+static void MergeSegments(const std::string& directory, uint64_t fingerprint, std::vector<std::string>& paths) {
+    std::vector<std::string> claimed;
+    std::vector<std::string> remaining;
+    for (const auto& path : paths) {
+        std::error_code error;
+        std::filesystem::rename(path, path + ".merge", error);
+        if (error) {
+            remaining.push_back(path);
+        } else {
+            claimed.push_back(path);
+        }
+    }
+
+    CacheSegmentWriter writer;
+    bool ok = writer.Create(directory, fingerprint);
+    std::unordered_set<uint64_t> written;
+    std::vector<uint8_t> data;
+    for (size_t i = 0; ok && i < claimed.size(); ++i) {
+        FILE* file = fopen((claimed[i] + ".merge").c_str(), "rb");
+        std::vector<IndexEntry> index;
+        // Un segmento illeggibile viene scartato, non blocca gli altri
+        if (file && ReadSegmentIndex(file, fingerprint, index)) {
+            for (const auto& item : index) {
+                SegmentEntry entry;
+                if (written.count(item.first) || Seek64(file, item.second) != 0 ||
+                    fread(&entry, sizeof(entry), 1, file) != 1) {
+                    continue;
+                }
+                data.resize(entry.size > 0 ? entry.size : 0);
+                if ((entry.size > 0 && fread(data.data(), 1, data.size(), file) != data.size()) ||
+                    DataCRC(data.data(), data.size()) != entry.crc) {
+                    continue;
+                }
+                ok = writer.Append(entry.key, data.data(), entry.size, entry.codec);
+                written.insert(item.first);
+            }
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+    ok = ok && writer.Finish();
+
+    // Riuscita: i vecchi segmenti spariscono; altrimenti tornano al loro posto
+    for (const auto& path : claimed) {
+        std::error_code error;
+        if (ok) {
+            std::filesystem::remove(path + ".merge", error);
+        } else {
+            std::filesystem::rename(path + ".merge", path, error);
+            remaining.push_back(path);
+        }
+    }
+    if (ok) {
+        remaining.push_back(writer.GetPath());
+    }
+    paths.swap(remaining);
+}
+
+BlockCache::BlockCache()
+    : open_(false), fingerprint_(0), outputFailed_(false), hits_(0), misses_(0) {
+}
+
+BlockCache::~BlockCache() {
+    Close();
+}
+
+bool BlockCache::Open(const std::string& directory, const std::string& configuration,
+                      const std::vector<uint8_t>& dictionary) {
+    Close();
+
+    // Sottodirectory della configurazione: i primi 8 byte dello SHA-1 della descrizione
+    SHA1 sha;
+    uint8_t digest[SHA1::DIGEST_SIZE];
+    sha.Update(reinterpret_cast<const uint8_t*>(configuration.data()), configuration.size());
+    if (!dictionary.empty()) {
+        sha.Update(dictionary.data(), dictionary.size());
+    }
+    sha.Final(digest);
+    memcpy(&fingerprint_, digest, sizeof(fingerprint_));
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(fingerprint_));
+
+    std::error_code error;
+    directory_ = (std::filesystem::path(directory) / name).string();
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        lastError_ = "Impossibile creare la directory della cache: " + directory_;
+        return false;
+    }
+
+    std::vector<std::string> paths;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, error)) {
+        if (item.path().extension() == ".seg") {
+            paths.push_back(item.path().string());
+        }
+    }
+    if (paths.size() > CACHE_MERGE_SEGMENTS) {
+        MergeSegments(directory_, fingerprint_, paths);
+    }
+    for (const auto& path : paths) {
+        LoadSegment(path);
+    }
+
+    hits_ = 0;
+    misses_ = 0;
+    outputFailed_ = false;
+    open_ = true;
+    return true;
+}
+
+bool BlockCache::LoadSegment(const std::string& path) {
+    // Segmenti incompleti o di un'altra versione: ignorati
+    auto segment = std::make_unique<Segment>();
+    segment->file = fopen(path.c_str(), "rb");
+    std::vector<IndexEntry> index;
+    if (!segment->file || !ReadSegmentIndex(segment->file, fingerprint_, index)) {
+        if (segment->file) {
+            fclose(segment->file);
+        }
+        return false;
+    }
+    uint32_t number = static_cast<uint32_t>(segments_.size());
+    for (const auto& item : index) {
+        index_.emplace(item.first, Location{number, item.second});
+    }
+    segments_.push_back(std::move(segment));
+    return true;
+}
+
+void BlockCache::Close() {
+    if (output_ && output_->GetCount() > 0 && !outputFailed_) {
+        output_->Finish();
+    }
+    output_.reset();
+    for (auto& segment : segments_) {
+        fclose(segment->file);
+    }
+    segments_.clear();
+    index_.clear();
+    open_ = false;
+}
+
+void BlockCache::MakeKey(const uint8_t* data, uint32_t size, uint8_t content, uint8_t key[KEY_SIZE]) {
+    SHA1 sha;
+    sha.Update(&content, 1);
+    sha.Update(data, size);
+    sha.Final(key);
+}
+
+bool BlockCache::Lookup(const uint8_t key[KEY_SIZE], uint8_t* output, uint32_t capacity, int& size, int& codec) {
+    auto found = index_.find(ShortKey(key));
+    if (found == index_.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Segment& segment = *segments_[found->second.segment];
+    SegmentEntry entry;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(segment.mutex);
+        ok = Seek64(segment.file, found->second.offset) == 0 &&
+             fread(&entry, sizeof(entry), 1, segment.file) == 1 &&
+             memcmp(entry.key, key, KEY_SIZE) == 0 &&
+             entry.size <= static_cast<int32_t>(capacity) &&
+             (entry.size <= 0 || fread(output, 1, entry.size, segment.file) == static_cast<size_t>(entry.size));
+    }
+    // Chiave ridotta in collisione o dati rovinati: si comprime normalmente
+    if (!ok || DataCRC(output, entry.size > 0 ? entry.size : 0) != entry.crc) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    size = (entry.size > 0) ? entry.size : -1;
+    codec = entry.codec;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void BlockCache::Store(const uint8_t key[KEY_SIZE], const uint8_t* data, int size, int codec) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (outputFailed_) {
+        return;
+    }
+    if (!output_) {
+        output_ = std::make_unique<CacheSegmentWriter>();
+        if (!output_->Create(directory_, fingerprint_)) {
+            outputFailed_ = true;
+            return;
+        }
+    }
+    // Un errore di scrittura disattiva solo la cache, non la compressione
+    if (!output_->Append(key, data, size, codec)) {
+        output_->Abort();
+        outputFailed_ = true;
+    }
+}
+
+} // namespace UniversalCompressor
@@ -0,0 +1,95 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "sha1.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace UniversalCompressor {
+
+class CacheSegmentWriter;
+
+// Cache su disco dei blocchi compressi, condivisa tra le immagini (--cache).
+// La chiave è lo SHA-1 dei dati originali (con la classe di contenuto), il
+// valore i byte compressi e il codec che li ha prodotti: un blocco già visto
+// in un'altra immagine non passa dai codec.
+//
+// Ogni configurazione di codec ha una sottodirectory, dal suo fingerprint.
+// Ogni lavoro scrive un proprio segmento (file .seg, reso visibile con un
+// rename alla chiusura): più processi o lavori del daemon possono usare la
+// stessa directory senza lock. In apertura si leggono solo gli indici in coda
+// ai segmenti; i dati si rileggono al primo uso e vengono controllati con CRC.
+// I blocchi aggiunti durante un lavoro sono visibili dai lavori successivi.
+class BlockCache {
+public:
+    static const size_t KEY_SIZE = SHA1::DIGEST_SIZE;
+
+    BlockCache();
+    ~BlockCache();
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // configuration descrive codec, livelli, limiti e dizionario: cambia la
+    // sottodirectory, quindi blocchi di configurazioni diverse non si mescolano
+    bool Open(const std::string& directory, const std::string& configuration,
+              const std::vector<uint8_t>& dictionary);
+
+    // Completa il segmento del lavoro; senza nuovi blocchi non scrive nulla
+    void Close();
+
+    bool IsOpen() const { return open_; }
+
+    // Chiave di un blocco: la classe di contenuto cambia i codec provati
+    static void MakeKey(const uint8_t* data, uint32_t size, uint8_t content, uint8_t key[KEY_SIZE]);
+
+    // Da più thread. Trovato: size = byte in output (-1 = blocco da salvare non
+    // compresso), codec = indice del codec nella configurazione
+    bool Lookup(const uint8_t key[KEY_SIZE], uint8_t* output, uint32_t capacity, int& size, int& codec);
+    void Store(const uint8_t key[KEY_SIZE], const uint8_t* data, int size, int codec);
+
+    uint64_t GetEntryCount() const { return index_.size(); }
+    uint64_t GetHits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t GetMisses() const { return misses_.load(std::memory_order_relaxed); }
+    const std::string& GetLastError() const { return lastError_; }
+
+private:
+    // Segmento in lettura: le letture dello stesso file sono serializzate
+    struct Segment {
+        FILE* file = nullptr;
+        std::mutex mutex;
+    };
+
+    // Posizione di un blocco: segmento e offset della voce
+    struct Location {
+        uint32_t segment;
+        uint64_t offset;
+    };
+
+    bool LoadSegment(const std::string& path);
+
+    bool open_;
+    uint64_t fingerprint_;
+    std::string directory_;             // sottodirectory della configurazione
+    std::vector<std::unique_ptr<Segment>> segments_;
+    std::unordered_map<uint64_t, Location> index_;  // primi 8 byte della chiave
+
+    // Segmento del lavoro, creato al primo blocco aggiunto
+    std::mutex writeMutex_;
+    std::unique_ptr<CacheSegmentWriter> output_;
+    bool outputFailed_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::string lastError_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // BLOCK_CACHE_H
@@ -0,0 +1,211 @@
+#include "block_sampler.h"
+#include "image_source.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace UniversalCompressor {
+
+// Campioni assegnati a un thread per volta: abbastanza per ammortizzare
+// l'attesa sul contatore, pochi per bilanciare prove lente e veloci
+static const size_t SAMPLES_PER_UNIT = 16;
+
+bool BlockSampler::Open(const std::string& inputFile) {
+    samples_.clear();
+    // stdin non va nemmeno aperto: i byte letti mancherebbero alla compressione
+    if (IsStdioPath(inputFile)) {
+        lastError_ = "L'input da pipe non si può campionare";
+        return false;
+    }
+    std::string error;
+    if (!OpenImageInput(input_, inputFile, 0, std::max(1u, std::thread::hardware_concurrency()), error)) {
+        lastError_ = error;
+        return false;
+    }
+    if (!input_.IsSeekable()) {
+        input_.Close();
+        lastError_ = "L'input non permette l'accesso casuale";
+        return false;
+    }
+    return true;
+}
+
+bool BlockSampler::Load(uint32_t strata, uint32_t spanSize, uint32_t alignment) {
+    return Load(input_, strata, spanSize, alignment);
+}
+
+bool BlockSampler::Load(InputStream& input, uint32_t strata, uint32_t spanSize, uint32_t alignment) {
+    samples_.clear();
+    const uint64_t imageSize = input.GetSize();
+    alignment = std::max(alignment, 1u);
+    spanSize = std::max(spanSize - spanSize % alignment, alignment);
+    if (imageSize < spanSize) {
+        lastError_ = "Immagine troppo piccola per il campionamento";
+        return false;
+    }
+
+    strata = static_cast<uint32_t>(std::min<uint64_t>(std::max(strata, 1u), imageSize / spanSize));
+    const uint64_t stratumSize = imageSize / strata;
+    for (uint32_t s = 0; s < strata; ++s) {
+        // Offset pseudo-casuale nello strato (hash dell'indice): due esecuzioni
+        // sulla stessa immagine leggono gli stessi dati
+        uint64_t start = s * stratumSize;
+        uint64_t room = (stratumSize > spanSize) ? stratumSize - spanSize : 0;
+        uint64_t hash = (s + 1) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+        uint64_t offset = start + (room ? hash % (room + 1) : 0);
+        offset -= offset % alignment;
+
+        ImageSample sample;
+        sample.offset = offset;
+        sample.data.resize(spanSize);
+        if (input.ReadAt(offset, sample.data.data(), spanSize) != spanSize) {
+            lastError_ = "Errore di lettura durante il campionamento";
+            samples_.clear();
+            return false;
+        }
+        samples_.push_back(std::move(sample));
+    }
+    return true;
+}
+
+uint64_t BlockSampler::GetSampleBytes() const {
+    uint64_t total = 0;
+    for (const auto& sample : samples_) {
+        total += sample.data.size();
+    }
+    return total;
+}
+
+size_t BlockSampler::GetBlockCount(uint32_t blockSize) const {
+    size_t count = 0;
+    for (const auto& sample : samples_) {
+        count += sample.data.size() / blockSize;
+    }
+    return count;
+}
+
+std::vector<SampleTrialResult> BlockSampler::Run(const std::vector<SampleTrial>& trials, uint32_t threads) const {
+    std::vector<SampleTrialResult> results(trials.size());
+    for (size_t t = 0; t < trials.size(); ++t) {
+        results[t].sizes.assign(GetBlockCount(trials[t].blockSize), -1);
+    }
+
+    const size_t unitsPerTrial = (samples_.size() + SAMPLES_PER_UNIT - 1) / SAMPLES_PER_UNIT;
+    const size_t units = trials.size() * unitsPerTrial;
+    std::vector<double> unitSeconds(units, 0.0);
+    std::atomic<size_t> nextUnit(0);
+
+    auto worker = [&]() {
+        // Contesti creati al primo uso e riusati per le altre porzioni della prova
+        std::vector<std::unique_ptr<CodecContext>> contexts(trials.size());
+        std::vector<uint8_t> output;
+
+        for (size_t unit = nextUnit++; unit < units; unit = nextUnit++) {
+            const size_t t = unit / unitsPerTrial;
+            const SampleTrial& trial = trials[t];
+            if (!contexts[t]) {
+                contexts[t] = trial.codec->CreateContext(trial.options);
+                if (!contexts[t]) {
+                    continue;
+                }
+            }
+            output.resize(std::max<size_t>(output.size(), trial.codec->GetBound(trial.blockSize)));
+            const uint32_t capacity = trial.codec->HasCapability(CODEC_CAP_BOUNDED_OUTPUT)
+                ? trial.limit : trial.codec->GetBound(trial.blockSize);
+
+            const size_t first = (unit % unitsPerTrial) * SAMPLES_PER_UNIT;
+            const size_t last = std::min(first + SAMPLES_PER_UNIT, samples_.size());
+            size_t block = 0;
+            for (size_t s = 0; s < first; ++s) {
+                block += samples_[s].data.size() / trial.blockSize;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t s = first; s < last; ++s) {
+                const std::vector<uint8_t>& data = samples_[s].data;
+                for (size_t pos = 0; pos + trial.blockSize <= data.size(); pos += trial.blockSize, ++block) {
+                    const uint8_t* input = data.data() + pos;
+                    if (input[0] == input[trial.blockSize - 1] &&
+                        memcmp(input, input + 1, trial.blockSize - 1) == 0) {
+                        results[t].sizes[block] = SAMPLE_CONSTANT_BLOCK;
+                        continue;
+                    }
+                    int size = contexts[t]->Compress(input, trial.blockSize, output.data(), capacity);
+                    results[t].sizes[block] = (size > 0 && static_cast<uint32_t>(size) <= trial.limit) ? size : -1;
+                }
+            }
+            unitSeconds[unit] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<uint32_t>(std::min<size_t>(threads, std::max<size_t>(units, 1)));
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    for (size_t unit = 0; unit < units; ++unit) {
+        results[unit / unitsPerTrial].seconds += unitSeconds[unit];
+    }
+    return results;
+}
+
+// Media e semiampiezza dell'intervallo al 95%: un campione per strato, la
+// varianza tra gli strati (conservativa) stima quella della media
+static void MeanInterval(const std::vector<double>& values, double& mean, double& margin) {
+    mean = 0.0;
+    margin = 0.0;
+    if (values.empty()) {
+        return;
+    }
+    for (double value : values) {
+        mean += value;
+    }
+    mean /= values.size();
+    if (values.size() < 2) {
+        return;
+    }
+    double variance = 0.0;
+    for (double value : values) {
+        variance += (value - mean) * (value - mean);
+    }
+    variance /= values.size() - 1;
+    margin = 1.96 * std::sqrt(variance / values.size());
+}
+
+void ExtrapolateEstimate(const std::vector<double>& ratios, const std::vector<double>& seconds,
+                         uint64_t spanBytes, uint64_t dataSize, uint64_t overhead, uint32_t threads,
+                         CompressionEstimate& estimate) {
+    double mean, margin;
+    MeanInterval(ratios, mean, margin);
+    // Un blocco non compresso costa al più quanto l'originale
+    double low = std::max(mean - margin, 0.0);
+    double high = std::min(mean + margin, 1.0);
+    estimate.outputSize = overhead + static_cast<uint64_t>(mean * dataSize);
+    estimate.outputLow = overhead + static_cast<uint64_t>(low * dataSize);
+    estimate.outputHigh = overhead + static_cast<uint64_t>(high * dataSize);
+
+    // Tempo di un thread per byte, diviso tra i thread: scalabilità lineare
+    MeanInterval(seconds, mean, margin);
+    threads = std::max(threads, 1u);
+    const double scale = static_cast<double>(dataSize) / std::max<uint64_t>(spanBytes, 1) / threads;
+    estimate.threads = threads;
+    estimate.seconds = mean * scale;
+    estimate.secondsLow = std::max(mean - margin, 0.0) * scale;
+    estimate.secondsHigh = (mean + margin) * scale;
+    estimate.strata = static_cast<uint32_t>(ratios.size());
+}
+
+} // namespace UniversalCompressor
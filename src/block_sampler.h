@@ -0,0 +1,85 @@
+#ifndef BLOCK_SAMPLER_H
+#define BLOCK_SAMPLER_H
+
+#include "universal_compressor.h"
+#include "codec_registry.h"
+#include "stream_io.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Dimensione di un blocco costante nei risultati: i compressori lo servono
+// senza codec (riempimento CSO, hunk MINI CHD)
+static const int SAMPLE_CONSTANT_BLOCK = -2;
+
+// Porzione contigua dell'immagine letta da uno strato
+struct ImageSample {
+    uint64_t offset;
+    std::vector<uint8_t> data;
+};
+
+// Prova di un codec sui blocchi dei campioni
+struct SampleTrial {
+    const Codec* codec;
+    CodecOptions options;
+    uint32_t blockSize;     // i campioni vengono divisi in blocchi di questa dimensione
+    uint32_t limit;         // output massimo utile per blocco, come nel compressore
+};
+
+// Esito di una prova: dimensione per blocco (-1 = oltre il limite,
+// SAMPLE_CONSTANT_BLOCK = non compresso) e secondi di un thread
+struct SampleTrialResult {
+    std::vector<int> sizes;
+    double seconds = 0.0;
+};
+
+// Campionamento stratificato di un'immagine: l'immagine viene divisa in
+// strati uguali e da ognuno si legge una porzione contigua, a un offset
+// pseudo-casuale ma ripetibile. Le prove girano in parallelo con un contesto
+// codec per thread, come nei worker dei compressori.
+class BlockSampler {
+public:
+    BlockSampler() = default;
+
+    // Apre l'input (file o CSO/CHD decompresso al volo); serve l'accesso casuale
+    bool Open(const std::string& inputFile);
+
+    // Legge strata porzioni di spanSize byte, allineate ad alignment. Con
+    // un'immagine piccola gli strati diminuiscono fino a coprirla tutta.
+    bool Load(uint32_t strata, uint32_t spanSize, uint32_t alignment);
+
+    // Come sopra, da un input già aperto (quello di un compressore, per --estimate)
+    bool Load(InputStream& input, uint32_t strata, uint32_t spanSize, uint32_t alignment);
+
+    uint64_t GetImageSize() const { return input_.GetSize(); }
+    uint64_t GetSampleBytes() const;
+    const std::vector<ImageSample>& GetSamples() const { return samples_; }
+
+    // Blocchi interi di blockSize contenuti nei campioni, nell'ordine dei risultati
+    size_t GetBlockCount(uint32_t blockSize) const;
+
+    // Esegue le prove su threads thread (0 = tutti i core); il tempo di creazione
+    // dei contesti non viene contato
+    std::vector<SampleTrialResult> Run(const std::vector<SampleTrial>& trials, uint32_t threads) const;
+
+    const std::string& GetLastError() const { return lastError_; }
+
+private:
+    InputStream input_;
+    std::vector<ImageSample> samples_;
+    std::string lastError_;
+};
+
+// Estrapolazione di --estimate dai risultati per strato: ratios = byte in
+// output / byte letti, seconds = tempo di un thread su spanBytes. dataSize è
+// la parte dell'immagine che scala con il rapporto, overhead la parte fissa
+// dell'output (header, indice o mappa). Gli intervalli sono al 95%.
+void ExtrapolateEstimate(const std::vector<double>& ratios, const std::vector<double>& seconds,
+                         uint64_t spanBytes, uint64_t dataSize, uint64_t overhead, uint32_t threads,
+                         CompressionEstimate& estimate);
+
+} // namespace UniversalCompressor
+
+#endif // BLOCK_SAMPLER_H
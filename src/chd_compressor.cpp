@@ -1,25 +1,52 @@
 #include "chd_compressor.h"
+#include "chd_reader.h"
+#include "block_sampler.h"
+#include "image_source.h"
 #include <iostream>
 #include <cstring>
 #include <algorithm>
 #include <zlib.h>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 
 namespace UniversalCompressor {
 
+// Codec CHD abilitabili dalla configurazione e relativo codec nel registro
+static const struct {
+    uint32_t configFlag;
+    const char* codecName;
+    uint32_t implId;
+} CHD_CODEC_TABLE[] = {
+    {CHD_CODEC_CDZL, "zlib", CHD_CODEC_ZLIB_IMPL},
+    {CHD_CODEC_CDLZ, "lzma", CHD_CODEC_LZMA_IMPL},
+    {CHD_CODEC_CDFL, "flac", CHD_CODEC_FLAC_IMPL},
+    {CHD_CODEC_ZSTD, "zstd", CHD_CODEC_ZSTD_IMPL},
+};
+
+const Codec* FindCHDCodec(uint32_t implId) {
+    for (const auto& entry : CHD_CODEC_TABLE) {
+        if (entry.implId == implId) {
+            return CodecRegistry::Instance().Find(entry.codecName);
+        }
+    }
+    return nullptr;
+}
+
 CHDCompressor::CHDCompressor(const CHDConfig& config)
-    : config_(config), inputFile_(nullptr), outputFile_(nullptr),
-      inputSize_(0), outputPos_(0), totalHunks_(0), currentHunk_(0), 
-      hunkSize_(config.hunkSize), isCD_(false) {
+    : config_(config), buffers_(nullptr), numaNodes_(1), checkpointInterval_(0), resume_(false),
+      declaredInputSize_(0), inputSize_(0), outputPos_(0), metaOffset_(0), totalHunks_(0), currentHunk_(0), 
+      hunkSize_(config.hunkSize), previousValid_(false), miniHunks_(0), selfHunks_(0), reusedHunks_(0),
+      control_(nullptr), isCD_(false), hunkLoop_(nullptr) {
     
     // Calcola dimensione hunk se auto
     if (config_.hunkSize == 0) {
         hunkSize_ = CalculateHunkSize();
     }
-    
-    // Prepara buffer
-    inputBuffer_.resize(hunkSize_);
-    outputBuffer_.resize(hunkSize_ * 2); // Spazio extra per compressione
+
+    if (config_.processors == 0) {
+        config_.processors = std::max(1u, std::thread::hardware_concurrency());
+    }
 }
 
 CHDCompressor::~CHDCompressor() {
@@ -30,9 +57,35 @@ void CHDCompressor::SetProgressCallback(ProgressCallback callback) {
     progressCallback_ = callback;
 }
 
+void CHDCompressor::SetCheckpointOptions(uint32_t intervalSeconds, bool resume) {
+    checkpointInterval_ = intervalSeconds;
+    resume_ = resume;
+}
+
+void CHDCompressor::SetDeclaredInputSize(uint64_t size) {
+    declaredInputSize_ = size;
+}
+
+void CHDCompressor::SetReuseFile(const std::string& path) {
+    reuseFile_ = path;
+}
+
+void CHDCompressor::SetCacheDirectory(const std::string& directory) {
+    cacheDirectory_ = directory;
+}
+
+void CHDCompressor::SetJobControl(JobControl* control) {
+    control_ = control;
+}
+
+void CHDCompressor::SetSharedPools(WorkerPool* threads, BufferPool* buffers) {
+    threads_.SetPool(threads);
+    buffers_ = buffers;
+}
+
 TaskStatus CHDCompressor::Compress(const std::string& inputFile, const std::string& outputFile) {
     // Inizializza compressione
-    if (!InitializeCompression(inputFile, outputFile)) {
+    if (!InitializeCompression(inputFile)) {
         CleanupCompression();
         return TASK_ERROR;
     }
@@ -45,69 +98,89 @@ TaskStatus CHDCompressor::Compress(const std::string& inputFile, const std::stri
         return TASK_ERROR;
     }
 
+    // Prepara codec e buffer per la dimensione hunk definitiva
+    if (!SetupCodecs()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+
     // Calcola numero totale di hunk
     totalHunks_ = static_cast<uint32_t>((inputSize_ + hunkSize_ - 1) / hunkSize_);
     
     // Prepara mappa hunk
-    hunkMap_.resize(totalHunks_);
+    hunkMap_.assign(totalHunks_, CHDMapEntry{});
+    rawDigest_.Reset();
+    OpenReuse();
+
+    // Apri l'output, eventualmente riprendendo dal journal
+    JournalState resumeState;
+    if (!OpenOutput(inputFile, outputFile, resumeState)) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
     
     // Scrivi header placeholder
-    outputPos_ = CHD_V5_HEADER_SIZE;
-    if (fseek(outputFile_, outputPos_, SEEK_SET) != 0) {
+    outputPos_ = CHD_HEADER_SIZE;
+    if (!output_->Seek(outputPos_)) {
         CleanupCompression();
         return TASK_ERROR;
     }
 
-    // Riserva spazio per mappa hunk
+    // Riserva spazio per mappa hunk (o riparti dall'ultimo checkpoint)
     uint64_t mapSize = totalHunks_ * sizeof(CHDMapEntry);
     uint64_t mapOffset = outputPos_;
-    outputPos_ += mapSize;
-    if (fseek(outputFile_, outputPos_, SEEK_SET) != 0) {
+    outputPos_ = (resumeState.outputPos > 0) ? resumeState.outputPos : outputPos_ + mapSize;
+    if (!output_->Seek(outputPos_)) {
         CleanupCompression();
         return TASK_ERROR;
     }
 
-    // Comprimi hunk uno alla volta
-    for (currentHunk_ = 0; currentHunk_ < totalHunks_; ++currentHunk_) {
-        // Leggi hunk
-        if (!ReadInputHunk(currentHunk_, inputBuffer_.data())) {
-            CleanupCompression();
-            return TASK_ERROR;
-        }
+    // Hunk già salvati prima dell'interruzione: i duplicati successivi puntano ancora a loro
+    RebuildStoredHunks(resumeState.committedBlocks);
+    previousValid_ = false;
+    miniHunks_ = 0;
+    selfHunks_ = 0;
+    reusedHunks_ = 0;
 
-        // Determina se comprimere
-        if (ShouldCompressHunk(inputBuffer_.data(), hunkSize_)) {
-            // Prova compressione
-            int bestCompressedSize = -1;
-            
-            // Prova Zlib
-            if (config_.codecs & CHD_CODEC_CDLZ) {
-                int zlibSize = CompressWithZlib(inputBuffer_.data(), hunkSize_, 
-                                              outputBuffer_.data(), outputBuffer_.size());
-                if (zlibSize > 0 && (bestCompressedSize == -1 || zlibSize < bestCompressedSize)) {
-                    bestCompressedSize = zlibSize;
-                }
-            }
-            
-            // Usa risultato compresso se conveniente
-            if (bestCompressedSize > 0 && bestCompressedSize < hunkSize_ * 0.9) {
-                if (!WriteCompressedHunk(outputBuffer_.data(), bestCompressedSize, currentHunk_)) {
-                    CleanupCompression();
-                    return TASK_ERROR;
-                }
-            } else {
-                // Compressione non conveniente, salva non compresso
-                if (!WriteUncompressedHunk(inputBuffer_.data(), currentHunk_)) {
-                    CleanupCompression();
-                    return TASK_ERROR;
-                }
+    // Pipeline: il thread principale legge e classifica gli hunk in ordine,
+    // i worker li comprimono e il thread principale li scrive in ordine
+    if (!CreateWorkers(resumeState.committedBlocks)) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    OpenCache();
+    SelectHunkLoop();
+    const uint32_t window = static_cast<uint32_t>(slots_.size());
+    uint32_t nextHunk = resumeState.committedBlocks;
+
+    for (currentHunk_ = resumeState.committedBlocks; currentHunk_ < totalHunks_; ++currentHunk_) {
+        // Riempi la finestra: lettura, CRC e ricerca dei duplicati non si sovrappongono
+        while (nextHunk < totalHunks_ && nextHunk - currentHunk_ < window) {
+            // Controllo per hunk: una lettura atomica, attesa solo in pausa
+            if (control_ && !control_->WaitIfPaused()) {
+                return CancelCompression(outputFile);
             }
-        } else {
-            // Non comprimere questo hunk
-            if (!WriteUncompressedHunk(inputBuffer_.data(), currentHunk_)) {
+            if (!ReadHunk(nextHunk)) {
                 CleanupCompression();
                 return TASK_ERROR;
             }
+            nextHunk++;
+        }
+
+        // Scrivi il prossimo hunk in ordine, appena il worker lo ha completato
+        uint32_t index;
+        completedHunks_->Take(index);
+        if (control_ && control_->IsCancelled()) {
+            return CancelCompression(outputFile);
+        }
+        if (!WriteHunk(slots_[index])) {
+            CleanupCompression();
+            return TASK_ERROR;
+        }
+
+        // Checkpoint: l'hunk corrente è già scritto e registrato nella mappa
+        if (journal_.ShouldCheckpoint() && !SaveCheckpoint(currentHunk_ + 1)) {
+            std::cerr << "Avviso: checkpoint non riuscito per " << outputFile << std::endl;
         }
 
         // Aggiorna progresso
@@ -116,13 +189,13 @@ TaskStatus CHDCompressor::Compress(const std::string& inputFile, const std::stri
         }
     }
 
-    // Scrivi mappa hunk
-    if (fseek(outputFile_, mapOffset, SEEK_SET) != 0) {
+    // Impronta delle impostazioni dopo gli hunk, poi mappa hunk
+    if (!WriteSettingsMetadata() || !output_->Seek(mapOffset)) {
         CleanupCompression();
         return TASK_ERROR;
     }
     
-    if (fwrite(hunkMap_.data(), sizeof(CHDMapEntry), totalHunks_, outputFile_) != totalHunks_) {
+    if (!output_->Write(hunkMap_.data(), static_cast<size_t>(totalHunks_) * sizeof(CHDMapEntry))) {
         CleanupCompression();
         return TASK_ERROR;
     }
@@ -139,49 +212,263 @@ TaskStatus CHDCompressor::Compress(const std::string& inputFile, const std::stri
         return TASK_ERROR;
     }
 
-    UpdateProgress("Compressione CHD completata!");
+    // Su stdout il file esce solo ora, completo di header e mappa
+    if (!FinishOutput()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+
+    std::string summary = "hunk a pattern: " + std::to_string(miniHunks_) +
+                          ", ripetuti: " + std::to_string(selfHunks_);
+    if (reuse_) {
+        summary += ", riusati: " + std::to_string(reusedHunks_);
+    }
+    if (cache_) {
+        summary += ", dalla cache: " + std::to_string(cache_->GetHits()) + " su " +
+                   std::to_string(cache_->GetHits() + cache_->GetMisses());
+    }
+    UpdateProgress("Compressione CHD completata (" + summary + ")");
     CleanupCompression();
+    journal_.Remove();
     return TASK_SUCCESS;
 }
 
-bool CHDCompressor::InitializeCompression(const std::string& inputFile, const std::string& outputFile) {
-    // Apri file input
-    inputFile_ = fopen(inputFile.c_str(), "rb");
-    if (!inputFile_) {
-        std::cerr << "Errore: Non posso aprire " << inputFile << std::endl;
-        return false;
+TaskStatus CHDCompressor::Estimate(const std::string& inputFile, uint32_t strata, CompressionEstimate& estimate) {
+    estimate = CompressionEstimate();
+    if (!InitializeCompression(inputFile)) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    if (!input_.IsSeekable()) {
+        std::cerr << "Errore: --estimate richiede un input con accesso casuale" << std::endl;
+        CleanupCompression();
+        return TASK_ERROR;
     }
 
-    // Ottieni dimensione file
-    fseek(inputFile_, 0, SEEK_END);
-    inputSize_ = ftell(inputFile_);
-    fseek(inputFile_, 0, SEEK_SET);
+    // Stessi codec e worker della compressione, senza thread né code
+    if (!AnalyzeInput() || !SetupCodecs() || !SetupWorkers()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    totalHunks_ = static_cast<uint32_t>((inputSize_ + hunkSize_ - 1) / hunkSize_);
+    SelectHunkLoop();
+    UpdateProgress("Stima CHD...");
 
-    if (inputSize_ == 0) {
-        std::cerr << "Errore: File input vuoto" << std::endl;
+    // Porzioni allineate agli hunk: la classificazione dei file vede gli hunk reali
+    BlockSampler sampler;
+    if (!sampler.Load(input_, strata, CHD_ESTIMATE_HUNKS * hunkSize_, hunkSize_)) {
+        std::cerr << "Errore: " << sampler.GetLastError() << std::endl;
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    const std::vector<ImageSample>& samples = sampler.GetSamples();
+    const uint32_t spanHunks = static_cast<uint32_t>(samples[0].data.size() / hunkSize_);
+
+    // Hunk a pattern e ripetuti non costano byte, come in ReadHunk: la ricerca
+    // dei ripetuti vede solo gli hunk campionati (stima prudente su immagini grandi)
+    std::vector<std::vector<CHDHunkKind>> kinds(samples.size());
+    std::unordered_multimap<uint32_t, const uint8_t*> stored;
+    for (size_t s = 0; s < samples.size(); ++s) {
+        for (uint32_t h = 0; h < spanHunks; ++h) {
+            const uint8_t* hunk = samples[s].data.data() + static_cast<size_t>(h) * hunkSize_;
+            uint64_t pattern;
+            CHDHunkKind kind = CHD_HUNK_STORE;
+            uint32_t crc = CalculateCRC32(hunk, hunkSize_);
+            if (IsMiniHunk(hunk, hunkSize_, pattern)) {
+                kind = CHD_HUNK_MINI;
+            } else {
+                auto range = stored.equal_range(crc);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (memcmp(it->second, hunk, hunkSize_) == 0) {
+                        kind = CHD_HUNK_SELF;
+                        break;
+                    }
+                }
+                if (kind == CHD_HUNK_STORE) {
+                    stored.emplace(crc, hunk);
+                }
+            }
+            kinds[s].push_back(kind);
+        }
+    }
+
+    // Ogni thread prende le porzioni da un contatore con il proprio contesto e
+    // un proprio slot
+    std::vector<double> ratios(samples.size(), 0.0);
+    std::vector<double> seconds(samples.size(), 0.0);
+    std::atomic<size_t> next(0);
+    auto worker = [&](CHDWorkerContext& ctx) {
+        Numa::NodeScope scope(numaNodes_ > 1, ctx.node);
+        CHDHunkSlot slot;
+        slot.input.resize(hunkSize_);
+        slot.output.resize(ctx.candidateBuffer.size());
+        for (size_t s = next++; s < samples.size(); s = next++) {
+            uint64_t written = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t h = 0; h < spanHunks; ++h) {
+                if (kinds[s][h] != CHD_HUNK_STORE) {
+                    continue;
+                }
+                memcpy(slot.input.data(), samples[s].data.data() + static_cast<size_t>(h) * hunkSize_, hunkSize_);
+                slot.hunk = static_cast<uint32_t>(samples[s].offset / hunkSize_) + h;
+                slot.size = -1;
+                ProcessHunk(ctx, slot);
+                written += (slot.size > 0) ? static_cast<uint32_t>(slot.size) : hunkSize_;
+            }
+            seconds[s] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ratios[s] = static_cast<double>(written) / samples[s].data.size();
+        }
+    };
+    for (size_t w = 1; w < workers_.size(); ++w) {
+        threads_.Start([&worker, this, w] { worker(workers_[w]); });
+    }
+    worker(workers_[0]);
+    threads_.Join();
+    if (control_ && control_->IsCancelled()) {
+        CleanupCompression();
+        return TASK_CANCELLED;
+    }
+
+    estimate.inputSize = inputSize_;
+    estimate.sampleBytes = sampler.GetSampleBytes();
+    uint64_t overhead = CHD_HEADER_SIZE + static_cast<uint64_t>(totalHunks_) * sizeof(CHDMapEntry);
+    ExtrapolateEstimate(ratios, seconds, static_cast<uint64_t>(spanHunks) * hunkSize_,
+                        static_cast<uint64_t>(totalHunks_) * hunkSize_, overhead,
+                        static_cast<uint32_t>(workers_.size()), estimate);
+    CleanupCompression();
+    return TASK_SUCCESS;
+}
+
+bool CHDCompressor::InitializeCompression(const std::string& inputFile) {
+    // Apri input (file o stdin): la dimensione di una pipe è quella dichiarata,
+    // CSO e CHD vengono decompressi al volo
+    std::string error;
+    if (!OpenImageInput(input_, inputFile, declaredInputSize_, config_.processors, error)) {
+        std::cerr << "Errore: " << error << std::endl;
         return false;
     }
+    inputSize_ = input_.GetSize();
 
-    // Apri file output
-    outputFile_ = fopen(outputFile.c_str(), "wb");
-    if (!outputFile_) {
-        std::cerr << "Errore: Non posso creare " << outputFile << std::endl;
+    // Mappa dei file: richiede accesso casuale, le pipe vanno lette in ordine
+    layout_.Clear();
+    if (config_.fileAnalysis && input_.IsSeekable() && layout_.Analyze(input_)) {
+        UpdateProgress("Analisi file: " + layout_.Summary());
+    }
+
+    if (inputSize_ == 0) {
+        std::cerr << "Errore: File input vuoto" << std::endl;
         return false;
     }
 
     outputPos_ = 0;
+    metaOffset_ = 0;
     return true;
 }
 
 void CHDCompressor::CleanupCompression() {
-    if (inputFile_) {
-        fclose(inputFile_);
-        inputFile_ = nullptr;
+    DestroyWorkers();
+    input_.Close();
+    output_.reset();
+    storedHunks_.clear();
+    reuse_.reset();
+    cache_.reset();     // rende visibili agli altri lavori gli hunk aggiunti
+
+    // SetupCodecs e CreateWorkers riallocano i buffer al prossimo lavoro
+    BufferPool::Release(buffers_, verifyBuffer_);
+    for (auto& slot : slots_) {
+        BufferPool::Release(buffers_, slot.input, slot.node);
+        BufferPool::Release(buffers_, slot.output, slot.node);
     }
-    if (outputFile_) {
-        fclose(outputFile_);
-        outputFile_ = nullptr;
+    std::vector<CHDHunkSlot>().swap(slots_);
+}
+
+TaskStatus CHDCompressor::CancelCompression(const std::string& outputFile) {
+    // Gli hunk già scritti restano validi: --resume riparte da qui
+    if (journal_.IsEnabled() && !SaveCheckpoint(currentHunk_)) {
+        std::cerr << "Avviso: checkpoint non riuscito per " << outputFile << std::endl;
+    }
+    UpdateProgress("Compressione annullata all'hunk " + std::to_string(currentHunk_) +
+                   " di " + std::to_string(totalHunks_));
+    CleanupCompression();
+    return TASK_CANCELLED;
+}
+
+bool CHDCompressor::FinishOutput() {
+    // Dati oltre la dimensione dichiarata: l'immagine sarebbe troncata
+    if (!input_.CheckEnd()) {
+        std::cerr << "Errore: l'input supera la dimensione dichiarata con --size" << std::endl;
+        return false;
     }
+    return output_->Finish();
+}
+
+bool CHDCompressor::OpenOutput(const std::string& inputFile, const std::string& outputFile,
+                               JournalState& resumeState) {
+    resumeState = JournalState();
+
+    // Da pipe o verso stdout non c'è nulla da riprendere: niente journal
+    if (!input_.IsSeekable() || IsStdioPath(outputFile)) {
+        if (resume_) {
+            std::cerr << "Avviso: --resume ignorato per input o output in streaming" << std::endl;
+        }
+        output_ = OutputStream::Open(outputFile);
+        if (!output_) {
+            std::cerr << "Errore: Non posso creare " << outputFile << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    journal_.Open(inputFile, outputFile, JOURNAL_CHD, LayoutFingerprint(), totalHunks_, checkpointInterval_);
+
+    std::vector<uint8_t> table;
+    if (resume_) {
+        if (journal_.Load(resumeState, table) && resumeState.hasDigest &&
+            table.size() == static_cast<size_t>(resumeState.committedBlocks) * sizeof(CHDMapEntry)) {
+            // Scarta quanto scritto dopo l'ultimo checkpoint e riapri senza troncare
+            std::error_code error;
+            std::filesystem::resize_file(outputFile, resumeState.outputPos, error);
+            output_ = error ? nullptr : OutputStream::Open(outputFile, true);
+            if (output_) {
+                memcpy(hunkMap_.data(), table.data(), table.size());
+                rawDigest_.SetState(resumeState.digest);
+                UpdateProgress("Ripresa dall'hunk " + std::to_string(resumeState.committedBlocks) +
+                               " di " + std::to_string(totalHunks_));
+                return true;
+            }
+        }
+        std::cerr << "Nessun checkpoint valido per " << outputFile << ", compressione da capo" << std::endl;
+        resumeState = JournalState();
+    }
+
+    // Un journal rimasto da un altro lavoro non deve poter descrivere il nuovo output
+    journal_.Remove();
+    output_ = OutputStream::Open(outputFile);
+    if (!output_) {
+        std::cerr << "Errore: Non posso creare " << outputFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CHDCompressor::SaveCheckpoint(uint32_t committedHunks) {
+    JournalState state;
+    state.committedBlocks = committedHunks;
+    state.outputPos = outputPos_;
+    state.hasDigest = true;
+    state.digest = rawDigest_.GetState();
+    return journal_.Checkpoint(*output_, state, hunkMap_.data(),
+                               static_cast<size_t>(committedHunks) * sizeof(CHDMapEntry));
+}
+
+uint64_t CHDCompressor::LayoutFingerprint() const {
+    // Posizione della mappa, dimensione hunk e codec attivi (i flag della mappa dipendono dal primo)
+    uint32_t layout[2] = {CHD_HEADER_SIZE, hunkSize_};
+    uint64_t hash = CompressionJournal::Fingerprint(CompressionJournal::FINGERPRINT_SEED, layout, sizeof(layout));
+    for (const auto& slot : codecs_) {
+        hash = CompressionJournal::Fingerprint(hash, &slot.implId, sizeof(slot.implId));
+    }
+    return CompressionJournal::Fingerprint(hash, dictionary_.data(), dictionary_.size());
 }
 
 bool CHDCompressor::AnalyzeInput() {
@@ -196,13 +483,13 @@ bool CHDCompressor::AnalyzeInput() {
         isCD_ = true;
         // Regola hunk size per CD se non specificato
         if (config_.hunkSize == 0) {
-            hunkSize_ = CD_SECTOR_SIZE * 8; // 8 settori per hunk
+            hunkSize_ = CHD_CD_HUNK_SIZE; // 8 settori per hunk
         }
     } else if (inputSize_ % ISO_SECTOR_SIZE == 0) {
         isCD_ = false;
         // Standard ISO
         if (config_.hunkSize == 0) {
-            hunkSize_ = ISO_SECTOR_SIZE * 8;
+            hunkSize_ = CHD_ISO_HUNK_SIZE;
         }
     } else {
         // Hard disk o altro formato
@@ -218,10 +505,6 @@ bool CHDCompressor::AnalyzeInput() {
 bool CHDCompressor::ReadInputHunk(uint32_t hunkIndex, uint8_t* buffer) {
     uint64_t pos = static_cast<uint64_t>(hunkIndex) * hunkSize_;
     
-    if (fseek(inputFile_, pos, SEEK_SET) != 0) {
-        return false;
-    }
-
     // Leggi fino a hunkSize_ byte, anche se l'ultimo hunk è parziale
     size_t toRead = hunkSize_;
     if (pos + hunkSize_ > inputSize_) {
@@ -231,7 +514,7 @@ bool CHDCompressor::ReadInputHunk(uint32_t hunkIndex, uint8_t* buffer) {
     }
 
     if (toRead > 0) {
-        size_t bytesRead = fread(buffer, 1, toRead, inputFile_);
+        size_t bytesRead = input_.ReadAt(pos, buffer, toRead);
         if (bytesRead != toRead) {
             return false;
         }
@@ -240,16 +523,409 @@ bool CHDCompressor::ReadInputHunk(uint32_t hunkIndex, uint8_t* buffer) {
     return true;
 }
 
-bool CHDCompressor::WriteCompressedHunk(const uint8_t* data, uint32_t dataSize, uint32_t hunkIndex) {
-    // Registra nella mappa
-    hunkMap_[hunkIndex].offset = outputPos_;
-    hunkMap_[hunkIndex].crc = CalculateCRC32(inputBuffer_.data(), hunkSize_);
-    hunkMap_[hunkIndex].length_lo = dataSize & 0xFFFF;
-    hunkMap_[hunkIndex].length_hi = (dataSize >> 16) & 0xFF;
-    hunkMap_[hunkIndex].flags = 0; // Compressed
+bool CHDCompressor::SetupWorkers() {
+    // Buffer dimensionati sul caso peggiore dei codec attivi
+    uint32_t bound = hunkSize_;
+    for (const auto& slot : codecs_) {
+        bound = std::max(bound, slot.codec->GetBound(hunkSize_));
+    }
+
+    // --numa: worker e finestra divisi in parti contigue per nodo
+    numaNodes_ = 1;
+    if (config_.numa) {
+        if (Numa::IsAvailable()) {
+            numaNodes_ = std::min(Numa::NodeCount(), config_.processors);
+            UpdateProgress("NUMA: " + std::to_string(numaNodes_) + " nodi");
+        } else {
+            std::cerr << "Avviso: --numa ignorato: un solo nodo NUMA o libnuma non disponibile" << std::endl;
+        }
+    }
+
+    workers_.clear();
+    workers_.resize(config_.processors);
+    for (uint32_t w = 0; w < workers_.size(); ++w) {
+        CHDWorkerContext& worker = workers_[w];
+        worker.node = Numa::ShardOf(w, static_cast<uint32_t>(workers_.size()), numaNodes_);
+
+        // Contesti e buffer creati dal thread principale spostato sul nodo del worker
+        Numa::NodeScope scope(numaNodes_ > 1, worker.node);
+        BufferPool::Acquire(buffers_, worker.candidateBuffer, bound, worker.node);
+        BufferPool::Acquire(buffers_, worker.verifyBuffer, hunkSize_, worker.node);
+        worker.arena = BufferPool::AcquireArena(buffers_, worker.node);
+        for (const auto& slot : codecs_) {
+            CodecOptions options = slot.options;
+            options.arena = worker.arena.get();
+            auto context = slot.codec->CreateContext(options);
+            if (!context) {
+                std::cerr << "Errore: impossibile inizializzare il codec " << slot.codec->GetName()
+                          << " (livello " << options.level << ")" << std::endl;
+                return false;
+            }
+            worker.codecs.push_back(std::move(context));
+        }
+    }
+    return true;
+}
+
+bool CHDCompressor::CreateWorkers(uint32_t firstHunk) {
+    if (!SetupWorkers()) {
+        return false;
+    }
+
+    // Stessa dimensione dei buffer dei worker
+    const size_t bound = workers_[0].candidateBuffer.size();
+    slots_.clear();
+    slots_.resize(static_cast<size_t>(config_.processors) * CHD_HUNKS_PER_WORKER);
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        CHDHunkSlot& slot = slots_[i];
+        slot.node = Numa::ShardOf(i, static_cast<uint32_t>(slots_.size()), numaNodes_);
+        Numa::NodeScope scope(numaNodes_ > 1, slot.node);
+        BufferPool::Acquire(buffers_, slot.input, hunkSize_, slot.node);
+        BufferPool::Acquire(buffers_, slot.output, bound, slot.node);
+    }
+    BufferPool::Acquire(buffers_, verifyBuffer_, hunkSize_);
+
+    // Code grandi quanto la finestra: i worker non attendono mai lo scrittore
+    hunkQueue_ = std::make_unique<ShardedQueue<uint32_t>>(numaNodes_, slots_.size());
+    completedHunks_ = std::make_unique<ReorderBuffer<uint32_t>>(slots_.size(), firstHunk);
+
+    // Con un solo processore gli hunk vengono compressi dal thread principale
+    if (workers_.size() > 1) {
+        for (auto& worker : workers_) {
+            threads_.Start([this, &worker] { WorkerLoop(worker); });
+        }
+    }
+    return true;
+}
+
+void CHDCompressor::DestroyWorkers() {
+    if (hunkQueue_) {
+        hunkQueue_->Close();
+    }
+    threads_.Join();
+    hunkQueue_.reset();
+    completedHunks_.reset();
+
+    // I contesti prima delle arene che ne contengono lo stato
+    for (auto& worker : workers_) {
+        worker.codecs.clear();
+        BufferPool::ReleaseArena(buffers_, worker.arena, worker.node);
+        BufferPool::Release(buffers_, worker.candidateBuffer, worker.node);
+        BufferPool::Release(buffers_, worker.verifyBuffer, worker.node);
+    }
+    workers_.clear();
+}
+
+void CHDCompressor::WorkerLoop(CHDWorkerContext& ctx) {
+    // Su un thread del pool il nodo vale solo per questo lavoro
+    Numa::NodeScope scope(numaNodes_ > 1, ctx.node);
+    uint32_t index;
+    while (hunkQueue_->Pop(ctx.node, index)) {
+        CHDHunkSlot& slot = slots_[index];
+        ProcessHunk(ctx, slot);
+        completedHunks_->Put(slot.hunk, index);
+    }
+}
+
+bool CHDCompressor::ReadHunk(uint32_t hunkIndex) {
+    uint32_t index = hunkIndex % static_cast<uint32_t>(slots_.size());
+    CHDHunkSlot& slot = slots_[index];
+    slot.hunk = hunkIndex;
+    slot.size = -1;
+    slot.reused = false;
+    slot.reuseData.clear();
+
+    if (!ReadInputHunk(hunkIndex, slot.input.data())) {
+        return false;
+    }
+    slot.crc = CalculateCRC32(slot.input.data(), hunkSize_);
+
+    // Riempimento a pattern e hunk ripetuti: solo la voce di mappa, nessun worker.
+    // A parità di CRC resta il primo hunk salvato.
+    uint32_t source;
+    if (IsMiniHunk(slot.input.data(), hunkSize_, slot.reference)) {
+        slot.kind = CHD_HUNK_MINI;
+    } else if (FindDuplicateHunk(slot, source)) {
+        slot.kind = CHD_HUNK_SELF;
+        slot.reference = source;
+    } else {
+        slot.kind = CHD_HUNK_STORE;
+        storedHunks_.emplace(slot.crc, hunkIndex);
+        if (reuse_) {
+            LoadReuseHunk(slot);
+        }
+    }
+    previousValid_ = true;
+
+    if (slot.kind != CHD_HUNK_STORE) {
+        completedHunks_->Put(hunkIndex, index);
+    } else if (threads_.IsEmpty()) {
+        ProcessHunk(workers_[0], slot);
+        completedHunks_->Put(hunkIndex, index);
+    } else {
+        hunkQueue_->Push(slot.node, index);
+    }
+    return true;
+}
+
+void CHDCompressor::SelectHunkLoop() {
+    // Indice: analisi dei file, cache
+    static const HunkLoop defaultLoops[4] = {
+        &CHDCompressor::ProcessHunkAs<CHD_DEFAULT_HUNK_SIZE, false, false>,
+        &CHDCompressor::ProcessHunkAs<CHD_DEFAULT_HUNK_SIZE, false, true>,
+        &CHDCompressor::ProcessHunkAs<CHD_DEFAULT_HUNK_SIZE, true, false>,
+        &CHDCompressor::ProcessHunkAs<CHD_DEFAULT_HUNK_SIZE, true, true>,
+    };
+    static const HunkLoop cdLoops[4] = {
+        &CHDCompressor::ProcessHunkAs<CHD_CD_HUNK_SIZE, false, false>,
+        &CHDCompressor::ProcessHunkAs<CHD_CD_HUNK_SIZE, false, true>,
+        &CHDCompressor::ProcessHunkAs<CHD_CD_HUNK_SIZE, true, false>,
+        &CHDCompressor::ProcessHunkAs<CHD_CD_HUNK_SIZE, true, true>,
+    };
+    static const HunkLoop isoLoops[4] = {
+        &CHDCompressor::ProcessHunkAs<CHD_ISO_HUNK_SIZE, false, false>,
+        &CHDCompressor::ProcessHunkAs<CHD_ISO_HUNK_SIZE, false, true>,
+        &CHDCompressor::ProcessHunkAs<CHD_ISO_HUNK_SIZE, true, false>,
+        &CHDCompressor::ProcessHunkAs<CHD_ISO_HUNK_SIZE, true, true>,
+    };
+    static const HunkLoop anyLoops[4] = {
+        &CHDCompressor::ProcessHunkAs<0, false, false>,
+        &CHDCompressor::ProcessHunkAs<0, false, true>,
+        &CHDCompressor::ProcessHunkAs<0, true, false>,
+        &CHDCompressor::ProcessHunkAs<0, true, true>,
+    };
+    size_t loop = (!layout_.IsEmpty() ? 2 : 0) + (cache_ ? 1 : 0);
+    switch (hunkSize_) {
+        case CHD_DEFAULT_HUNK_SIZE:
+            hunkLoop_ = defaultLoops[loop];
+            break;
+        case CHD_CD_HUNK_SIZE:
+            hunkLoop_ = cdLoops[loop];
+            break;
+        case CHD_ISO_HUNK_SIZE:
+            hunkLoop_ = isoLoops[loop];
+            break;
+        default:
+            hunkLoop_ = anyLoops[loop];
+            break;
+    }
+}
+
+template <uint32_t HunkSize, bool Layout, bool Cache>
+void CHDCompressor::ProcessHunkAs(CHDWorkerContext& ctx, CHDHunkSlot& slot) {
+    const uint32_t hunkSize = HunkSize ? HunkSize : hunkSize_;
+
+    // Annullamento: lo scrittore scarta l'hunk
+    if (control_ && control_->IsCancelled()) {
+        return;
+    }
+    if (!slot.reuseData.empty() && VerifyReuse(ctx, slot)) {
+        return;
+    }
+
+    // Determina se comprimere: la mappa dei file, se classifica l'hunk,
+    // sostituisce l'euristica sui byte
+    ContentClass content = CONTENT_UNKNOWN;
+    if constexpr (Layout) {
+        uint64_t hunkStart = static_cast<uint64_t>(slot.hunk) * hunkSize;
+        content = layout_.ClassifyRange(hunkStart, hunkSize);
+        if (content == CONTENT_COMPRESSED && layout_.HasRawSectors()) {
+            // Nei settori raw l'intestazione e l'ECC restano comprimibili: basta il primo codec
+            content = CONTENT_PADDING;
+        }
+    }
+    bool compress = (content == CONTENT_UNKNOWN) ? ShouldCompressHunk(slot.input.data(), hunkSize)
+                                                 : content != CONTENT_COMPRESSED;
+    if (!compress) {
+        return;
+    }
+
+    // Hunk già compresso in un'altra immagine: nessun codec
+    uint8_t key[BlockCache::KEY_SIZE];
+    if constexpr (Cache) {
+        BlockCache::MakeKey(slot.input.data(), hunkSize, content, key);
+        if (LookupCache(slot, key)) {
+            return;
+        }
+    }
+    slot.size = CompressHunk<HunkSize>(ctx, slot, content);
+    if constexpr (Cache) {
+        int codec = -1;
+        for (size_t i = 0; slot.size > 0 && i < codecs_.size(); ++i) {
+            if (codecs_[i].implId == slot.implId) {
+                codec = static_cast<int>(i);
+            }
+        }
+        cache_->Store(key, slot.output.data(), slot.size, codec);
+    }
+}
+
+bool CHDCompressor::LookupCache(CHDHunkSlot& slot, const uint8_t key[BlockCache::KEY_SIZE]) {
+    int size;
+    int codec;
+    if (!cache_->Lookup(key, slot.output.data(), static_cast<uint32_t>(slot.output.size()), size, codec)) {
+        return false;
+    }
+    if (size > 0 && (codec < 0 || static_cast<size_t>(codec) >= codecs_.size())) {
+        return false;
+    }
+    slot.size = size;
+    if (size > 0) {
+        slot.implId = codecs_[codec].implId;
+    }
+    return true;
+}
+
+void CHDCompressor::OpenCache() {
+    cache_.reset();
+    if (cacheDirectory_.empty()) {
+        return;
+    }
+    // Una cache inutilizzabile non impedisce la compressione
+    auto cache = std::make_unique<BlockCache>();
+    if (!cache->Open(cacheDirectory_, CacheConfiguration(), dictionary_)) {
+        std::cerr << "Avviso: --cache ignorato: " << cache->GetLastError() << std::endl;
+        return;
+    }
+    UpdateProgress("Cache: " + std::to_string(cache->GetEntryCount()) + " hunk");
+    cache_ = std::move(cache);
+}
+
+std::string CHDCompressor::CacheConfiguration() const {
+    // Dimensione hunk e codec nell'ordine di prova, con i livelli
+    std::string text = "chd " + std::to_string(hunkSize_);
+    for (const auto& slot : codecs_) {
+        text += " " + std::string(slot.codec->GetName()) + ":" + std::to_string(slot.options.level) +
+                ":" + std::to_string(slot.implId);
+    }
+    return text;
+}
+
+bool CHDCompressor::WriteHunk(CHDHunkSlot& slot) {
+    // Il digest copre solo i dati logici, non il riempimento dell'ultimo hunk;
+    // aggiornato in scrittura perché il checkpoint lo salva con gli hunk scritti
+    uint64_t hunkStart = static_cast<uint64_t>(slot.hunk) * hunkSize_;
+    rawDigest_.Update(slot.input.data(), static_cast<size_t>(std::min<uint64_t>(hunkSize_, inputSize_ - hunkStart)));
+
+    switch (slot.kind) {
+        case CHD_HUNK_MINI:
+            SetMapEntry(slot.hunk, slot.reference, slot.crc, 0, CHD_MAP_MINI);
+            miniHunks_++;
+            return true;
+        case CHD_HUNK_SELF:
+            SetMapEntry(slot.hunk, slot.reference, slot.crc, 0, CHD_MAP_SELF_HUNK);
+            selfHunks_++;
+            return true;
+        default:
+            break;
+    }
+
+    if (slot.reused) {
+        reusedHunks_++;
+        return WriteCompressedHunk(slot.reuseData.data(), static_cast<uint32_t>(slot.reuseData.size()),
+                                   slot.hunk, codecs_[slot.reuseCodec].implId, slot.crc);
+    }
+    if (slot.size > 0) {
+        return WriteCompressedHunk(slot.output.data(), slot.size, slot.hunk, slot.implId, slot.crc);
+    }
+    // Compressione non conveniente, salva non compresso
+    return WriteUncompressedHunk(slot.input.data(), slot.hunk, slot.crc);
+}
+
+void CHDCompressor::SettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]) const {
+    // L'analisi dei file decide gli hunk di riempimento e quelli già compressi
+    std::string text = CacheConfiguration() + " layout " + std::to_string(!layout_.IsEmpty());
+    SHA1 sha;
+    sha.Update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    sha.Update(dictionary_.data(), dictionary_.size());
+    sha.Final(digest);
+}
+
+bool CHDCompressor::WriteSettingsMetadata() {
+    CHDMetadataEntry entry = {};
+    memcpy(entry.tag, CHD_SETTINGS_TAG, sizeof(entry.tag));
+    entry.length[2] = static_cast<uint8_t>(SHA1::DIGEST_SIZE);
+    uint8_t digest[SHA1::DIGEST_SIZE];
+    SettingsDigest(digest);
+    if (!output_->Seek(outputPos_) || !output_->Write(&entry, sizeof(entry)) ||
+        !output_->Write(digest, sizeof(digest))) {
+        return false;
+    }
+    metaOffset_ = outputPos_;
+    outputPos_ += sizeof(entry) + sizeof(digest);
+    return true;
+}
+
+void CHDCompressor::OpenReuse() {
+    reuse_.reset();
+    if (reuseFile_.empty()) {
+        return;
+    }
+
+    // Un file precedente inutilizzabile non impedisce la compressione
+    auto reader = std::make_unique<CHDReader>();
+    if (!reader->Open(reuseFile_)) {
+        std::cerr << "Avviso: --reuse ignorato: " << reader->GetLastError() << std::endl;
+        return;
+    }
+    if (reader->GetHunkSize() != hunkSize_ || reader->GetLogicalBytes() != inputSize_) {
+        std::cerr << "Avviso: --reuse ignorato: dimensione o hunk diversi in " << reuseFile_ << std::endl;
+        return;
+    }
+
+    // Solo con gli stessi codec nello stesso ordine, livelli, analisi dei file e
+    // dizionario il vecchio file ha scelto per ogni hunk il codec di adesso
+    uint8_t expected[SHA1::DIGEST_SIZE];
+    uint8_t stored[SHA1::DIGEST_SIZE];
+    SettingsDigest(expected);
+    if (!reader->ReadSettingsDigest(stored) || memcmp(stored, expected, sizeof(expected)) != 0) {
+        std::cerr << "Avviso: --reuse ignorato: " << reuseFile_ << " è stato scritto con impostazioni diverse" << std::endl;
+        return;
+    }
+
+    UpdateProgress("Riuso degli hunk da " + reuseFile_);
+    reuse_ = std::move(reader);
+}
+
+void CHDCompressor::LoadReuseHunk(CHDHunkSlot& slot) {
+    // Senza candidato reuseData resta vuoto e l'hunk viene compresso
+    const CHDMapEntry& entry = reuse_->GetMapEntry(slot.hunk);
+    if (CHDReader::GetEntryType(entry) != CHD_MAP_COMPRESSED || entry.crc != slot.crc) {
+        return;
+    }
+
+    uint32_t implId = reuse_->GetEntryCodec(entry);
+    auto codec = std::find_if(codecs_.begin(), codecs_.end(), [implId](const CHDCodecSlot& s) {
+        return s.implId == implId;
+    });
+    if (codec == codecs_.end()) {
+        return;
+    }
+    if (!reuse_->ReadStored(entry, slot.reuseData)) {
+        slot.reuseData.clear();
+        return;
+    }
+    slot.reuseCodec = static_cast<uint32_t>(codec - codecs_.begin());
+}
+
+bool CHDCompressor::VerifyReuse(CHDWorkerContext& ctx, CHDHunkSlot& slot) {
+    // Il CRC della mappa seleziona l'hunk, la decodifica lo conferma
+    int decoded = ctx.codecs[slot.reuseCodec]->Decompress(slot.reuseData.data(),
+                                                          static_cast<uint32_t>(slot.reuseData.size()),
+                                                          ctx.verifyBuffer.data(), hunkSize_);
+    slot.reused = decoded == static_cast<int>(hunkSize_) &&
+                  memcmp(ctx.verifyBuffer.data(), slot.input.data(), hunkSize_) == 0;
+    return slot.reused;
+}
+
+bool CHDCompressor::WriteCompressedHunk(const uint8_t* data, uint32_t dataSize, uint32_t hunkIndex, uint32_t implId, uint32_t crc) {
+    // Registra nella mappa: il codec dell'header non viene ripetuto nei flag
+    uint32_t codecBits = (codecs_.empty() || implId == codecs_[0].implId) ? 0 : implId;
+    SetMapEntry(hunkIndex, outputPos_, crc, dataSize,
+                static_cast<uint8_t>(CHD_MAP_COMPRESSED | (codecBits << CHD_MAP_CODEC_SHIFT)));
     
     // Scrivi i dati compressi
-    if (fwrite(data, 1, dataSize, outputFile_) != dataSize) {
+    if (!output_->Write(data, dataSize)) {
         return false;
     }
     
@@ -257,16 +933,12 @@ bool CHDCompressor::WriteCompressedHunk(const uint8_t* data, uint32_t dataSize,
     return true;
 }
 
-bool CHDCompressor::WriteUncompressedHunk(const uint8_t* data, uint32_t hunkIndex) {
+bool CHDCompressor::WriteUncompressedHunk(const uint8_t* data, uint32_t hunkIndex, uint32_t crc) {
     // Registra nella mappa
-    hunkMap_[hunkIndex].offset = outputPos_;
-    hunkMap_[hunkIndex].crc = CalculateCRC32(data, hunkSize_);
-    hunkMap_[hunkIndex].length_lo = hunkSize_ & 0xFFFF;
-    hunkMap_[hunkIndex].length_hi = (hunkSize_ >> 16) & 0xFF;
-    hunkMap_[hunkIndex].flags = 1; // Uncompressed
+    SetMapEntry(hunkIndex, outputPos_, crc, hunkSize_, CHD_MAP_UNCOMPRESSED);
     
     // Scrivi i dati non compressi
-    if (fwrite(data, 1, hunkSize_, outputFile_) != hunkSize_) {
+    if (!output_->Write(data, hunkSize_)) {
         return false;
     }
     
@@ -274,35 +946,136 @@ bool CHDCompressor::WriteUncompressedHunk(const uint8_t* data, uint32_t hunkInde
     return true;
 }
 
-int CHDCompressor::CompressWithZlib(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize) {
-    z_stream strm;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    
-    // Inizializza deflate con livello di compressione massimo
-    if (deflateInit(&strm, Z_BEST_COMPRESSION) != Z_OK) {
-        return -1;
+void CHDCompressor::SetMapEntry(uint32_t hunkIndex, uint64_t offset, uint32_t crc, uint32_t length, uint8_t flags) {
+    CHDMapEntry& entry = hunkMap_[hunkIndex];
+    entry.offset = offset;
+    entry.crc = crc;
+    entry.length_lo = length & 0xFFFF;
+    entry.length_hi = (length >> 16) & 0xFF;
+    entry.flags = flags;
+}
+
+bool CHDCompressor::IsMiniHunk(const uint8_t* data, uint32_t size, uint64_t& pattern) {
+    // Hunk periodico su 8 byte: zeri, 0xFF e riempimenti a parola
+    if (size < 8 || memcmp(data, data + 8, size - 8) != 0) {
+        return false;
     }
-    
-    strm.avail_in = inputSize;
-    strm.next_in = const_cast<uint8_t*>(input);
-    strm.avail_out = outputSize;
-    strm.next_out = output;
-    
-    int result = deflate(&strm, Z_FINISH);
-    deflateEnd(&strm);
-    
-    if (result == Z_STREAM_END) {
-        return outputSize - strm.avail_out;
+    pattern = 0;
+    for (int i = 0; i < 8; ++i) {
+        pattern = (pattern << 8) | data[i];
     }
-    
-    return -1;
+    return true;
 }
 
-int CHDCompressor::CompressWithLZMA(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize) {
-    // TODO: Implementare LZMA quando disponibile
-    return -1;
+bool CHDCompressor::FindDuplicateHunk(const CHDHunkSlot& slot, uint32_t& source) {
+    auto found = storedHunks_.find(slot.crc);
+    if (found == storedHunks_.end()) {
+        return false;
+    }
+    source = found->second;
+
+    // Il CRC seleziona il candidato, il confronto dei byte lo conferma.
+    // L'hunk precedente è ancora nella finestra: non serve rileggerlo.
+    const uint8_t* candidate;
+    if (previousValid_ && source + 1 == slot.hunk) {
+        candidate = slots_[source % slots_.size()].input.data();
+    } else if (input_.IsSeekable()) {
+        if (!ReadInputHunk(source, verifyBuffer_.data())) {
+            return false;
+        }
+        candidate = verifyBuffer_.data();
+    } else {
+        return false; // Pipe: gli hunk lontani non si possono rileggere
+    }
+    return memcmp(candidate, slot.input.data(), hunkSize_) == 0;
+}
+
+void CHDCompressor::RebuildStoredHunks(uint32_t committedHunks) {
+    // Stesso ordine di inserimento della compressione da capo: l'output non cambia
+    storedHunks_.clear();
+    for (uint32_t i = 0; i < committedHunks; ++i) {
+        uint8_t type = hunkMap_[i].flags & CHD_MAP_TYPE_MASK;
+        if (type == CHD_MAP_COMPRESSED || type == CHD_MAP_UNCOMPRESSED) {
+            storedHunks_.emplace(hunkMap_[i].crc, i);
+        }
+    }
+}
+
+bool CHDCompressor::SetupCodecs() {
+    codecs_.clear();
+
+    dictionary_.clear();
+    if ((config_.codecs & CHD_CODEC_ZSTD) && !config_.zstdDictionary.empty()) {
+        if (!Utils::ReadFileData(config_.zstdDictionary, dictionary_) || dictionary_.empty()) {
+            std::cerr << "Impossibile leggere il dizionario zstd: " << config_.zstdDictionary << std::endl;
+            return false;
+        }
+    }
+
+    codecs_ = BuildCodecSlots(config_, hunkSize_, dictionary_);
+    return true;
+}
+
+std::vector<CHDCodecSlot> CHDCompressor::BuildCodecSlots(const CHDConfig& config, uint32_t hunkSize,
+                                                         const std::vector<uint8_t>& dictionary) {
+    std::vector<CHDCodecSlot> slots;
+    for (const auto& entry : CHD_CODEC_TABLE) {
+        if (!(config.codecs & entry.configFlag)) {
+            continue;
+        }
+        // Codec non presente in questa build (es. FLAC): viene ignorato
+        const Codec* codec = CodecRegistry::Instance().Find(entry.codecName);
+        if (!codec) {
+            continue;
+        }
+
+        CodecOptions options;
+        options.level = codec->GetProfile().maxLevel;
+        options.blockSizeHint = hunkSize;
+        if (codec->GetFormat() == CODEC_FORMAT_ZSTD && config.zstdLevel > 0) {
+            options.level = config.zstdLevel;
+        }
+        if (!dictionary.empty() && codec->HasCapability(CODEC_CAP_DICTIONARY)) {
+            options.dictionary = dictionary.data();
+            options.dictionarySize = static_cast<uint32_t>(dictionary.size());
+        }
+
+        // I contesti vengono creati per ciascun worker da CreateWorkers
+        CHDCodecSlot slot;
+        slot.codec = codec;
+        slot.options = options;
+        slot.implId = entry.implId;
+        slot.configFlag = entry.configFlag;
+        slots.push_back(slot);
+    }
+    return slots;
+}
+
+template <uint32_t HunkSize>
+int CHDCompressor::CompressHunk(CHDWorkerContext& ctx, CHDHunkSlot& slot, ContentClass content) {
+    const uint32_t hunkSize = HunkSize ? HunkSize : hunkSize_;
+
+    // Conveniente solo sotto il 90% dell'hunk: oltre il limite il codec si interrompe
+    uint32_t limit = static_cast<uint32_t>(hunkSize * 0.9);
+    int bestSize = -1;
+
+    for (size_t i = 0; i < codecs_.size(); ++i) {
+        if (limit == 0) {
+            break;
+        }
+        int result = ctx.codecs[i]->Compress(slot.input.data(), hunkSize, ctx.candidateBuffer.data(), limit);
+        if (result > 0) {
+            bestSize = result;
+            slot.implId = codecs_[i].implId;
+            limit = static_cast<uint32_t>(result - 1);
+            slot.output.swap(ctx.candidateBuffer);
+        }
+        if (content == CONTENT_PADDING) {
+            break;
+        }
+    }
+
+    return bestSize;
 }
 
 bool CHDCompressor::WriteHeader() {
@@ -312,30 +1085,34 @@ bool CHDCompressor::WriteHeader() {
     memcpy(header.magic, CHD_MAGIC, 8);
     
     // Struttura header
-    header.length = CHD_V5_HEADER_SIZE;
+    header.length = CHD_HEADER_SIZE;
     header.version = CHD_HEADER_VERSION;
     header.flags = 0;
-    header.compression = CHD_CODEC_ZLIB_IMPL; // TODO: Impostare basato sui codec usati
+    header.compression = codecs_.empty() ? 0 : codecs_[0].implId;
     header.hunksize = hunkSize_;
     header.totalhunks = totalHunks_;
     header.logicalbytes = inputSize_;
-    header.metaoffset = 0; // TODO: Implementare metadata
-    header.mapoffset = CHD_V5_HEADER_SIZE;
+    header.metaoffset = metaOffset_;
+    header.mapoffset = CHD_HEADER_SIZE;
     
-    // TODO: Calcolare checksum reali
+    // rawsha1 copre i dati logici; senza metadata con checksum lo SHA-1
+    // complessivo è quello di rawsha1 (come in chdman)
     memset(header.md5, 0, 16);
     memset(header.parentmd5, 0, 16);
-    memset(header.sha1, 0, 20);
     memset(header.parentsha1, 0, 20);
-    memset(header.rawsha1, 0, 20);
     memset(header.parentrawsha1, 0, 20);
+    SHA1 rawDigest = rawDigest_;
+    rawDigest.Final(header.rawsha1);
+    SHA1 overall;
+    overall.Update(header.rawsha1, sizeof(header.rawsha1));
+    overall.Final(header.sha1);
     
     // Scrivi header all'inizio del file
-    if (fseek(outputFile_, 0, SEEK_SET) != 0) {
+    if (!output_->Seek(0)) {
         return false;
     }
     
-    if (fwrite(&header, sizeof(header), 1, outputFile_) != 1) {
+    if (!output_->Write(&header, sizeof(header))) {
         return false;
     }
     
@@ -399,21 +1176,8 @@ bool CHDCompressor::ShouldCompressHunk(const uint8_t* data, uint32_t size) {
 }
 
 uint32_t CHDCompressor::CalculateCRC32(const uint8_t* data, uint32_t size) {
-    // Implementazione CRC32 semplice
-    uint32_t crc = 0xFFFFFFFF;
-    
-    static const uint32_t crc_table[256] = {
-        0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
-        0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-        // ... (tabella CRC32 completa)
-        // Per brevità, uso una versione semplificata
-    };
-    
-    for (uint32_t i = 0; i < size; ++i) {
-        crc = (crc >> 8) ^ crc_table[(crc ^ data[i]) & 0xFF];
-    }
-    
-    return crc ^ 0xFFFFFFFF;
+    // CRC-32 di zlib (stesso polinomio di chdman)
+    return static_cast<uint32_t>(crc32(0L, data, size));
 }
 
 bool CHDCompressor::DetectCDFormat() {
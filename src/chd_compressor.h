@@ -2,13 +2,28 @@
 #define CHD_COMPRESSOR_H
 
 #include "universal_compressor.h"
+#include "block_cache.h"
+#include "codec_arena.h"
+#include "codec_registry.h"
+#include "disc_layout.h"
+#include "job_control.h"
+#include "journal.h"
+#include "numa_placement.h"
+#include "stream_io.h"
+#include "sha1.h"
+#include "work_queue.h"
+#include "worker_pool.h"
 #include <cstdint>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <thread>
+#include <unordered_map>
 
 namespace UniversalCompressor {
 
+class CHDReader;
+
 // Costanti CHD (basate su MAME chdman)
 static const char* CHD_MAGIC = "MComprHD";
 static const uint32_t CHD_HEADER_VERSION = 5;
@@ -20,6 +35,19 @@ static const uint32_t CHD_CODEC_ZLIB_IMPL = 1;
 static const uint32_t CHD_CODEC_LZMA_IMPL = 2;
 static const uint32_t CHD_CODEC_HUFFMAN_IMPL = 3;
 static const uint32_t CHD_CODEC_FLAC_IMPL = 4;
+static const uint32_t CHD_CODEC_ZSTD_IMPL = 5;
+
+// Flag delle voci di mappa: tipo nei 4 bit bassi, codec nei 4 alti
+// (0 = codec indicato nell'header, altrimenti CHD_CODEC_*_IMPL).
+// MINI e SELF_HUNK non occupano spazio nel file (numerazione di chdman v4):
+// MINI = hunk formato da un pattern di 8 byte ripetuto, salvato big-endian in offset;
+// SELF_HUNK = copia di un hunk precedente, il cui indice è in offset.
+static const uint8_t CHD_MAP_COMPRESSED = 0x00;
+static const uint8_t CHD_MAP_UNCOMPRESSED = 0x01;
+static const uint8_t CHD_MAP_MINI = 0x03;
+static const uint8_t CHD_MAP_SELF_HUNK = 0x04;
+static const uint8_t CHD_MAP_TYPE_MASK = 0x0F;
+static const uint8_t CHD_MAP_CODEC_SHIFT = 4;
 
 // Strutture CHD
 #pragma pack(push, 1)
@@ -49,8 +77,25 @@ struct CHDMapEntry {
     uint8_t length_hi;      // Upper 8 bits of length
     uint8_t flags;          // Flags
 };
+
+// Voce di metadata come in chdman: tag, flag, lunghezza a 24 bit big-endian,
+// offset della voce successiva (0 = ultima), poi i dati
+struct CHDMetadataEntry {
+    char tag[4];
+    uint8_t flags;
+    uint8_t length[3];
+    uint64_t next;
+};
 #pragma pack(pop)
 
+// Impronta delle impostazioni che hanno deciso gli hunk (SHA-1), in una voce di
+// metadata senza checksum: --reuse copia gli hunk solo da un file con la stessa
+inline constexpr char CHD_SETTINGS_TAG[] = "UCFG";
+
+// Header effettivamente scritto: con i campi MD5 di v3/v4 è più lungo dei 124 byte
+// di v5, quindi la mappa parte da qui (prima l'header ne sovrascriveva l'inizio)
+static const uint32_t CHD_HEADER_SIZE = sizeof(CHDHeader);
+
 // Metadata per CD
 struct CDTrackInfo {
     uint32_t trackNumber;
@@ -63,6 +108,63 @@ struct CDTrackInfo {
     uint32_t postgap;
 };
 
+// Codec del registro corrispondente a un CHD_CODEC_*_IMPL (nullptr se assente)
+const Codec* FindCHDCodec(uint32_t implId);
+
+// Codec attivo per gli hunk: codec del registro, opzioni e id nel formato CHD
+// (i contesti appartengono ai worker)
+struct CHDCodecSlot {
+    const Codec* codec;
+    CodecOptions options;
+    uint32_t implId;
+    uint32_t configFlag;    // bit CHDCodec corrispondente
+};
+
+// Hunk in volo per ciascun worker: la finestra tra lettura e scrittura
+static const uint32_t CHD_HUNKS_PER_WORKER = 4;
+
+// Hunk contigui di ogni porzione campionata da --estimate
+static const uint32_t CHD_ESTIMATE_HUNKS = 4;
+
+// Dimensioni hunk comuni (predefinita di --chd-hunk, 8 settori CD raw o ISO):
+// hanno un ciclo degli hunk istanziato con la dimensione costante, le altre
+// usano quella letta a runtime
+static const uint32_t CHD_DEFAULT_HUNK_SIZE = 2448 * 8;
+static const uint32_t CHD_CD_HUNK_SIZE = 2352 * 8;
+static const uint32_t CHD_ISO_HUNK_SIZE = 2048 * 8;
+
+// Come viene salvato un hunk, deciso in ordine al momento della lettura
+enum CHDHunkKind {
+    CHD_HUNK_MINI,      // solo la voce di mappa con il pattern
+    CHD_HUNK_SELF,      // copia di un hunk già salvato
+    CHD_HUNK_STORE      // compresso dai worker (o copiato da --reuse)
+};
+
+// Hunk della finestra: dati letti e risultato del worker
+struct CHDHunkSlot {
+    uint32_t node = 0;              // nodo NUMA dei buffer (con --numa)
+    uint32_t hunk = 0;
+    uint32_t crc = 0;
+    CHDHunkKind kind = CHD_HUNK_STORE;
+    uint64_t reference = 0;         // pattern MINI o hunk sorgente SELF
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    int size = -1;                  // byte compressi in output, -1 = salva non compresso
+    uint32_t implId = 0;
+    std::vector<uint8_t> reuseData; // hunk del vecchio file con lo stesso CRC (vuoto = nessuno)
+    uint32_t reuseCodec = 0;        // indice in codecs_ del codec di reuseData
+    bool reused = false;            // reuseData decodifica esattamente in input
+};
+
+// Stato privato di un worker: contesti (uno per codec attivo) e buffer
+struct CHDWorkerContext {
+    std::unique_ptr<CodecArena> arena;  // stato dei codec, distrutta dopo i contesti
+    std::vector<std::unique_ptr<CodecContext>> codecs;
+    std::vector<uint8_t> candidateBuffer;
+    std::vector<uint8_t> verifyBuffer;
+    uint32_t node = 0;          // nodo NUMA di thread, buffer e contesti (con --numa)
+};
+
 // Classe per compressione CHD
 class CHDCompressor {
 public:
@@ -72,49 +174,170 @@ public:
     // Compressione principale
     TaskStatus Compress(const std::string& inputFile, const std::string& outputFile);
 
+    // Stima senza output (--estimate): gli hunk di strata porzioni dell'immagine
+    // passano per ProcessHunk nei worker, il risultato viene esteso all'immagine
+    TaskStatus Estimate(const std::string& inputFile, uint32_t strata, CompressionEstimate& estimate);
+
     // Callback per progresso
     using ProgressCallback = std::function<void(int progress, const std::string& status)>;
     void SetProgressCallback(ProgressCallback callback);
 
+    // Checkpoint periodici nel journal e ripresa di un lavoro interrotto
+    void SetCheckpointOptions(uint32_t intervalSeconds, bool resume);
+
+    // Dimensione dell'input quando non è seekable (pipe su stdin)
+    void SetDeclaredInputSize(uint64_t size);
+
+    // Output precedente da cui copiare gli hunk che decodificano nei dati attuali
+    void SetReuseFile(const std::string& path);
+
+    // Cache degli hunk compressi condivisa tra le immagini (vuota = nessuna)
+    void SetCacheDirectory(const std::string& directory);
+
+    // Annullamento e pausa (nullptr = lavoro non controllabile). Annullato,
+    // il lavoro salva un checkpoint per --resume e ritorna TASK_CANCELLED
+    void SetJobControl(JobControl* control);
+
+    // Thread e memoria condivisi tra i lavori (daemon); nullptr = propri del lavoro
+    void SetSharedPools(WorkerPool* threads, BufferPool* buffers);
+
+    // Codec abilitati dalla configurazione e presenti nella build, nell'ordine
+    // di prova (anche per --auto). Le opzioni puntano a dictionary.
+    static std::vector<CHDCodecSlot> BuildCodecSlots(const CHDConfig& config, uint32_t hunkSize,
+                                                     const std::vector<uint8_t>& dictionary);
+
 private:
     // Configurazione
     CHDConfig config_;
     ProgressCallback progressCallback_;
 
     // Buffer e stato
-    std::vector<uint8_t> inputBuffer_;
-    std::vector<uint8_t> outputBuffer_;
+    std::vector<uint8_t> verifyBuffer_;     // hunk riletto dall'input per il confronto
+    std::vector<uint8_t> dictionary_;   // dizionario zstd (opzionale)
     std::vector<CHDMapEntry> hunkMap_;
+    std::vector<CHDCodecSlot> codecs_;
+
+    // Pipeline: lettura e scrittura in ordine nel thread principale, compressione
+    // nei worker. La coda porta gli indici delle finestre, il buffer di riordino
+    // restituisce gli hunk completati in ordine di hunk. Con --numa la finestra
+    // è divisa in parti contigue per nodo, ognuna con la sua coda.
+    std::vector<CHDHunkSlot> slots_;
+    std::vector<CHDWorkerContext> workers_;
+    WorkerGroup threads_;
+    BufferPool* buffers_;   // nullptr = buffer e arene allocati per il lavoro
+    std::unique_ptr<ShardedQueue<uint32_t>> hunkQueue_;
+    std::unique_ptr<ReorderBuffer<uint32_t>> completedHunks_;
+    uint32_t numaNodes_;    // 1 = nessun posizionamento
+    DiscLayout layout_;                 // file dell'immagine (vuota se non analizzata)
+
+    // SHA-1 dei dati logici (rawsha1), ripreso dal journal dopo un'interruzione
+    SHA1 rawDigest_;
+
+    // Journal di checkpoint
+    CompressionJournal journal_;
+    uint32_t checkpointInterval_;
+    bool resume_;
     
-    // File handles
-    FILE* inputFile_;
-    FILE* outputFile_;
+    // Input sequenziale e output (file o stdout tramite spool)
+    InputStream input_;
+    std::unique_ptr<OutputStream> output_;
     
+    uint64_t declaredInputSize_;
     uint64_t inputSize_;
     uint64_t outputPos_;
+    uint64_t metaOffset_;   // voce di metadata con l'impronta (0 = non ancora scritta)
     uint32_t totalHunks_;
     uint32_t currentHunk_;
     uint32_t hunkSize_;
 
+    // Hunk salvati per CRC: i duplicati diventano voci CHD_MAP_SELF_HUNK
+    std::unordered_map<uint32_t, uint32_t> storedHunks_;
+    bool previousValid_;
+    uint32_t miniHunks_;
+    uint32_t selfHunks_;
+
+    // --reuse: output precedente con la stessa dimensione hunk
+    std::string reuseFile_;
+    std::unique_ptr<CHDReader> reuse_;
+    uint32_t reusedHunks_;
+
+    // --cache: hunk già compressi in altre immagini con gli stessi codec
+    std::string cacheDirectory_;
+    std::unique_ptr<BlockCache> cache_;
+
+    JobControl* control_;
+
     // CD specifico
     std::vector<CDTrackInfo> tracks_;
     bool isCD_;
 
     // Metodi interni
-    bool InitializeCompression(const std::string& inputFile, const std::string& outputFile);
+    bool InitializeCompression(const std::string& inputFile);   // l'output è aperto da OpenOutput
     void CleanupCompression();
+    TaskStatus CancelCompression(const std::string& outputFile);
+    bool FinishOutput();    // verifica la fine dell'input e completa l'output
     
     bool AnalyzeInput();
     bool DetectCDFormat();
     bool ParseCueFile(const std::string& cueFile);
     
     bool ReadInputHunk(uint32_t hunkIndex, uint8_t* buffer);
-    bool WriteCompressedHunk(const uint8_t* data, uint32_t dataSize, uint32_t hunkIndex);
-    bool WriteUncompressedHunk(const uint8_t* data, uint32_t hunkIndex);
+
+    // Stadi della pipeline: lettura e classificazione, compressione, scrittura.
+    // SetupWorkers prepara solo i contesti (--estimate li usa senza pipeline).
+    bool SetupWorkers();
+    bool CreateWorkers(uint32_t firstHunk);
+    void DestroyWorkers();
+    void WorkerLoop(CHDWorkerContext& ctx);
+    bool ReadHunk(uint32_t hunkIndex);     // legge, classifica e affida l'hunk ai worker
+    void ProcessHunk(CHDWorkerContext& ctx, CHDHunkSlot& slot) { (this->*hunkLoop_)(ctx, slot); }
+    bool WriteHunk(CHDHunkSlot& slot);
+
+    // --reuse: con la stessa impronta delle impostazioni copia l'hunk compresso del
+    // vecchio file se il CRC coincide e la decodifica riproduce i dati attuali.
+    // La lettura avviene in ordine nel thread principale, la verifica nei worker.
+    void OpenReuse();
+    void LoadReuseHunk(CHDHunkSlot& slot);
+    bool VerifyReuse(CHDWorkerContext& ctx, CHDHunkSlot& slot);
+    bool WriteCompressedHunk(const uint8_t* data, uint32_t dataSize, uint32_t hunkIndex, uint32_t implId, uint32_t crc);
+
+    // --cache: aperta dopo i codec, che con la dimensione hunk ne determinano
+    // la sottodirectory. Nella cache il codec è l'indice in codecs_.
+    void OpenCache();
+    std::string CacheConfiguration() const;
+
+    // Impronta scritta nei metadata: configurazione della cache, analisi dei
+    // file e dizionario
+    void SettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]) const;
+    bool WriteSettingsMetadata();
+    bool LookupCache(CHDHunkSlot& slot, const uint8_t key[BlockCache::KEY_SIZE]);
+    bool WriteUncompressedHunk(const uint8_t* data, uint32_t hunkIndex, uint32_t crc);
+
+    // Hunk senza dati nel file: pattern di 8 byte o copia di un hunk già salvato
+    static bool IsMiniHunk(const uint8_t* data, uint32_t size, uint64_t& pattern);
+    bool FindDuplicateHunk(const CHDHunkSlot& slot, uint32_t& source);
+    void SetMapEntry(uint32_t hunkIndex, uint64_t offset, uint32_t crc, uint32_t length, uint8_t flags);
+    void RebuildStoredHunks(uint32_t committedHunks);
     
-    // Algoritmi di compressione CHD
-    int CompressWithZlib(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize);
-    int CompressWithLZMA(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize);
+    // Codec CHD dal registro: il migliore finisce in slot.output, -1 se non conveniente.
+    // Per i file dummy (CONTENT_PADDING) basta il primo codec.
+    bool SetupCodecs();
+    template <uint32_t HunkSize>
+    int CompressHunk(CHDWorkerContext& ctx, CHDHunkSlot& slot, ContentClass content);
+
+    // Compressione di un hunk istanziata per dimensione (0 = hunkSize_), analisi
+    // dei file e --cache: SelectHunkLoop sceglie l'istanza una volta per lavoro,
+    // dopo codec e cache
+    using HunkLoop = void (CHDCompressor::*)(CHDWorkerContext&, CHDHunkSlot&);
+    HunkLoop hunkLoop_;
+    void SelectHunkLoop();
+    template <uint32_t HunkSize, bool Layout, bool Cache>
+    void ProcessHunkAs(CHDWorkerContext& ctx, CHDHunkSlot& slot);
+
+    // Apre l'output: da capo, o dall'ultimo checkpoint valido se richiesto
+    bool OpenOutput(const std::string& inputFile, const std::string& outputFile, JournalState& resumeState);
+    bool SaveCheckpoint(uint32_t committedHunks);
+    uint64_t LayoutFingerprint() const;
     
     // Utilità
     bool WriteHeader();
@@ -0,0 +1,120 @@
+#include "chd_reader.h"
+#include <cstring>
+
+namespace UniversalCompressor {
+
+CHDReader::CHDReader() : header_() {
+}
+
+bool CHDReader::Open(const std::string& path) {
+    Close();
+    lastError_.clear();
+
+    if (!file_.Open(path)) {
+        lastError_ = file_.GetLastError();
+        return false;
+    }
+    if (!file_.IsSeekable()) {
+        lastError_ = "Il file " + path + " deve essere seekable";
+        Close();
+        return false;
+    }
+
+    if (file_.ReadAt(0, &header_, sizeof(header_)) != sizeof(header_) ||
+        memcmp(header_.magic, CHD_MAGIC, 8) != 0) {
+        lastError_ = "Formato non riconosciuto: " + path;
+        Close();
+        return false;
+    }
+
+    // Solo il layout di questo tool: header completo prima della mappa
+    if (header_.version != CHD_HEADER_VERSION || header_.length != CHD_HEADER_SIZE ||
+        header_.mapoffset < CHD_HEADER_SIZE || header_.hunksize == 0) {
+        lastError_ = "Versione o header CHD non supportati: " + path;
+        Close();
+        return false;
+    }
+    uint64_t expectedHunks = (header_.logicalbytes + header_.hunksize - 1) / header_.hunksize;
+    if (expectedHunks != header_.totalhunks) {
+        lastError_ = "Header non valido: " + path;
+        Close();
+        return false;
+    }
+
+    map_.resize(header_.totalhunks);
+    size_t mapBytes = map_.size() * sizeof(CHDMapEntry);
+    if (file_.ReadAt(header_.mapoffset, map_.data(), mapBytes) != mapBytes) {
+        lastError_ = "Mappa incompleta: " + path;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool CHDReader::ReadSettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]) {
+    // Catena dei metadata: offset crescenti, così un file corrotto non la chiude in un ciclo
+    uint64_t offset = header_.metaoffset;
+    while (offset >= CHD_HEADER_SIZE) {
+        CHDMetadataEntry entry;
+        if (file_.ReadAt(offset, &entry, sizeof(entry)) != sizeof(entry)) {
+            return false;
+        }
+        uint32_t length = (entry.length[0] << 16) | (entry.length[1] << 8) | entry.length[2];
+        if (memcmp(entry.tag, CHD_SETTINGS_TAG, sizeof(entry.tag)) == 0) {
+            return length == SHA1::DIGEST_SIZE &&
+                   file_.ReadAt(offset + sizeof(entry), digest, SHA1::DIGEST_SIZE) == SHA1::DIGEST_SIZE;
+        }
+        if (entry.next <= offset) {
+            return false;
+        }
+        offset = entry.next;
+    }
+    return false;
+}
+
+void CHDReader::Close() {
+    file_.Close();
+    map_.clear();
+    header_ = CHDHeader();
+}
+
+uint8_t CHDReader::GetEntryType(const CHDMapEntry& entry) {
+    return entry.flags & CHD_MAP_TYPE_MASK;
+}
+
+uint32_t CHDReader::GetEntryLength(const CHDMapEntry& entry) {
+    return entry.length_lo | (static_cast<uint32_t>(entry.length_hi) << 16);
+}
+
+uint32_t CHDReader::GetEntryCodec(const CHDMapEntry& entry) const {
+    // 0 nei bit alti = codec indicato nell'header
+    uint32_t codec = entry.flags >> CHD_MAP_CODEC_SHIFT;
+    return codec ? codec : header_.compression;
+}
+
+bool CHDReader::ReadStored(const CHDMapEntry& entry, std::vector<uint8_t>& data) {
+    uint8_t type = GetEntryType(entry);
+    if (type != CHD_MAP_COMPRESSED && type != CHD_MAP_UNCOMPRESSED) {
+        return false;
+    }
+    data.resize(GetEntryLength(entry));
+    return file_.ReadAt(entry.offset, data.data(), data.size()) == data.size();
+}
+
+size_t CHDReader::ReadStored(uint64_t offset, void* buffer, size_t size) {
+    return file_.ReadAt(offset, buffer, size);
+}
+
+std::unique_ptr<CodecContext> CHDReader::CreateDecoder(uint32_t implId) const {
+    const Codec* codec = FindCHDCodec(implId);
+    if (!codec || !codec->HasCapability(CODEC_CAP_DECOMPRESS)) {
+        return nullptr;
+    }
+    // Stesse opzioni della compressione: il livello fissa anche i parametri LZMA
+    CodecOptions options;
+    options.level = codec->GetProfile().maxLevel;
+    options.blockSizeHint = header_.hunksize;
+    return codec->CreateContext(options);
+}
+
+} // namespace UniversalCompressor
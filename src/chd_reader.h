@@ -0,0 +1,56 @@
+#ifndef CHD_READER_H
+#define CHD_READER_H
+
+#include "chd_compressor.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Lettore dei CHD scritti da questo tool: header, mappa degli hunk e byte salvati.
+// Usato da --reuse per copiare gli hunk di un output precedente e come
+// sorgente della transcodifica CHD -> CSO.
+class CHDReader {
+public:
+    CHDReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const std::string& GetLastError() const { return lastError_; }
+    uint32_t GetHunkSize() const { return header_.hunksize; }
+    uint32_t GetTotalHunks() const { return header_.totalhunks; }
+    uint64_t GetLogicalBytes() const { return header_.logicalbytes; }
+
+    const CHDMapEntry& GetMapEntry(uint32_t hunk) const { return map_[hunk]; }
+
+    // Tipo della voce (CHD_MAP_*), lunghezza dei dati e codec (CHD_CODEC_*_IMPL)
+    static uint8_t GetEntryType(const CHDMapEntry& entry);
+    static uint32_t GetEntryLength(const CHDMapEntry& entry);
+    uint32_t GetEntryCodec(const CHDMapEntry& entry) const;
+
+    // Impronta delle impostazioni nei metadata (false nei file che non l'hanno)
+    bool ReadSettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]);
+
+    // Byte salvati di un hunk compresso o non compresso, così come sono nel file
+    bool ReadStored(const CHDMapEntry& entry, std::vector<uint8_t>& data);
+
+    // Byte grezzi del file: un intervallo che copre più hunk con una sola lettura
+    size_t ReadStored(uint64_t offset, void* buffer, size_t size);
+
+    // Contesto in grado di decodificare gli hunk del codec indicato
+    // (nullptr se il codec non è presente in questa build)
+    std::unique_ptr<CodecContext> CreateDecoder(uint32_t implId) const;
+
+private:
+    InputStream file_;
+    std::string lastError_;
+    CHDHeader header_;
+    std::vector<CHDMapEntry> map_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // CHD_READER_H
@@ -0,0 +1,144 @@
+#include "codec_arena.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace UniversalCompressor {
+
+// Dimensione delle huge page x86-64/ARM64 e granularità delle regioni
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Allineamento dei blocchi: una linea di cache, sufficiente per ogni codec
+static const size_t BLOCK_ALIGNMENT = 64;
+
+CodecArena::~CodecArena() {
+    for (const auto& region : regions_) {
+        UnmapRegion(region);
+    }
+}
+
+void* CodecArena::Allocate(size_t size) {
+    size = (std::max<size_t>(size, 1) + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+
+    for (auto& region : regions_) {
+        if (region.size - region.used >= size) {
+            void* ptr = region.base + region.used;
+            region.used += size;
+            ++region.live;
+            return ptr;
+        }
+    }
+
+    if (!MapRegion(size)) {
+        return nullptr;
+    }
+    Region& region = regions_.back();
+    region.used = size;
+    region.live = 1;
+    return region.base;
+}
+
+void CodecArena::Free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    uint8_t* address = static_cast<uint8_t*>(ptr);
+    for (auto& region : regions_) {
+        if (address >= region.base && address < region.base + region.size) {
+            // Regione vuota: riparte dall'inizio, le pagine restano toccate
+            if (--region.live == 0) {
+                region.used = 0;
+            }
+            return;
+        }
+    }
+}
+
+size_t CodecArena::GetMappedBytes() const {
+    size_t total = 0;
+    for (const auto& region : regions_) {
+        total += region.size;
+    }
+    return total;
+}
+
+size_t CodecArena::GetHugePageBytes() const {
+    size_t total = 0;
+    for (const auto& region : regions_) {
+        if (region.hugePages) {
+            total += region.size;
+        }
+    }
+    return total;
+}
+
+bool CodecArena::MapRegion(size_t size) {
+    Region region = {};
+    region.size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+#ifdef _WIN32
+    // Le large page di Windows richiedono un privilegio apposito: pagine normali
+    region.base = static_cast<uint8_t*>(VirtualAlloc(nullptr, region.size,
+                                                     MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (!region.base) {
+        return false;
+    }
+#elif defined(__linux__)
+    // Prima le huge page esplicite (hugetlbfs), di solito non configurate
+    void* mapped = mmap(nullptr, region.size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if (mapped != MAP_FAILED) {
+        region.base = static_cast<uint8_t*>(mapped);
+        region.hugePages = true;
+    } else {
+        // Altrimenti pagine normali allineate a 2 MB e transparent huge page:
+        // il primo accesso a una regione allineata riceve una huge page intera
+        size_t span = region.size + HUGE_PAGE_SIZE;
+        mapped = mmap(nullptr, span, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+        uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        if (aligned > start) {
+            munmap(mapped, aligned - start);
+        }
+        size_t tail = (start + span) - (aligned + region.size);
+        if (tail > 0) {
+            munmap(reinterpret_cast<void*>(aligned + region.size), tail);
+        }
+        region.base = reinterpret_cast<uint8_t*>(aligned);
+        region.hugePages = madvise(region.base, region.size, MADV_HUGEPAGE) == 0;
+    }
+#else
+    region.base = static_cast<uint8_t*>(::operator new(region.size, std::align_val_t(HUGE_PAGE_SIZE),
+                                                       std::nothrow));
+    if (!region.base) {
+        return false;
+    }
+#endif
+
+    // Page fault subito, dal thread (e nodo) che crea i contesti
+    memset(region.base, 0, region.size);
+    regions_.push_back(region);
+    return true;
+}
+
+void CodecArena::UnmapRegion(const Region& region) {
+#ifdef _WIN32
+    VirtualFree(region.base, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(region.base, region.size);
+#else
+    ::operator delete(region.base, std::align_val_t(HUGE_PAGE_SIZE));
+#endif
+}
+
+} // namespace UniversalCompressor
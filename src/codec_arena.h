@@ -0,0 +1,53 @@
+#ifndef CODEC_ARENA_H
+#define CODEC_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Memoria di lavoro dei contesti codec di un worker (stato deflate, tabelle
+// LZ4 HC, match finder LZMA), passata ai codec con CodecOptions::arena.
+// La memoria arriva in regioni da 2 MB allineate alle huge page e già
+// toccate alla creazione: i contesti non passano da malloc e non prendono
+// page fault durante la compressione. Creata sotto Numa::NodeScope, le
+// regioni stanno nel nodo del worker.
+//
+// Allocazione a puntatore crescente per regione; una regione torna vuota
+// quando tutti i suoi blocchi sono stati liberati. Come i contesti che la
+// usano, appartiene a un solo thread (nessuna sincronizzazione).
+class CodecArena {
+public:
+    CodecArena() = default;
+    ~CodecArena();
+
+    CodecArena(const CodecArena&) = delete;
+    CodecArena& operator=(const CodecArena&) = delete;
+
+    // nullptr solo se il sistema non ha più memoria
+    void* Allocate(size_t size);
+    void Free(void* ptr);
+
+    // Memoria riservata e quanta è coperta da huge page (esplicite o THP)
+    size_t GetMappedBytes() const;
+    size_t GetHugePageBytes() const;
+
+private:
+    struct Region {
+        uint8_t* base;
+        size_t size;
+        size_t used;
+        uint32_t live;      // blocchi ancora allocati
+        bool hugePages;
+    };
+
+    bool MapRegion(size_t size);
+    static void UnmapRegion(const Region& region);
+
+    std::vector<Region> regions_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // CODEC_ARENA_H
@@ -0,0 +1,87 @@
+#ifdef HAVE_LIBDEFLATE
+
+#include "codec_registry.h"
+#include "universal_compressor.h"
+#include <libdeflate.h>
+
+namespace UniversalCompressor {
+
+// Contesto libdeflate: compressore e decompressore allocati una volta per thread
+class LibdeflateContext : public CodecContext {
+public:
+    explicit LibdeflateContext(const CodecOptions& options)
+        : rawDeflate_(options.rawDeflate), decompressor_(nullptr) {
+        compressor_ = libdeflate_alloc_compressor(options.level);
+    }
+
+    ~LibdeflateContext() override {
+        if (compressor_) {
+            libdeflate_free_compressor(compressor_);
+        }
+        if (decompressor_) {
+            libdeflate_free_decompressor(decompressor_);
+        }
+    }
+
+    bool IsReady() const { return compressor_ != nullptr; }
+
+    int Compress(const uint8_t* input, uint32_t inputSize,
+                 uint8_t* output, uint32_t outputCapacity) override {
+        // 0 = output oltre il limite
+        size_t result = rawDeflate_
+            ? libdeflate_deflate_compress(compressor_, input, inputSize, output, outputCapacity)
+            : libdeflate_zlib_compress(compressor_, input, inputSize, output, outputCapacity);
+        return result > 0 ? static_cast<int>(result) : -1;
+    }
+
+    int Decompress(const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) override {
+        if (!decompressor_) {
+            decompressor_ = libdeflate_alloc_decompressor();
+            if (!decompressor_) {
+                return -1;
+            }
+        }
+        size_t actual = 0;
+        libdeflate_result result = rawDeflate_
+            ? libdeflate_deflate_decompress(decompressor_, input, inputSize, output, outputSize, &actual)
+            : libdeflate_zlib_decompress(decompressor_, input, inputSize, output, outputSize, &actual);
+        return result == LIBDEFLATE_SUCCESS ? static_cast<int>(actual) : -1;
+    }
+
+private:
+    bool rawDeflate_;
+    libdeflate_compressor* compressor_;
+    libdeflate_decompressor* decompressor_;
+};
+
+class LibdeflateCodec : public Codec {
+public:
+    const char* GetName() const override { return "libdeflate"; }
+    CodecFormat GetFormat() const override { return CODEC_FORMAT_DEFLATE; }
+    uint32_t GetCapabilities() const override {
+        return CODEC_CAP_BOUNDED_OUTPUT | CODEC_CAP_DECOMPRESS | CODEC_CAP_RAW_DEFLATE;
+    }
+    // Livello 12: parsing ottimale, il massimo rapporto di libdeflate
+    CodecProfile GetProfile() const override { return {7, 7, 1, 12}; }
+    uint32_t GetAlgorithmFlag() const override { return CSO_ALG_LIBDEFLATE; }
+
+    uint32_t GetBound(uint32_t inputSize) const override {
+        // Stesso limite di libdeflate_zlib_compress_bound senza richiedere un compressore
+        return inputSize + 5 * ((inputSize + 9999) / 10000 + 1) + 6 + 10;
+    }
+
+    std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const override {
+        auto context = std::make_unique<LibdeflateContext>(options);
+        if (!context->IsReady()) {
+            return nullptr;
+        }
+        return context;
+    }
+};
+
+REGISTER_CODEC(LibdeflateCodec);
+
+} // namespace UniversalCompressor
+
+#endif // HAVE_LIBDEFLATE
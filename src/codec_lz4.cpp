@@ -0,0 +1,176 @@
+#ifdef HAVE_LZ4
+
+#include "codec_arena.h"
+#include "codec_registry.h"
+#include "universal_compressor.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#ifdef HAVE_LZ4_ATTACH
+#define LZ4_STATIC_LINKING_ONLY
+#define LZ4_HC_STATIC_LINKING_ONLY
+#endif
+#include <lz4.h>
+#include <lz4hc.h>
+
+namespace UniversalCompressor {
+
+// LZ4 usa al più gli ultimi 64 KB del dizionario
+static const uint32_t LZ4_DICTIONARY_WINDOW = 64 * 1024;
+
+// Contesto LZ4: lo stato (veloce o HC) è allocato e inizializzato una volta
+// per thread, nell'arena del worker se presente, e ogni blocco lo riparte con
+// LZ4_resetStream_fast/LZ4_resetStreamHC_fast: le funzioni extState lo
+// azzererebbero per intero a ogni blocco (16 KB, 256 KB per HC).
+// Livello <= 0: LZ4 veloce con accelerazione -livello; livello > 0: LZ4 HC.
+// Con un dizionario lo stream viene indicizzato una sola volta e ogni blocco
+// lo collega allo stato ripartito (LZ4_attach_dictionary), senza copiarlo;
+// le librerie che non esportano l'API (HAVE_LZ4_ATTACH) copiano lo stream.
+class LZ4Context : public CodecContext {
+public:
+    explicit LZ4Context(const CodecOptions& options)
+        : level_(options.level), arena_(options.arena), dictionary_(nullptr), dictionarySize_(0) {
+        stateSize_ = level_ > 0 ? LZ4_sizeofStateHC() : LZ4_sizeofState();
+        state_ = AllocateState(stateStorage_);
+        if (level_ > 0) {
+            LZ4_initStreamHC(state_, stateSize_);
+        } else {
+            LZ4_initStream(state_, stateSize_);
+        }
+
+        if (options.dictionary && options.dictionarySize > 0) {
+            dictionarySize_ = std::min(options.dictionarySize, LZ4_DICTIONARY_WINDOW);
+            dictionary_ = reinterpret_cast<const char*>(options.dictionary) +
+                          (options.dictionarySize - dictionarySize_);
+            dictState_ = AllocateState(dictStateStorage_);
+            if (level_ > 0) {
+                LZ4_streamHC_t* stream = LZ4_initStreamHC(dictState_, stateSize_);
+                LZ4_resetStreamHC_fast(stream, level_);
+                LZ4_loadDictHC(stream, dictionary_, dictionarySize_);
+            } else {
+                LZ4_stream_t* stream = LZ4_initStream(dictState_, stateSize_);
+                LZ4_loadDict(stream, dictionary_, dictionarySize_);
+            }
+        }
+    }
+
+    ~LZ4Context() override {
+        if (arena_) {
+            arena_->Free(state_);
+            arena_->Free(dictState_);
+        }
+    }
+
+    int Compress(const uint8_t* input, uint32_t inputSize,
+                 uint8_t* output, uint32_t outputCapacity) override {
+        // LZ4 interrompe subito la compressione (risultato 0) se l'output non entra nel limite
+        int result;
+        if (dictionary_) {
+#ifndef HAVE_LZ4_ATTACH
+            memcpy(state_, dictState_, stateSize_);
+#endif
+            if (level_ > 0) {
+                LZ4_streamHC_t* stream = reinterpret_cast<LZ4_streamHC_t*>(state_);
+#ifdef HAVE_LZ4_ATTACH
+                LZ4_resetStreamHC_fast(stream, level_);
+                LZ4_attach_HC_dictionary(stream, reinterpret_cast<const LZ4_streamHC_t*>(dictState_));
+#endif
+                result = LZ4_compress_HC_continue(stream,
+                                                  reinterpret_cast<const char*>(input),
+                                                  reinterpret_cast<char*>(output),
+                                                  inputSize, outputCapacity);
+            } else {
+                LZ4_stream_t* stream = reinterpret_cast<LZ4_stream_t*>(state_);
+#ifdef HAVE_LZ4_ATTACH
+                LZ4_resetStream_fast(stream);
+                LZ4_attach_dictionary(stream, reinterpret_cast<const LZ4_stream_t*>(dictState_));
+#endif
+                result = LZ4_compress_fast_continue(stream,
+                                                    reinterpret_cast<const char*>(input),
+                                                    reinterpret_cast<char*>(output),
+                                                    inputSize, outputCapacity,
+                                                    level_ < 0 ? -level_ : 1);
+            }
+        } else if (level_ > 0) {
+            // Stream senza storia: ogni blocco resta decodificabile da solo
+            LZ4_streamHC_t* stream = reinterpret_cast<LZ4_streamHC_t*>(state_);
+            LZ4_resetStreamHC_fast(stream, level_);
+            result = LZ4_compress_HC_continue(stream,
+                                              reinterpret_cast<const char*>(input),
+                                              reinterpret_cast<char*>(output),
+                                              inputSize, outputCapacity);
+        } else {
+            LZ4_stream_t* stream = reinterpret_cast<LZ4_stream_t*>(state_);
+            LZ4_resetStream_fast(stream);
+            result = LZ4_compress_fast_continue(stream,
+                                                reinterpret_cast<const char*>(input),
+                                                reinterpret_cast<char*>(output),
+                                                inputSize, outputCapacity,
+                                                level_ < 0 ? -level_ : 1);
+        }
+        return result > 0 ? result : -1;
+    }
+
+    int Decompress(const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) override {
+        // Decodifica fino a outputSize: ignora l'allineamento dopo i blocchi
+        // dei CSO con index_shift, con o senza dizionario
+        int result = dictionary_
+            ? LZ4_decompress_safe_partial_usingDict(reinterpret_cast<const char*>(input),
+                                                    reinterpret_cast<char*>(output),
+                                                    inputSize, outputSize, outputSize,
+                                                    dictionary_, dictionarySize_)
+            : LZ4_decompress_safe_partial(reinterpret_cast<const char*>(input),
+                                          reinterpret_cast<char*>(output),
+                                          inputSize, outputSize, outputSize);
+        return result >= 0 ? result : -1;
+    }
+
+private:
+    // Stato dall'arena del worker se presente, altrimenti nel vettore indicato
+    char* AllocateState(std::vector<char>& storage) {
+        if (arena_) {
+            char* state = static_cast<char*>(arena_->Allocate(stateSize_));
+            if (state) {
+                return state;
+            }
+        }
+        storage.resize(stateSize_);
+        return storage.data();
+    }
+
+    int level_;
+    CodecArena* arena_;
+    size_t stateSize_;
+    char* state_;
+    char* dictState_ = nullptr;     // stream con il dizionario già indicizzato
+    std::vector<char> stateStorage_;
+    std::vector<char> dictStateStorage_;
+    const char* dictionary_;
+    uint32_t dictionarySize_;
+};
+
+class LZ4Codec : public Codec {
+public:
+    const char* GetName() const override { return "lz4"; }
+    CodecFormat GetFormat() const override { return CODEC_FORMAT_LZ4; }
+    uint32_t GetCapabilities() const override {
+        return CODEC_CAP_BOUNDED_OUTPUT | CODEC_CAP_DECOMPRESS | CODEC_CAP_DICTIONARY;
+    }
+    CodecProfile GetProfile() const override { return {9, 2, 0, LZ4HC_CLEVEL_MAX}; }
+    uint32_t GetAlgorithmFlag() const override { return CSO_ALG_LZ4; }
+
+    uint32_t GetBound(uint32_t inputSize) const override {
+        return static_cast<uint32_t>(LZ4_compressBound(inputSize));
+    }
+
+    std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const override {
+        return std::make_unique<LZ4Context>(options);
+    }
+};
+
+REGISTER_CODEC(LZ4Codec);
+
+} // namespace UniversalCompressor
+
+#endif // HAVE_LZ4
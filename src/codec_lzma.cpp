@@ -0,0 +1,117 @@
+#ifdef HAVE_LZMA
+
+#include "codec_arena.h"
+#include "codec_registry.h"
+#include "universal_compressor.h"
+#include <lzma.h>
+
+namespace UniversalCompressor {
+
+// Allocatore liblzma sull'arena del worker (opaque = CodecArena*)
+static void* ArenaAlloc(void* opaque, size_t nmemb, size_t size) {
+    return static_cast<CodecArena*>(opaque)->Allocate(nmemb * size);
+}
+
+static void ArenaFree(void* opaque, void* ptr) {
+    static_cast<CodecArena*>(opaque)->Free(ptr);
+}
+
+// Contesto LZMA1 raw: lo stream viene reinizializzato per ogni blocco, ma
+// liblzma riusa la memoria già allocata quando la catena di filtri non cambia.
+// Con un'arena il match finder e le tabelle vivono nella memoria del worker.
+class LZMAContext : public CodecContext {
+public:
+    explicit LZMAContext(const CodecOptions& options)
+        : allocator_(), encoder_(LZMA_STREAM_INIT), decoder_(LZMA_STREAM_INIT) {
+        lzma_lzma_preset(&lzmaOptions_, static_cast<uint32_t>(options.level));
+        if (options.arena) {
+            allocator_.alloc = ArenaAlloc;
+            allocator_.free = ArenaFree;
+            allocator_.opaque = options.arena;
+            encoder_.allocator = &allocator_;
+            decoder_.allocator = &allocator_;
+        }
+
+        // Il dizionario non serve più grande del blocco: riduce memoria e inizializzazione
+        if (options.blockSizeHint > 0) {
+            uint32_t dictSize = LZMA_DICT_SIZE_MIN;
+            while (dictSize < options.blockSizeHint && dictSize < lzmaOptions_.dict_size) {
+                dictSize <<= 1;
+            }
+            lzmaOptions_.dict_size = dictSize;
+        }
+
+        filters_[0].id = LZMA_FILTER_LZMA1;
+        filters_[0].options = &lzmaOptions_;
+        filters_[1].id = LZMA_VLI_UNKNOWN;
+        filters_[1].options = nullptr;
+    }
+
+    ~LZMAContext() override {
+        lzma_end(&encoder_);
+        lzma_end(&decoder_);
+    }
+
+    int Compress(const uint8_t* input, uint32_t inputSize,
+                 uint8_t* output, uint32_t outputCapacity) override {
+        if (lzma_raw_encoder(&encoder_, filters_) != LZMA_OK) {
+            return -1;
+        }
+        return Run(encoder_, input, inputSize, output, outputCapacity);
+    }
+
+    int Decompress(const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) override {
+        if (lzma_raw_decoder(&decoder_, filters_) != LZMA_OK) {
+            return -1;
+        }
+        return Run(decoder_, input, inputSize, output, outputSize);
+    }
+
+private:
+    static int Run(lzma_stream& stream, const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) {
+        stream.next_in = input;
+        stream.avail_in = inputSize;
+        stream.next_out = output;
+        stream.avail_out = outputSize;
+
+        // Con avail_out pari al limite, l'encoder si ferma appena lo supera
+        lzma_ret result = lzma_code(&stream, LZMA_FINISH);
+        if (result != LZMA_STREAM_END) {
+            return -1;
+        }
+        return static_cast<int>(outputSize - stream.avail_out);
+    }
+
+    lzma_options_lzma lzmaOptions_;
+    lzma_filter filters_[2];
+    lzma_allocator allocator_;
+    lzma_stream encoder_;
+    lzma_stream decoder_;
+};
+
+class LZMACodec : public Codec {
+public:
+    const char* GetName() const override { return "lzma"; }
+    CodecFormat GetFormat() const override { return CODEC_FORMAT_LZMA; }
+    uint32_t GetCapabilities() const override {
+        return CODEC_CAP_BOUNDED_OUTPUT | CODEC_CAP_DECOMPRESS;
+    }
+    CodecProfile GetProfile() const override { return {2, 9, 1, 9}; }
+    uint32_t GetAlgorithmFlag() const override { return 0; }
+
+    uint32_t GetBound(uint32_t inputSize) const override {
+        return inputSize + inputSize / 3 + 128;
+    }
+
+    std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const override {
+        return std::make_unique<LZMAContext>(options);
+    }
+};
+
+REGISTER_CODEC(LZMACodec);
+
+} // namespace UniversalCompressor
+
+#endif // HAVE_LZMA
@@ -0,0 +1,50 @@
+#include "codec_registry.h"
+#include <algorithm>
+
+namespace UniversalCompressor {
+
+CodecRegistry& CodecRegistry::Instance() {
+    static CodecRegistry registry;
+    return registry;
+}
+
+void CodecRegistry::Register(std::unique_ptr<Codec> codec) {
+    if (!codec || Find(codec->GetName())) {
+        return;
+    }
+    codecs_.push_back(std::move(codec));
+
+    // Ordine stabile indipendente dall'ordine di inizializzazione dei file
+    std::sort(codecs_.begin(), codecs_.end(), [](const auto& a, const auto& b) {
+        return std::string(a->GetName()) < b->GetName();
+    });
+}
+
+const Codec* CodecRegistry::Find(const std::string& name) const {
+    for (const auto& codec : codecs_) {
+        if (name == codec->GetName()) {
+            return codec.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<const Codec*> CodecRegistry::GetCodecs() const {
+    std::vector<const Codec*> result;
+    for (const auto& codec : codecs_) {
+        result.push_back(codec.get());
+    }
+    return result;
+}
+
+std::vector<const Codec*> CodecRegistry::GetCodecs(CodecFormat format) const {
+    std::vector<const Codec*> result;
+    for (const auto& codec : codecs_) {
+        if (codec->GetFormat() == format) {
+            result.push_back(codec.get());
+        }
+    }
+    return result;
+}
+
+} // namespace UniversalCompressor
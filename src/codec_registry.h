@@ -0,0 +1,120 @@
+#ifndef CODEC_REGISTRY_H
+#define CODEC_REGISTRY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+class CodecArena;
+
+// Formato del flusso prodotto da un codec (determina dove può essere usato)
+enum CodecFormat {
+    CODEC_FORMAT_DEFLATE,   // deflate (wrapper zlib o raw, vedi CodecOptions)
+    CODEC_FORMAT_LZ4,       // blocco LZ4 senza frame
+    CODEC_FORMAT_LZMA,      // LZMA1 raw
+    CODEC_FORMAT_ZSTD       // frame zstd
+};
+
+// Capacità di un codec
+enum CodecCapability {
+    CODEC_CAP_BOUNDED_OUTPUT = 0x01,  // si interrompe appena l'output supera il limite
+    CODEC_CAP_DECOMPRESS     = 0x02,  // il contesto sa anche decomprimere
+    CODEC_CAP_RAW_DEFLATE    = 0x04,  // supporta deflate raw oltre al wrapper zlib
+    CODEC_CAP_DICTIONARY     = 0x08   // accetta un dizionario condiviso tra i blocchi
+};
+
+// Profilo velocità/rapporto (valori relativi 1-10) e intervallo dei livelli
+struct CodecProfile {
+    int speed;
+    int ratio;
+    int fastLevel;
+    int maxLevel;
+};
+
+// Opzioni di creazione di un contesto
+struct CodecOptions {
+    int level = 0;
+    bool rawDeflate = false;    // solo CODEC_FORMAT_DEFLATE: niente header/Adler-32
+    uint32_t blockSizeHint = 0; // dimensione tipica dei blocchi, 0 = sconosciuta
+
+    // Dizionario opzionale (solo CODEC_CAP_DICTIONARY); la memoria resta del chiamante
+    const uint8_t* dictionary = nullptr;
+    uint32_t dictionarySize = 0;
+
+    // Memoria di lavoro del worker per lo stato del codec (zlib, LZ4, LZMA);
+    // nullptr = allocatore di sistema. Deve sopravvivere al contesto.
+    CodecArena* arena = nullptr;
+};
+
+// Contesto con stato, posseduto da un solo thread (nessuna sincronizzazione)
+class CodecContext {
+public:
+    virtual ~CodecContext() = default;
+
+    // Comprime in output; outputCapacity è anche il limite oltre il quale
+    // la compressione viene interrotta. Restituisce la dimensione o -1.
+    virtual int Compress(const uint8_t* input, uint32_t inputSize,
+                         uint8_t* output, uint32_t outputCapacity) = 0;
+
+    // Decomprime esattamente outputSize byte; restituisce la dimensione o -1
+    virtual int Decompress(const uint8_t* input, uint32_t inputSize,
+                           uint8_t* output, uint32_t outputSize) = 0;
+};
+
+// Descrizione di un codec registrato
+class Codec {
+public:
+    virtual ~Codec() = default;
+
+    virtual const char* GetName() const = 0;
+    virtual CodecFormat GetFormat() const = 0;
+    virtual uint32_t GetCapabilities() const = 0;
+    virtual CodecProfile GetProfile() const = 0;
+
+    // Bit CSOAlgorithm che abilita il codec nei compressori CSO (0 = nessuno)
+    virtual uint32_t GetAlgorithmFlag() const = 0;
+
+    // Dimensione massima dell'output nel caso peggiore
+    virtual uint32_t GetBound(uint32_t inputSize) const = 0;
+
+    // nullptr se lo stato del codec non può essere inizializzato (memoria, livello)
+    virtual std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const = 0;
+
+    bool HasCapability(uint32_t capability) const {
+        return (GetCapabilities() & capability) == capability;
+    }
+};
+
+// Registro globale dei codec disponibili in questa build
+class CodecRegistry {
+public:
+    static CodecRegistry& Instance();
+
+    void Register(std::unique_ptr<Codec> codec);
+
+    const Codec* Find(const std::string& name) const;
+    std::vector<const Codec*> GetCodecs() const;
+    std::vector<const Codec*> GetCodecs(CodecFormat format) const;
+
+private:
+    CodecRegistry() = default;
+    std::vector<std::unique_ptr<Codec>> codecs_;
+};
+
+// Registrazione statica: ogni codec si registra dal proprio file sorgente
+class CodecRegistrar {
+public:
+    explicit CodecRegistrar(std::unique_ptr<Codec> codec) {
+        CodecRegistry::Instance().Register(std::move(codec));
+    }
+};
+
+#define REGISTER_CODEC(CodecType) \
+    static ::UniversalCompressor::CodecRegistrar codecRegistrar_##CodecType(std::make_unique<CodecType>())
+
+} // namespace UniversalCompressor
+
+#endif // CODEC_REGISTRY_H
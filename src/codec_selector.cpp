@@ -0,0 +1,158 @@
+#include "codec_selector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace UniversalCompressor {
+
+// Peso della media mobile delle vittorie (circa le ultime 32 prove)
+static const double WIN_RATE_ALPHA = 1.0 / 32.0;
+
+// Sotto questa frequenza di vittoria il codec viene saltato dopo il warmup
+static const double MIN_WIN_RATE = 0.03;
+
+// Massimo numero di byte campionati per la stima dell'entropia
+static const uint32_t ENTROPY_SAMPLE_BYTES = 4096;
+
+CodecSelector::CodecSelector(uint32_t warmupBlocks, uint32_t exploreInterval)
+    : warmupBlocks_(warmupBlocks), exploreInterval_(exploreInterval), rawBlocks_(0) {
+    Reset();
+}
+
+void CodecSelector::Reset() {
+    for (auto& bucket : buckets_) {
+        for (int i = 0; i < MAX_CODECS; ++i) {
+            bucket.winRate[i] = 0.5;
+            bucket.attempts[i] = 0;
+            bucket.sinceTry[i] = 0;
+        }
+    }
+    for (auto& stats : totals_) {
+        stats = CodecStats{};
+    }
+    rawBlocks_ = 0;
+}
+
+double CodecSelector::EstimateEntropy(const uint8_t* data, uint32_t size) {
+    if (size == 0) {
+        return 0.0;
+    }
+
+    // Campiona a passo fisso per limitare il costo sui blocchi grandi
+    uint32_t step = std::max(1u, size / ENTROPY_SAMPLE_BYTES);
+    uint32_t counts[256] = {};
+    uint32_t samples = 0;
+    for (uint32_t i = 0; i < size; i += step) {
+        counts[data[i]]++;
+        samples++;
+    }
+
+    double entropy = 0.0;
+    double total = static_cast<double>(samples);
+    for (uint32_t count : counts) {
+        if (count) {
+            double p = count / total;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+int CodecSelector::BucketFor(double entropy) {
+    int bucket = static_cast<int>(entropy * 2.0);
+    return std::clamp(bucket, 0, ENTROPY_BUCKETS - 1);
+}
+
+void CodecSelector::Order(int bucket, std::vector<int>& slots) const {
+    const BucketState& state = buckets_[bucket];
+    std::stable_sort(slots.begin(), slots.end(), [&state](int a, int b) {
+        return state.winRate[a] > state.winRate[b];
+    });
+}
+
+bool CodecSelector::ShouldTry(int bucket, int slot) {
+    BucketState& state = buckets_[bucket];
+
+    // Durante il warmup ogni codec viene provato
+    if (state.attempts[slot] < warmupBlocks_ || state.winRate[slot] >= MIN_WIN_RATE) {
+        return true;
+    }
+
+    // Esplorazione periodica per accorgersi dei cambi di contenuto
+    if (++state.sinceTry[slot] >= exploreInterval_) {
+        state.sinceTry[slot] = 0;
+        return true;
+    }
+
+    totals_[slot].skips++;
+    return false;
+}
+
+void CodecSelector::RecordAttempt(int bucket, int slot, bool aborted) {
+    BucketState& state = buckets_[bucket];
+    if (state.attempts[slot] < UINT32_MAX) {
+        state.attempts[slot]++;
+    }
+    totals_[slot].attempts++;
+    if (aborted) {
+        totals_[slot].aborts++;
+    }
+}
+
+void CodecSelector::RecordWinner(int bucket, const std::vector<int>& tried, int winner) {
+    BucketState& state = buckets_[bucket];
+    for (int slot : tried) {
+        double won = (slot == winner) ? 1.0 : 0.0;
+        state.winRate[slot] += WIN_RATE_ALPHA * (won - state.winRate[slot]);
+    }
+
+    if (winner >= 0) {
+        totals_[winner].wins++;
+    } else {
+        rawBlocks_++;
+    }
+}
+
+void CodecSelector::Learn(const CodecSelector& start, const CodecSelector& end) {
+    for (int b = 0; b < ENTROPY_BUCKETS; ++b) {
+        BucketState& state = buckets_[b];
+        const BucketState& from = start.buckets_[b];
+        const BucketState& to = end.buckets_[b];
+        for (int i = 0; i < MAX_CODECS; ++i) {
+            state.winRate[i] = std::clamp(state.winRate[i] + to.winRate[i] - from.winRate[i], 0.0, 1.0);
+            uint64_t attempts = static_cast<uint64_t>(state.attempts[i]) + (to.attempts[i] - from.attempts[i]);
+            state.attempts[i] = static_cast<uint32_t>(std::min<uint64_t>(attempts, UINT32_MAX));
+            state.sinceTry[i] = to.sinceTry[i];
+        }
+    }
+    for (int i = 0; i < MAX_CODECS; ++i) {
+        totals_[i].attempts += end.totals_[i].attempts - start.totals_[i].attempts;
+        totals_[i].wins += end.totals_[i].wins - start.totals_[i].wins;
+        totals_[i].aborts += end.totals_[i].aborts - start.totals_[i].aborts;
+        totals_[i].skips += end.totals_[i].skips - start.totals_[i].skips;
+    }
+    rawBlocks_ += end.rawBlocks_ - start.rawBlocks_;
+}
+
+std::string CodecSelector::Summary(const std::vector<std::string>& names) const {
+    std::string summary;
+    for (size_t i = 0; i < names.size() && i < static_cast<size_t>(MAX_CODECS); ++i) {
+        const CodecStats& stats = totals_[i];
+        if (stats.attempts == 0 && stats.skips == 0) {
+            continue;
+        }
+        if (!summary.empty()) {
+            summary += ", ";
+        }
+        summary += names[i] + ": " + std::to_string(stats.wins) + " vittorie/" +
+                   std::to_string(stats.attempts) + " prove (" +
+                   std::to_string(stats.aborts) + " interrotte, " +
+                   std::to_string(stats.skips) + " saltate)";
+    }
+    if (!summary.empty()) {
+        summary += ", ";
+    }
+    summary += "non compressi: " + std::to_string(rawBlocks_);
+    return summary;
+}
+
+} // namespace UniversalCompressor
@@ -0,0 +1,75 @@
+#ifndef CODEC_SELECTOR_H
+#define CODEC_SELECTOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Selettore adattivo dei codec per blocco.
+// Classifica ogni blocco con una stima economica dell'entropia e, per ogni
+// classe, tiene statistiche mobili delle vittorie di ciascun codec: i codec
+// che perdono sistematicamente su blocchi simili vengono saltati (con una
+// esplorazione periodica per riadattarsi al contenuto dell'immagine).
+class CodecSelector {
+public:
+    static const int MAX_CODECS = 8;
+    static const int ENTROPY_BUCKETS = 16;  // classi da 0.5 bit/byte
+
+    // Sopra questa soglia (bit/byte) la codifica entropica non guadagna più:
+    // il blocco si comprime solo se contiene ripetizioni, da verificare con LZ
+    static constexpr double INCOMPRESSIBLE_ENTROPY = 7.85;
+
+    struct CodecStats {
+        uint64_t attempts = 0;   // tentativi completati o interrotti
+        uint64_t wins = 0;       // blocchi in cui il codec ha prodotto l'output scelto
+        uint64_t aborts = 0;     // tentativi interrotti per output oltre il limite
+        uint64_t skips = 0;      // tentativi evitati grazie alle statistiche
+    };
+
+    CodecSelector(uint32_t warmupBlocks = 64, uint32_t exploreInterval = 32);
+
+    // Azzera le statistiche (una volta per immagine)
+    void Reset();
+
+    // Stima economica: entropia di ordine 0 (bit per byte, 0-8) su un campione
+    static double EstimateEntropy(const uint8_t* data, uint32_t size);
+    static int BucketFor(double entropy);
+
+    // Ordina gli slot candidati per probabilità di vittoria decrescente
+    void Order(int bucket, std::vector<int>& slots) const;
+
+    // Decide se provare il codec su un blocco della classe indicata
+    bool ShouldTry(int bucket, int slot);
+
+    // Registra l'esito di un tentativo e il vincitore del blocco (-1 = non compresso)
+    void RecordAttempt(int bucket, int slot, bool aborted);
+    void RecordWinner(int bucket, const std::vector<int>& tried, int winner);
+
+    // Aggiunge quanto appreso da un selettore partito dallo stato start:
+    // differenze delle statistiche mobili e dei totali. Applicato nello stesso
+    // ordine dà sempre lo stesso stato, qualunque thread abbia prodotto end.
+    void Learn(const CodecSelector& start, const CodecSelector& end);
+
+    const CodecStats& GetStats(int slot) const { return totals_[slot]; }
+    uint64_t GetRawBlocks() const { return rawBlocks_; }
+    std::string Summary(const std::vector<std::string>& names) const;
+
+private:
+    struct BucketState {
+        double winRate[MAX_CODECS];       // media mobile esponenziale
+        uint32_t attempts[MAX_CODECS];
+        uint32_t sinceTry[MAX_CODECS];
+    };
+
+    uint32_t warmupBlocks_;
+    uint32_t exploreInterval_;
+    BucketState buckets_[ENTROPY_BUCKETS];
+    CodecStats totals_[MAX_CODECS];
+    uint64_t rawBlocks_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // CODEC_SELECTOR_H
@@ -0,0 +1,141 @@
+#include "codec_arena.h"
+#include "codec_registry.h"
+#include "universal_compressor.h"
+#include <zlib.h>
+
+namespace UniversalCompressor {
+
+// Allocatore zlib sull'arena del worker (opaque = CodecArena*)
+static voidpf ArenaAlloc(voidpf opaque, uInt items, uInt size) {
+    return static_cast<CodecArena*>(opaque)->Allocate(static_cast<size_t>(items) * size);
+}
+
+static void ArenaFree(voidpf opaque, voidpf address) {
+    static_cast<CodecArena*>(opaque)->Free(address);
+}
+
+// Contesto zlib: gli stream vengono inizializzati una volta e riusati con
+// deflateReset/inflateReset, senza riallocare lo stato per ogni blocco.
+// Un eventuale dizionario preset viene ricaricato dopo ogni reset. Con
+// un'arena (CodecOptions::arena) lo stato vive nella memoria del worker.
+class ZlibContext : public CodecContext {
+public:
+    explicit ZlibContext(const CodecOptions& options)
+        : windowBits_(options.rawDeflate ? -MAX_WBITS : MAX_WBITS),
+          dictionary_(options.dictionary), dictionarySize_(options.dictionarySize),
+          deflateReady_(false), inflateReady_(false) {
+        deflateStream_ = {};
+        inflateStream_ = {};
+        if (options.arena) {
+            deflateStream_.zalloc = inflateStream_.zalloc = ArenaAlloc;
+            deflateStream_.zfree = inflateStream_.zfree = ArenaFree;
+            deflateStream_.opaque = inflateStream_.opaque = options.arena;
+        }
+        deflateReady_ = deflateInit2(&deflateStream_, options.level, Z_DEFLATED,
+                                     windowBits_, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~ZlibContext() override {
+        if (deflateReady_) {
+            deflateEnd(&deflateStream_);
+        }
+        if (inflateReady_) {
+            inflateEnd(&inflateStream_);
+        }
+    }
+
+    bool IsReady() const { return deflateReady_; }
+
+    int Compress(const uint8_t* input, uint32_t inputSize,
+                 uint8_t* output, uint32_t outputCapacity) override {
+        if (deflateReset(&deflateStream_) != Z_OK) {
+            return -1;
+        }
+        if (dictionary_ && deflateSetDictionary(&deflateStream_, dictionary_, dictionarySize_) != Z_OK) {
+            return -1;
+        }
+
+        deflateStream_.next_in = const_cast<uint8_t*>(input);
+        deflateStream_.avail_in = inputSize;
+        deflateStream_.next_out = output;
+        deflateStream_.avail_out = outputCapacity;
+
+        // Con un buffer di output pari al limite, deflate si ferma appena lo supera
+        int result = deflate(&deflateStream_, Z_FINISH);
+        if (result != Z_STREAM_END) {
+            return -1;
+        }
+        return static_cast<int>(outputCapacity - deflateStream_.avail_out);
+    }
+
+    int Decompress(const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) override {
+        if (!inflateReady_) {
+            inflateReady_ = inflateInit2(&inflateStream_, windowBits_) == Z_OK;
+            if (!inflateReady_) {
+                return -1;
+            }
+        } else if (inflateReset(&inflateStream_) != Z_OK) {
+            return -1;
+        }
+        // In deflate raw il dizionario va impostato subito, col wrapper zlib su richiesta
+        if (dictionary_ && windowBits_ < 0 &&
+            inflateSetDictionary(&inflateStream_, dictionary_, dictionarySize_) != Z_OK) {
+            return -1;
+        }
+
+        inflateStream_.next_in = const_cast<uint8_t*>(input);
+        inflateStream_.avail_in = inputSize;
+        inflateStream_.next_out = output;
+        inflateStream_.avail_out = outputSize;
+
+        int result = inflate(&inflateStream_, Z_FINISH);
+        if (result == Z_NEED_DICT && dictionary_) {
+            if (inflateSetDictionary(&inflateStream_, dictionary_, dictionarySize_) != Z_OK) {
+                return -1;
+            }
+            result = inflate(&inflateStream_, Z_FINISH);
+        }
+        if (result != Z_STREAM_END && !(result == Z_BUF_ERROR && inflateStream_.avail_out == 0)) {
+            return -1;
+        }
+        return static_cast<int>(outputSize - inflateStream_.avail_out);
+    }
+
+private:
+    int windowBits_;
+    const uint8_t* dictionary_;
+    uint32_t dictionarySize_;
+    z_stream deflateStream_;
+    z_stream inflateStream_;
+    bool deflateReady_;
+    bool inflateReady_;
+};
+
+class ZlibCodec : public Codec {
+public:
+    const char* GetName() const override { return "zlib"; }
+    CodecFormat GetFormat() const override { return CODEC_FORMAT_DEFLATE; }
+    uint32_t GetCapabilities() const override {
+        return CODEC_CAP_BOUNDED_OUTPUT | CODEC_CAP_DECOMPRESS | CODEC_CAP_RAW_DEFLATE |
+               CODEC_CAP_DICTIONARY;
+    }
+    CodecProfile GetProfile() const override { return {4, 5, 1, Z_BEST_COMPRESSION}; }
+    uint32_t GetAlgorithmFlag() const override { return CSO_ALG_ZLIB; }
+
+    uint32_t GetBound(uint32_t inputSize) const override {
+        return static_cast<uint32_t>(compressBound(inputSize));
+    }
+
+    std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const override {
+        auto context = std::make_unique<ZlibContext>(options);
+        if (!context->IsReady()) {
+            return nullptr;
+        }
+        return context;
+    }
+};
+
+REGISTER_CODEC(ZlibCodec);
+
+} // namespace UniversalCompressor
@@ -0,0 +1,84 @@
+#ifdef HAVE_ZOPFLI
+
+#include "codec_registry.h"
+#include "universal_compressor.h"
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#include <zopfli.h>
+
+namespace UniversalCompressor {
+
+// Contesto Zopfli: il livello è il numero di iterazioni. Zopfli non accetta un
+// limite di output, quindi il confronto con il limite avviene a fine compressione.
+class ZopfliContext : public CodecContext {
+public:
+    explicit ZopfliContext(const CodecOptions& options)
+        : options_(options) {
+        ZopfliInitOptions(&zopfliOptions_);
+        zopfliOptions_.numiterations = options.level > 0 ? options.level : 15;
+    }
+
+    int Compress(const uint8_t* input, uint32_t inputSize,
+                 uint8_t* output, uint32_t outputCapacity) override {
+        unsigned char* compressed = nullptr;
+        size_t compressedSize = 0;
+        ZopfliCompress(&zopfliOptions_,
+                       options_.rawDeflate ? ZOPFLI_FORMAT_DEFLATE : ZOPFLI_FORMAT_ZLIB,
+                       input, inputSize, &compressed, &compressedSize);
+
+        int result = -1;
+        if (compressed && compressedSize > 0 && compressedSize <= outputCapacity) {
+            memcpy(output, compressed, compressedSize);
+            result = static_cast<int>(compressedSize);
+        }
+        free(compressed);
+        return result;
+    }
+
+    int Decompress(const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) override {
+        // L'output è deflate standard: la decompressione passa dal codec zlib
+        if (!inflater_) {
+            const Codec* zlib = CodecRegistry::Instance().Find("zlib");
+            if (!zlib) {
+                return -1;
+            }
+            inflater_ = zlib->CreateContext(options_);
+            if (!inflater_) {
+                return -1;
+            }
+        }
+        return inflater_->Decompress(input, inputSize, output, outputSize);
+    }
+
+private:
+    CodecOptions options_;
+    ZopfliOptions zopfliOptions_;
+    std::unique_ptr<CodecContext> inflater_;
+};
+
+class ZopfliCodec : public Codec {
+public:
+    const char* GetName() const override { return "zopfli"; }
+    CodecFormat GetFormat() const override { return CODEC_FORMAT_DEFLATE; }
+    uint32_t GetCapabilities() const override {
+        return CODEC_CAP_DECOMPRESS | CODEC_CAP_RAW_DEFLATE;
+    }
+    CodecProfile GetProfile() const override { return {1, 8, 5, 15}; }
+    uint32_t GetAlgorithmFlag() const override { return CSO_ALG_ZOPFLI; }
+
+    uint32_t GetBound(uint32_t inputSize) const override {
+        return static_cast<uint32_t>(compressBound(inputSize));
+    }
+
+    std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const override {
+        return std::make_unique<ZopfliContext>(options);
+    }
+};
+
+REGISTER_CODEC(ZopfliCodec);
+
+} // namespace UniversalCompressor
+
+#endif // HAVE_ZOPFLI
@@ -0,0 +1,105 @@
+#ifdef HAVE_ZSTD
+
+#include "codec_registry.h"
+#include "universal_compressor.h"
+#include <zstd.h>
+
+namespace UniversalCompressor {
+
+// Contesto zstd: CCtx/DCtx riusati per tutti i blocchi del thread. Con un
+// dizionario, CDict/DDict vengono preparati una volta e condivisi dai blocchi.
+class ZstdContext : public CodecContext {
+public:
+    explicit ZstdContext(const CodecOptions& options)
+        : level_(options.level), dictionary_(options.dictionary && options.dictionarySize > 0),
+          cdict_(nullptr), ddict_(nullptr), dctx_(nullptr) {
+        cctx_ = ZSTD_createCCtx();
+        if (dictionary_) {
+            cdict_ = ZSTD_createCDict(options.dictionary, options.dictionarySize, level_);
+            ddict_ = ZSTD_createDDict(options.dictionary, options.dictionarySize);
+        }
+        if (cctx_) {
+            // I blocchi sono piccoli e a dimensione nota: niente checksum né dimensione nel frame
+            ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level_);
+            ZSTD_CCtx_setParameter(cctx_, ZSTD_c_checksumFlag, 0);
+            ZSTD_CCtx_setParameter(cctx_, ZSTD_c_contentSizeFlag, 0);
+            if (cdict_) {
+                ZSTD_CCtx_refCDict(cctx_, cdict_);
+            }
+        }
+    }
+
+    ~ZstdContext() override {
+        ZSTD_freeCCtx(cctx_);
+        ZSTD_freeDCtx(dctx_);
+        ZSTD_freeCDict(cdict_);
+        ZSTD_freeDDict(ddict_);
+    }
+
+    bool IsReady() const { return cctx_ && (!dictionary_ || (cdict_ && ddict_)); }
+
+    int Compress(const uint8_t* input, uint32_t inputSize,
+                 uint8_t* output, uint32_t outputCapacity) override {
+        // Con una capacità pari al limite zstd si ferma con dstSize_tooSmall
+        size_t result = ZSTD_compress2(cctx_, output, outputCapacity, input, inputSize);
+        if (ZSTD_isError(result)) {
+            return -1;
+        }
+        return static_cast<int>(result);
+    }
+
+    int Decompress(const uint8_t* input, uint32_t inputSize,
+                   uint8_t* output, uint32_t outputSize) override {
+        if (!dctx_) {
+            dctx_ = ZSTD_createDCtx();
+            if (!dctx_) {
+                return -1;
+            }
+        }
+        size_t result = ddict_
+            ? ZSTD_decompress_usingDDict(dctx_, output, outputSize, input, inputSize, ddict_)
+            : ZSTD_decompressDCtx(dctx_, output, outputSize, input, inputSize);
+        if (ZSTD_isError(result)) {
+            return -1;
+        }
+        return static_cast<int>(result);
+    }
+
+private:
+    int level_;
+    bool dictionary_;
+    ZSTD_CCtx* cctx_;
+    ZSTD_CDict* cdict_;
+    ZSTD_DDict* ddict_;
+    ZSTD_DCtx* dctx_;
+};
+
+class ZstdCodec : public Codec {
+public:
+    const char* GetName() const override { return "zstd"; }
+    CodecFormat GetFormat() const override { return CODEC_FORMAT_ZSTD; }
+    uint32_t GetCapabilities() const override {
+        return CODEC_CAP_BOUNDED_OUTPUT | CODEC_CAP_DECOMPRESS | CODEC_CAP_DICTIONARY;
+    }
+    // Oltre il 19 servono finestre enormi, inutili su blocchi piccoli
+    CodecProfile GetProfile() const override { return {8, 7, 3, 19}; }
+    uint32_t GetAlgorithmFlag() const override { return CSO_ALG_ZSTD; }
+
+    uint32_t GetBound(uint32_t inputSize) const override {
+        return static_cast<uint32_t>(ZSTD_compressBound(inputSize));
+    }
+
+    std::unique_ptr<CodecContext> CreateContext(const CodecOptions& options) const override {
+        auto context = std::make_unique<ZstdContext>(options);
+        if (!context->IsReady()) {
+            return nullptr;
+        }
+        return context;
+    }
+};
+
+REGISTER_CODEC(ZstdCodec);
+
+} // namespace UniversalCompressor
+
+#endif // HAVE_ZSTD
@@ -1,29 +1,32 @@
 #include "cso_compressor.h"
+#include "cso_reader.h"
+#include "block_sampler.h"
+#include "image_source.h"
 #include <iostream>
 #include <cstring>
 #include <algorithm>
-#include <zlib.h>
-
-// Se disponibile, includi LZ4
-#ifdef HAVE_LZ4
-#include <lz4.h>
-#include <lz4hc.h>
-#endif
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 
 namespace UniversalCompressor {
 
 CSOCompressor::CSOCompressor(const CSOConfig& config)
-    : config_(config), inputFile_(nullptr), outputFile_(nullptr),
-      inputSize_(0), outputPos_(0), totalSectors_(0), currentSector_(0) {
+    : config_(config), buffers_(nullptr), nextChunk_(0), numaNodes_(1), control_(nullptr), checkpointInterval_(0), resume_(false),
+      declaredInputSize_(0), inputSize_(0), outputPos_(0), headerSize_(sizeof(CSOHeader)),
+      blockSize_(GetBlockSize(config.format)), indexShift_(0), maxCompressed_(0), totalSectors_(0), currentSector_(0), runBlocks_(0), ncCapacity_(0),
+      ncAreas_(0), chunkLoop_(nullptr), writeLoop_(nullptr) {
     
     // Calcola dimensione blocco se auto
     if (config_.blockSize == 0) {
         config_.blockSize = CalculateBlockSize();
     }
     
-    // Prepara buffer
-    inputBuffer_.resize(config_.blockSize);
-    outputBuffer_.resize(config_.blockSize * 2); // Spazio extra per compressione
+    if (config_.threads == 0) {
+        config_.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
 }
 
 CSOCompressor::~CSOCompressor() {
@@ -34,129 +37,306 @@ void CSOCompressor::SetProgressCallback(ProgressCallback callback) {
     progressCallback_ = callback;
 }
 
+void CSOCompressor::SetCheckpointOptions(uint32_t intervalSeconds, bool resume) {
+    checkpointInterval_ = intervalSeconds;
+    resume_ = resume;
+}
+
+void CSOCompressor::SetDeclaredInputSize(uint64_t size) {
+    declaredInputSize_ = size;
+}
+
+void CSOCompressor::SetReuseFile(const std::string& path) {
+    reuseFile_ = path;
+}
+
+void CSOCompressor::SetCacheDirectory(const std::string& directory) {
+    cacheDirectory_ = directory;
+}
+
+void CSOCompressor::SetJobControl(JobControl* control) {
+    control_ = control;
+}
+
+void CSOCompressor::SetSharedPools(WorkerPool* threads, BufferPool* buffers) {
+    threads_.SetPool(threads);
+    buffers_ = buffers;
+}
+
 TaskStatus CSOCompressor::Compress(const std::string& inputFile, const std::string& outputFile) {
     // Inizializza compressione
-    if (!InitializeCompression(inputFile, outputFile)) {
+    if (!InitializeCompression(inputFile)) {
         CleanupCompression();
         return TASK_ERROR;
     }
 
     UpdateProgress("Iniziando compressione CSO...");
 
-    // Scrivi header
-    if (!WriteHeader()) {
+    // Scrivi header (e dizionario ZCSO), eventualmente riprendendo dal journal
+    JournalState resumeState;
+    if (!LoadDictionary()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    SelectIndexShift();
+    if (!OpenOutput(inputFile, outputFile, resumeState) || !WriteHeader()) {
         CleanupCompression();
         return TASK_ERROR;
     }
 
-    // Riserva spazio per indice
-    uint32_t indexSize = (totalSectors_ + 1) * sizeof(uint32_t);
-    indexTable_.resize(totalSectors_ + 1);
-    
-    // Salta spazio per indice (lo scriveremo alla fine)
-    outputPos_ = sizeof(CSOHeader) + indexSize;
-    fseek(outputFile_, outputPos_, SEEK_SET);
-
-    // Comprimi settori uno alla volta
-    for (currentSector_ = 0; currentSector_ < totalSectors_; ++currentSector_) {
-        // Leggi settore
-        if (!ReadInputSector(currentSector_, inputBuffer_.data())) {
-            CleanupCompression();
-            return TASK_ERROR;
-        }
-
-        // Controlla se è settore vuoto
-        if (IsEmptySector(inputBuffer_.data(), SECTOR_SIZE)) {
-            // Settore vuoto - salva come non compresso
-            if (!WriteUncompressedSector(inputBuffer_.data(), currentSector_)) {
+    // Salta spazio per indice (lo scriveremo alla fine) o riparti dall'ultimo checkpoint
+    outputPos_ = (resumeState.outputPos > 0) ? resumeState.outputPos : AlignOffset(headerSize_ + GetIndexSize());
+    CountNCAreas(resumeState.committedBlocks);
+    if (!output_->Seek(outputPos_) || !SetupCandidates() || !OpenReuse() || !CreateWorkers()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    OpenCache();
+    SelectBlockLoops();
+
+    // Pipeline a lotti: il thread principale legge un lotto mentre i worker
+    // comprimono il precedente, poi ne scrive le porzioni in ordine man mano
+    // che vengono completate
+    const uint32_t batchSectors = static_cast<uint32_t>(workers_.size()) * CSO_BLOCKS_PER_WORKER;
+    batches_.resize(CSO_BATCHES_IN_FLIGHT);
+    for (auto& batch : batches_) {
+        BufferPool::Acquire(buffers_, batch.input, static_cast<size_t>(batchSectors) * blockSize_);
+        BufferPool::Acquire(buffers_, batch.output, static_cast<size_t>(batchSectors) * blockSize_);
+        batch.results.resize(batchSectors);
+        batch.reuse.resize(batchSectors);
+        BufferPool::Acquire(buffers_, batch.reuseData, reuse_ ? static_cast<size_t>(batchSectors) * blockSize_ : 0);
+        batch.learned.resize((batchSectors + CSO_BLOCKS_PER_CHUNK - 1) / CSO_BLOCKS_PER_CHUNK);
+        PlaceBatch(batch);
+    }
+    carry_ = CSOCarryBlock();
+    runBlocks_ = 0;
+
+    CSOBatch* pending = nullptr;    // lotto in compressione, da scrivere
+    uint32_t nextSector = resumeState.committedBlocks;
+    size_t nextBatch = 0;
+    for (currentSector_ = resumeState.committedBlocks; currentSector_ < totalSectors_; ) {
+        CSOBatch* batch = nullptr;
+        if (nextSector < totalSectors_) {
+            // In pausa si attende qui: i worker finiscono il lotto in corso e
+            // restano fermi sulla coda vuota
+            if (control_ && !control_->WaitIfPaused()) {
+                return CancelCompression(outputFile);
+            }
+            batch = &batches_[nextBatch];
+            nextBatch = (nextBatch + 1) % batches_.size();
+            batch->firstSector = nextSector;
+            batch->count = std::min(batchSectors, totalSectors_ - nextSector);
+
+            // Leggi lotto
+            if (!ReadInputBatch(batch->firstSector, batch->count, batch->input.data())) {
                 CleanupCompression();
                 return TASK_ERROR;
             }
-        } else if (ShouldCompress(inputBuffer_.data(), SECTOR_SIZE)) {
-            // Prova compressione
-            int compressedSize = -1;
-            
-            // Prova diversi algoritmi
-            if (config_.algorithms & CSO_ALG_ZLIB) {
-                compressedSize = CompressWithZlib(inputBuffer_.data(), SECTOR_SIZE, 
-                                                outputBuffer_.data(), outputBuffer_.size());
-            }
-            
-            #ifdef HAVE_LZ4
-            if ((compressedSize == -1 || config_.fastMode) && (config_.algorithms & CSO_ALG_LZ4)) {
-                int lz4Size = CompressWithLZ4(inputBuffer_.data(), SECTOR_SIZE,
-                                            outputBuffer_.data(), outputBuffer_.size());
-                if (lz4Size > 0 && (compressedSize == -1 || lz4Size < compressedSize)) {
-                    compressedSize = lz4Size;
-                }
+
+            // Blocchi identici al precedente: compressi una volta sola
+            MarkRuns(*batch, pending);
+            if (!LoadReuseBatch(*batch)) {
+                CleanupCompression();
+                return TASK_ERROR;
             }
-            #endif
 
-            // Usa risultato compresso se conveniente
-            if (compressedSize > 0 && compressedSize < SECTOR_SIZE * 0.9) {
-                if (!WriteCompressedSector(outputBuffer_.data(), compressedSize, currentSector_)) {
-                    CleanupCompression();
-                    return TASK_ERROR;
-                }
-            } else {
-                // Compressione non conveniente - salva non compresso
-                if (!WriteUncompressedSector(inputBuffer_.data(), currentSector_)) {
-                    CleanupCompression();
-                    return TASK_ERROR;
+            DispatchBatch(*batch);
+            nextSector += batch->count;
+        }
+
+        if (pending) {
+            // Scrivi lotto in ordine: un lotto interrotto a metà non entra nel
+            // checkpoint, si riprende dal suo inizio
+            bool cancelled = false;
+            if (!WriteBatch(*pending, cancelled)) {
+                if (cancelled) {
+                    return CancelCompression(outputFile);
                 }
-            }
-        } else {
-            // Non comprimere
-            if (!WriteUncompressedSector(inputBuffer_.data(), currentSector_)) {
                 CleanupCompression();
                 return TASK_ERROR;
             }
-        }
+            UpdateCarry(*pending);
+
+            currentSector_ += pending->count;
+
+            // Checkpoint ai confini di lotto: tutti i settori precedenti sono scritti
+            if (journal_.ShouldCheckpoint() && !SaveCheckpoint(currentSector_)) {
+                std::cerr << "Avviso: checkpoint non riuscito per " << outputFile << std::endl;
+            }
 
-        // Aggiorna progresso
-        if (currentSector_ % 1000 == 0 || currentSector_ == totalSectors_ - 1) {
-            UpdateProgress("Comprimendo settore " + std::to_string(currentSector_ + 1) + 
+            // Aggiorna progresso
+            UpdateProgress("Comprimendo settore " + std::to_string(currentSector_) + 
                          " di " + std::to_string(totalSectors_));
         }
+        pending = batch;
     }
 
     // Aggiungi ultimo indice
-    indexTable_[totalSectors_] = static_cast<uint32_t>(outputPos_);
+    indexTable_[totalSectors_] = static_cast<uint32_t>(outputPos_ >> indexShift_);
 
-    // Scrivi tabella indici
-    if (!WriteIndexTable()) {
+    // Scrivi impronta e tabella indici e completa l'output (su stdout solo ora esce il file)
+    if (!WriteSettingsTrailer() || !WriteIndexTable() || !FinishOutput()) {
         CleanupCompression();
         return TASK_ERROR;
     }
 
-    UpdateProgress("Compressione CSO completata");
+    // Statistiche di selezione dell'immagine: i totali sono in selector_, le altre
+    // sommate su tutti i worker
+    uint64_t layoutStored = 0;
+    uint64_t fillBlocks = 0;
+    uint64_t reusedBlocks = 0;
+    for (const auto& worker : workers_) {
+        layoutStored += worker.layoutStored;
+        fillBlocks += worker.fillBlocks;
+        reusedBlocks += worker.reusedBlocks;
+    }
+    std::vector<std::string> names;
+    for (const auto& candidate : candidates_) {
+        names.push_back(candidate.codec->GetName());
+    }
+    std::string summary = selector_.Summary(names);
+    summary += ", ripetuti: " + std::to_string(runBlocks_) +
+               ", riempimento costante: " + std::to_string(fillBlocks);
+    if (!layout_.IsEmpty()) {
+        summary += ", già compressi senza tentativi: " + std::to_string(layoutStored);
+    }
+    if (reuse_) {
+        summary += ", riusati: " + std::to_string(reusedBlocks);
+    }
+    if (cache_) {
+        summary += ", dalla cache: " + std::to_string(cache_->GetHits()) + " su " +
+                   std::to_string(cache_->GetHits() + cache_->GetMisses());
+    }
+    UpdateProgress("Compressione CSO completata (" + summary + ")");
     CleanupCompression();
+    journal_.Remove();
     return TASK_SUCCESS;
 }
 
-bool CSOCompressor::InitializeCompression(const std::string& inputFile, const std::string& outputFile) {
-    // Apri file di input
-    inputFile_ = fopen(inputFile.c_str(), "rb");
-    if (!inputFile_) {
-        return false;
+TaskStatus CSOCompressor::Estimate(const std::string& inputFile, uint32_t strata, CompressionEstimate& estimate) {
+    estimate = CompressionEstimate();
+    if (!InitializeCompression(inputFile)) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    if (!input_.IsSeekable()) {
+        std::cerr << "Errore: --estimate richiede un input con accesso casuale" << std::endl;
+        CleanupCompression();
+        return TASK_ERROR;
     }
 
-    // Ottieni dimensione file
-    fseek(inputFile_, 0, SEEK_END);
-    inputSize_ = ftell(inputFile_);
-    fseek(inputFile_, 0, SEEK_SET);
+    // Stessi candidati e worker della compressione, senza thread né code
+    if (!LoadDictionary()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    SelectIndexShift();
+    if (!SetupCandidates() || !SetupWorkers()) {
+        CleanupCompression();
+        return TASK_ERROR;
+    }
+    SelectBlockLoops();
+    UpdateProgress("Stima CSO...");
 
-    // Calcola numero settori
-    totalSectors_ = static_cast<uint32_t>((inputSize_ + SECTOR_SIZE - 1) / SECTOR_SIZE);
+    BlockSampler sampler;
+    if (!sampler.Load(input_, strata, CSO_ESTIMATE_SECTORS * blockSize_, blockSize_)) {
+        std::cerr << "Errore: " << sampler.GetLastError() << std::endl;
+        CleanupCompression();
+        return TASK_ERROR;
+    }
 
-    // Apri file di output
-    outputFile_ = fopen(outputFile.c_str(), "wb");
-    if (!outputFile_) {
-        fclose(inputFile_);
-        inputFile_ = nullptr;
+    // Un lotto per porzione campionata: classificazione dei file e sequenze
+    // ripetute lavorano sui settori reali dell'immagine
+    const std::vector<ImageSample>& samples = sampler.GetSamples();
+    std::vector<CSOBatch> batches(samples.size());
+    for (size_t s = 0; s < samples.size(); ++s) {
+        CSOBatch& batch = batches[s];
+        batch.firstSector = static_cast<uint32_t>(samples[s].offset / blockSize_);
+        batch.count = static_cast<uint32_t>(samples[s].data.size() / blockSize_);
+        batch.input = samples[s].data;
+        batch.output.resize(batch.input.size());
+        batch.results.resize(batch.count);
+        batch.reuse.assign(batch.count, CSOReuseBlock{-1, 0});
+        batch.learned.resize((batch.count + CSO_BLOCKS_PER_CHUNK - 1) / CSO_BLOCKS_PER_CHUNK);
+        MarkRuns(batch, nullptr);
+    }
+
+    // Ogni thread prende le porzioni da un contatore con il proprio contesto
+    std::vector<double> seconds(batches.size(), 0.0);
+    std::atomic<size_t> next(0);
+    auto worker = [&](CSOWorkerContext& ctx) {
+        Numa::NodeScope scope(numaNodes_ > 1, ctx.node);
+        for (size_t s = next++; s < batches.size(); s = next++) {
+            CSOChunk chunk;
+            chunk.batch = &batches[s];
+            chunk.end = batches[s].count;
+            auto start = std::chrono::steady_clock::now();
+            CompressChunk(ctx, chunk);
+            seconds[s] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+    for (size_t w = 1; w < workers_.size(); ++w) {
+        threads_.Start([&worker, this, w] { worker(workers_[w]); });
+    }
+    worker(workers_[0]);
+    threads_.Join();
+    if (control_ && control_->IsCancelled()) {
+        CleanupCompression();
+        return TASK_CANCELLED;
+    }
+
+    // Byte scritti da ogni porzione, come in WriteBlocks
+    std::vector<double> ratios;
+    for (const auto& batch : batches) {
+        uint64_t written = 0;
+        for (uint32_t i = 0; i < batch.count; ++i) {
+            const CSOBlockResult* result = &batch.results[i];
+            if (result->source >= 0) {
+                result = &batch.results[result->source];
+            }
+            written += (result->size > 0) ? static_cast<uint32_t>(result->size) : blockSize_;
+        }
+        ratios.push_back(static_cast<double>(written) / batch.input.size());
+    }
+
+    estimate.inputSize = inputSize_;
+    estimate.sampleBytes = sampler.GetSampleBytes();
+    uint64_t overhead = headerSize_ + GetIndexSize();
+    ExtrapolateEstimate(ratios, seconds, static_cast<uint64_t>(CSO_ESTIMATE_SECTORS) * blockSize_,
+                        static_cast<uint64_t>(totalSectors_) * blockSize_, overhead,
+                        static_cast<uint32_t>(workers_.size()), estimate);
+    CleanupCompression();
+    return TASK_SUCCESS;
+}
+
+bool CSOCompressor::InitializeCompression(const std::string& inputFile) {
+    // Apri input (file o stdin): la dimensione di una pipe è quella dichiarata,
+    // CSO e CHD vengono decompressi al volo
+    std::string error;
+    if (!OpenImageInput(input_, inputFile, declaredInputSize_, config_.threads, error)) {
+        std::cerr << "Errore: " << error << std::endl;
+        return false;
+    }
+    inputSize_ = input_.GetSize();
+
+    // Dimensione DAX a 32 bit: rifiutata prima di creare o troncare l'output
+    if (config_.format == CSO_FORMAT_DAX && inputSize_ > UINT32_MAX) {
+        std::cerr << "Errore: il formato DAX non supporta immagini oltre 4 GB" << std::endl;
         return false;
     }
 
+    // Mappa dei file: richiede accesso casuale, le pipe vanno lette in ordine
+    layout_.Clear();
+    if (config_.fileAnalysis && input_.IsSeekable() && layout_.Analyze(input_)) {
+        UpdateProgress("Analisi file: " + layout_.Summary());
+    }
+
+    // Calcola numero settori
+    totalSectors_ = static_cast<uint32_t>((inputSize_ + blockSize_ - 1) / blockSize_);
+    indexTable_.assign(totalSectors_ + 1, 0);
+    ncCapacity_ = (config_.format == CSO_FORMAT_DAX) ? totalSectors_ / DAX_FRAMES_PER_NC_AREA + 1 : 0;
+    ncAreas_ = 0;
+
     outputPos_ = 0;
     currentSector_ = 0;
     
@@ -164,89 +344,943 @@ bool CSOCompressor::InitializeCompression(const std::string& inputFile, const st
 }
 
 void CSOCompressor::CleanupCompression() {
-    if (inputFile_) {
-        fclose(inputFile_);
-        inputFile_ = nullptr;
+    DestroyWorkers();
+    input_.Close();
+    output_.reset();
+    reuse_.reset();
+    cache_.reset();     // rende visibili agli altri lavori i blocchi aggiunti
+
+    // Buffer dei lotti: possono occupare decine di MB con molti worker
+    for (auto& batch : batches_) {
+        BufferPool::Release(buffers_, batch.input);
+        BufferPool::Release(buffers_, batch.output);
+        BufferPool::Release(buffers_, batch.reuseData);
     }
-    
-    if (outputFile_) {
-        fclose(outputFile_);
-        outputFile_ = nullptr;
+    std::vector<CSOBatch>().swap(batches_);
+    std::vector<uint8_t>().swap(reuseSpan_);
+}
+
+TaskStatus CSOCompressor::CancelCompression(const std::string& outputFile) {
+    // I lotti già scritti restano validi: --resume riparte da qui
+    if (journal_.IsEnabled() && !SaveCheckpoint(currentSector_)) {
+        std::cerr << "Avviso: checkpoint non riuscito per " << outputFile << std::endl;
     }
+    UpdateProgress("Compressione annullata al settore " + std::to_string(currentSector_) +
+                   " di " + std::to_string(totalSectors_));
+    CleanupCompression();
+    return TASK_CANCELLED;
 }
 
-bool CSOCompressor::ReadInputSector(uint32_t sectorIndex, uint8_t* buffer) {
-    uint64_t offset = static_cast<uint64_t>(sectorIndex) * SECTOR_SIZE;
-    
-    if (fseek(inputFile_, offset, SEEK_SET) != 0) {
+bool CSOCompressor::FinishOutput() {
+    // Dati oltre la dimensione dichiarata: l'immagine sarebbe troncata
+    if (!input_.CheckEnd()) {
+        std::cerr << "Errore: l'input supera la dimensione dichiarata con --size" << std::endl;
         return false;
     }
+    return output_->Finish();
+}
+
+bool CSOCompressor::ReadInputBatch(uint32_t firstSector, uint32_t count, uint8_t* buffer) {
+    uint64_t offset = static_cast<uint64_t>(firstSector) * blockSize_;
+    size_t toRead = static_cast<size_t>(count) * blockSize_;
     
-    // Leggi settore, riempi con zero se parziale
-    size_t bytesRead = fread(buffer, 1, SECTOR_SIZE, inputFile_);
-    if (bytesRead < SECTOR_SIZE) {
-        memset(buffer + bytesRead, 0, SECTOR_SIZE - bytesRead);
+    // Leggi lotto, riempi con zero l'ultimo settore se parziale
+    size_t bytesRead = input_.ReadAt(offset, buffer, toRead);
+    if (bytesRead < toRead) {
+        if (offset + bytesRead < inputSize_) {
+            return false;
+        }
+        memset(buffer + bytesRead, 0, toRead - bytesRead);
     }
     
     return true;
 }
 
-bool CSOCompressor::WriteCompressedSector(const uint8_t* data, uint32_t dataSize, uint32_t sectorIndex) {
-    // Salva posizione nell'indice
-    indexTable_[sectorIndex] = static_cast<uint32_t>(outputPos_);
-    
-    // Scrivi dati compressi
-    if (fwrite(data, 1, dataSize, outputFile_) != dataSize) {
+bool CSOCompressor::LoadDictionary() {
+    dictionary_.clear();
+    headerSize_ = (config_.format == CSO_FORMAT_DAX) ? sizeof(DAXHeader) : sizeof(CSOHeader);
+    if (config_.dictionary.empty()) {
+        return true;
+    }
+
+    // Solo ZCSO sa trasportare un dizionario nel file
+    if (config_.format != CSO_FORMAT_ZCSO) {
+        std::cerr << "Il dizionario richiede il formato zcso" << std::endl;
         return false;
     }
-    
-    outputPos_ += dataSize;
+    if (!Utils::ReadFileData(config_.dictionary, dictionary_) || dictionary_.empty()) {
+        std::cerr << "Impossibile leggere il dizionario: " << config_.dictionary << std::endl;
+        return false;
+    }
+    headerSize_ += static_cast<uint32_t>(dictionary_.size());
     return true;
 }
 
-bool CSOCompressor::WriteUncompressedSector(const uint8_t* data, uint32_t sectorIndex) {
-    // Salva posizione nell'indice con flag non compresso
-    indexTable_[sectorIndex] = static_cast<uint32_t>(outputPos_) | CSO_INDEX_UNCOMPRESSED;
-    
-    // Scrivi dati non compressi
-    if (fwrite(data, 1, SECTOR_SIZE, outputFile_) != SECTOR_SIZE) {
+bool CSOCompressor::OpenOutput(const std::string& inputFile, const std::string& outputFile,
+                               JournalState& resumeState) {
+    resumeState = JournalState();
+
+    // Da pipe o verso stdout non c'è nulla da riprendere: niente journal
+    if (!input_.IsSeekable() || IsStdioPath(outputFile)) {
+        if (resume_) {
+            std::cerr << "Avviso: --resume ignorato per input o output in streaming" << std::endl;
+        }
+        output_ = OutputStream::Open(outputFile);
+        return output_ != nullptr;
+    }
+
+    journal_.Open(inputFile, outputFile, JOURNAL_CSO, LayoutFingerprint(), totalSectors_, checkpointInterval_);
+
+    std::vector<uint8_t> table;
+    if (resume_) {
+        if (journal_.Load(resumeState, table) &&
+            table.size() == static_cast<size_t>(resumeState.committedBlocks) * sizeof(uint32_t)) {
+            // Scarta quanto scritto dopo l'ultimo checkpoint e riapri senza troncare
+            std::error_code error;
+            std::filesystem::resize_file(outputFile, resumeState.outputPos, error);
+            output_ = error ? nullptr : OutputStream::Open(outputFile, true);
+            if (output_) {
+                memcpy(indexTable_.data(), table.data(), table.size());
+                UpdateProgress("Ripresa dal settore " + std::to_string(resumeState.committedBlocks) +
+                               " di " + std::to_string(totalSectors_));
+                return true;
+            }
+        }
+        std::cerr << "Nessun checkpoint valido per " << outputFile << ", compressione da capo" << std::endl;
+        resumeState = JournalState();
+    }
+
+    // Un journal rimasto da un altro lavoro non deve poter descrivere il nuovo output
+    journal_.Remove();
+    output_ = OutputStream::Open(outputFile);
+    return output_ != nullptr;
+}
+
+bool CSOCompressor::SaveCheckpoint(uint32_t committedSectors) {
+    JournalState state;
+    state.committedBlocks = committedSectors;
+    state.outputPos = outputPos_;
+    return journal_.Checkpoint(*output_, state, indexTable_.data(),
+                               static_cast<size_t>(committedSectors) * sizeof(uint32_t));
+}
+
+uint64_t CSOCompressor::LayoutFingerprint() const {
+    // Opzioni che cambiano la posizione o l'interpretazione dei blocchi già scritti
+    uint32_t layout[5] = {static_cast<uint32_t>(config_.format), blockSize_,
+                          static_cast<uint32_t>(config_.zcsoCodec), headerSize_, indexShift_};
+    uint64_t hash = CompressionJournal::Fingerprint(CompressionJournal::FINGERPRINT_SEED, layout, sizeof(layout));
+    return CompressionJournal::Fingerprint(hash, dictionary_.data(), dictionary_.size());
+}
+
+bool CSOCompressor::SetupCandidates() {
+    return BuildCandidates(config_, dictionary_, candidates_);
+}
+
+bool CSOCompressor::BuildCandidates(const CSOConfig& config, const std::vector<uint8_t>& dictionary,
+                                    std::vector<CSOCandidate>& candidates) {
+    candidates.clear();
+
+    for (const Codec* codec : CodecRegistry::Instance().GetCodecs()) {
+        // ZSO contiene solo blocchi LZ4: il codec è implicito nel formato
+        if (config.format == CSO_FORMAT_ZSO) {
+            if (codec->GetFormat() != CODEC_FORMAT_LZ4) {
+                continue;
+            }
+        } else if (!(config.algorithms & codec->GetAlgorithmFlag())) {
+            continue;
+        }
+
+        CSOCandidate candidate = {};
+        candidate.codec = codec;
+        candidate.costPercent = 100.0;
+        CodecProfile profile = codec->GetProfile();
+        candidate.options.level = config.fastMode ? profile.fastLevel : profile.maxLevel;
+        candidate.options.blockSizeHint = GetBlockSize(config.format);
+
+        switch (codec->GetFormat()) {
+            case CODEC_FORMAT_DEFLATE:
+                // In ZCSO i blocchi non-LZ4 sono tutti del codec indicato nell'header
+                if (config.format == CSO_FORMAT_ZCSO && config.zcsoCodec != ZCSO_CODEC_DEFLATE) {
+                    continue;
+                }
+                // Formati con header CSO: deflate raw (windowBits -15), senza header zlib
+                // né Adler-32 da calcolare per ogni blocco. I frame DAX sono stream zlib
+                candidate.options.rawDeflate = (config.format != CSO_FORMAT_DAX);
+                break;
+            case CODEC_FORMAT_LZ4:
+                // CSO1 non può marcare i blocchi LZ4 nell'indice, DAX conosce solo zlib
+                if (config.format == CSO_FORMAT_CSO1 || config.format == CSO_FORMAT_DAX) {
+                    continue;
+                }
+                // lz4CostPercent < 100 favorisce LZ4 (decodifica più veloce sul dispositivo)
+                candidate.costPercent = config.lz4CostPercent;
+                candidate.indexFlags = (config.format == CSO_FORMAT_CSO2 || config.format == CSO_FORMAT_ZCSO)
+                    ? CSO2_INDEX_LZ4 : 0;
+                if (config.lz4Level != 0) {
+                    candidate.options.level = config.lz4Level;
+                }
+                break;
+            case CODEC_FORMAT_ZSTD:
+                if (config.format != CSO_FORMAT_ZCSO || config.zcsoCodec != ZCSO_CODEC_ZSTD) {
+                    continue;
+                }
+                if (config.zstdLevel > 0) {
+                    candidate.options.level = config.zstdLevel;
+                }
+                break;
+            default:
+                continue; // Formato non rappresentabile in un CSO
+        }
+
+        // Il decoder ZCSO carica il dizionario per ogni blocco compresso: i codec
+        // che non lo supportano producono comunque blocchi validi, solo senza vantaggio
+        if (!dictionary.empty() && codec->HasCapability(CODEC_CAP_DICTIONARY)) {
+            candidate.options.dictionary = dictionary.data();
+            candidate.options.dictionarySize = static_cast<uint32_t>(dictionary.size());
+        }
+
+        candidates.push_back(candidate);
+    }
+
+    if (config.format == CSO_FORMAT_ZSO && candidates.empty()) {
+        std::cerr << "Formato ZSO richiesto ma il codec LZ4 non è disponibile" << std::endl;
         return false;
     }
-    
-    outputPos_ += SECTOR_SIZE;
+    if (config.format == CSO_FORMAT_DAX && candidates.empty()) {
+        std::cerr << "Formato DAX richiesto ma nessun codec deflate è disponibile o abilitato" << std::endl;
+        return false;
+    }
+    if (config.format == CSO_FORMAT_ZCSO) {
+        CodecFormat family = (config.zcsoCodec == ZCSO_CODEC_DEFLATE) ? CODEC_FORMAT_DEFLATE : CODEC_FORMAT_ZSTD;
+        if (std::none_of(candidates.begin(), candidates.end(), [family](const CSOCandidate& c) {
+                return c.codec->GetFormat() == family;
+            })) {
+            std::cerr << "Formato ZCSO richiesto ma il codec dei blocchi non è disponibile o è disabilitato" << std::endl;
+            return false;
+        }
+    }
+
+    // I codec più veloci per primi: fissano presto il limite per gli altri
+    std::stable_sort(candidates.begin(), candidates.end(), [](const CSOCandidate& a, const CSOCandidate& b) {
+        return a.codec->GetProfile().speed > b.codec->GetProfile().speed;
+    });
+    if (candidates.size() > static_cast<size_t>(CodecSelector::MAX_CODECS)) {
+        candidates.resize(CodecSelector::MAX_CODECS);
+    }
     return true;
 }
 
-int CSOCompressor::CompressWithZlib(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize) {
-    uLongf compressedSize = outputSize;
-    int level = config_.fastMode ? 1 : 9; // Livello compressione
-    
-    int result = compress2(output, &compressedSize, input, inputSize, level);
-    
-    if (result == Z_OK) {
-        return static_cast<int>(compressedSize);
+bool CSOCompressor::SetupWorkers() {
+    workers_.clear();
+    workers_.resize(config_.threads);
+
+    // --numa: worker divisi in gruppi contigui per nodo
+    numaNodes_ = 1;
+    if (config_.numa) {
+        if (Numa::IsAvailable()) {
+            numaNodes_ = std::min(Numa::NodeCount(), config_.threads);
+            UpdateProgress("NUMA: " + std::to_string(numaNodes_) + " nodi");
+        } else {
+            std::cerr << "Avviso: --numa ignorato: un solo nodo NUMA o libnuma non disponibile" << std::endl;
+        }
     }
-    
-    return -1; // Errore
+
+    // Buffer dimensionati sul caso peggiore dei codec candidati
+    uint32_t bound = blockSize_;
+    for (const auto& candidate : candidates_) {
+        bound = std::max(bound, candidate.codec->GetBound(blockSize_));
+    }
+
+    // Sonda dei blocchi ad alta entropia: il codec più veloce al suo livello
+    // veloce, anche se non è tra i candidati, perché il suo output non viene scritto
+    const Codec* probeCodec = nullptr;
+    for (const Codec* codec : CodecRegistry::Instance().GetCodecs()) {
+        if (!probeCodec || codec->GetProfile().speed > probeCodec->GetProfile().speed) {
+            probeCodec = codec;
+        }
+    }
+
+    for (uint32_t w = 0; w < workers_.size(); ++w) {
+        CSOWorkerContext& worker = workers_[w];
+        worker.node = Numa::ShardOf(w, static_cast<uint32_t>(workers_.size()), numaNodes_);
+
+        // Buffer e contesti vengono creati (e toccati) dal thread principale
+        // spostato temporaneamente sul nodo del worker
+        Numa::NodeScope scope(numaNodes_ > 1, worker.node);
+        BufferPool::Acquire(buffers_, worker.outputBuffer, bound, worker.node);
+        BufferPool::Acquire(buffers_, worker.candidateBuffer, bound, worker.node);
+        worker.fills.assign(256, CSOFillEntry());
+
+        // Un decoder per ogni tipo di blocco che --reuse può copiare
+        worker.decoders.clear();
+        worker.decoders.resize(CSO_BLOCK_KINDS);
+        if (reuse_) {
+            BufferPool::Acquire(buffers_, worker.verifyBuffer, blockSize_, worker.node);
+            for (int kind = 0; kind < CSO_BLOCK_KINDS; ++kind) {
+                if (reuseSlots_[kind] >= 0) {
+                    worker.decoders[kind] = reuse_->CreateDecoder(static_cast<CSOBlockKind>(kind));
+                }
+            }
+        }
+
+        // Stato dei codec in memoria del worker, su huge page e già toccata
+        worker.arena = BufferPool::AcquireArena(buffers_, worker.node);
+        if (probeCodec) {
+            CodecOptions options;
+            options.level = probeCodec->GetProfile().fastLevel;
+            options.blockSizeHint = blockSize_;
+            if (!dictionary_.empty() && probeCodec->HasCapability(CODEC_CAP_DICTIONARY)) {
+                options.dictionary = dictionary_.data();
+                options.dictionarySize = static_cast<uint32_t>(dictionary_.size());
+            }
+            options.arena = worker.arena.get();
+            worker.probe = probeCodec->CreateContext(options);
+            if (!worker.probe) {
+                std::cerr << "Errore: impossibile inizializzare il codec " << probeCodec->GetName() << std::endl;
+                return false;
+            }
+        }
+        for (const auto& candidate : candidates_) {
+            CodecOptions options = candidate.options;
+            options.arena = worker.arena.get();
+            auto context = candidate.codec->CreateContext(options);
+            if (!context) {
+                std::cerr << "Errore: impossibile inizializzare il codec " << candidate.codec->GetName()
+                          << " (livello " << options.level << ")" << std::endl;
+                return false;
+            }
+            worker.codecs.push_back(std::move(context));
+        }
+    }
+    return true;
 }
 
-int CSOCompressor::CompressWithLZ4(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize) {
-    #ifdef HAVE_LZ4
-    if (config_.fastMode) {
-        return LZ4_compress_default(reinterpret_cast<const char*>(input), 
-                                  reinterpret_cast<char*>(output), 
-                                  inputSize, outputSize);
+bool CSOCompressor::CreateWorkers() {
+    if (!SetupWorkers()) {
+        return false;
+    }
+
+    // Code dimensionate su tutte le porzioni dei lotti in volo: i worker non
+    // attendono mai lo scrittore per depositare un risultato
+    uint32_t batchSectors = static_cast<uint32_t>(workers_.size()) * CSO_BLOCKS_PER_WORKER;
+    uint32_t chunksInFlight = CSO_BATCHES_IN_FLIGHT *
+                              ((batchSectors + CSO_BLOCKS_PER_CHUNK - 1) / CSO_BLOCKS_PER_CHUNK);
+    chunkQueue_ = std::make_unique<ShardedQueue<CSOChunk>>(numaNodes_, chunksInFlight);
+    completedChunks_ = std::make_unique<ReorderBuffer<CSOChunk>>(chunksInFlight);
+    nextChunk_ = 0;
+    selector_.Reset();
+
+    // Con un solo worker le porzioni vengono compresse dal thread principale
+    if (workers_.size() > 1) {
+        for (auto& worker : workers_) {
+            threads_.Start([this, &worker] { WorkerLoop(worker); });
+        }
+    }
+    return true;
+}
+
+void CSOCompressor::DestroyWorkers() {
+    if (chunkQueue_) {
+        chunkQueue_->Close();
+    }
+    threads_.Join();
+    chunkQueue_.reset();
+    completedChunks_.reset();
+
+    // I contesti prima delle arene che ne contengono lo stato
+    for (auto& worker : workers_) {
+        worker.codecs.clear();
+        worker.probe.reset();
+        worker.decoders.clear();
+        BufferPool::ReleaseArena(buffers_, worker.arena, worker.node);
+        BufferPool::Release(buffers_, worker.outputBuffer, worker.node);
+        BufferPool::Release(buffers_, worker.candidateBuffer, worker.node);
+        BufferPool::Release(buffers_, worker.verifyBuffer, worker.node);
+    }
+    workers_.clear();
+}
+
+void CSOCompressor::WorkerLoop(CSOWorkerContext& ctx) {
+    // Su un thread del pool il nodo vale solo per questo lavoro
+    Numa::NodeScope scope(numaNodes_ > 1, ctx.node);
+    CSOChunk chunk;
+    while (chunkQueue_->Pop(ctx.node, chunk)) {
+        CompressChunk(ctx, chunk);
+        completedChunks_->Put(chunk.sequence, chunk);
+    }
+}
+
+uint32_t CSOCompressor::ChunkNode(uint32_t chunk) const {
+    // Stessa divisione per tutti i lotti: quella dei lotti completi
+    uint32_t batchSectors = static_cast<uint32_t>(workers_.size()) * CSO_BLOCKS_PER_WORKER;
+    uint32_t chunks = (batchSectors + CSO_BLOCKS_PER_CHUNK - 1) / CSO_BLOCKS_PER_CHUNK;
+    return Numa::ShardOf(chunk, chunks, numaNodes_);
+}
+
+void CSOCompressor::PlaceBatch(CSOBatch& batch) {
+    if (numaNodes_ <= 1) {
+        return;
+    }
+    const size_t chunkBytes = static_cast<size_t>(CSO_BLOCKS_PER_CHUNK) * blockSize_;
+    for (size_t offset = 0; offset < batch.input.size(); offset += chunkBytes) {
+        uint32_t node = ChunkNode(static_cast<uint32_t>(offset / chunkBytes));
+        size_t size = std::min(chunkBytes, batch.input.size() - offset);
+        Numa::PlaceMemory(batch.input.data() + offset, size, node);
+        Numa::PlaceMemory(batch.output.data() + offset, size, node);
+        if (!batch.reuseData.empty()) {
+            Numa::PlaceMemory(batch.reuseData.data() + offset, size, node);
+        }
+    }
+}
+
+void CSOCompressor::CompressChunk(CSOWorkerContext& ctx, const CSOChunk& chunk) {
+    // La porzione parte dallo stato del lotto e ne restituisce l'aggiornamento:
+    // i codec scelti non dipendono da quale worker la comprime
+    CSOBatch& batch = *chunk.batch;
+    ctx.selector = batch.selector;
+    (this->*chunkLoop_)(ctx, chunk);
+    batch.learned[chunk.begin / CSO_BLOCKS_PER_CHUNK] = ctx.selector;
+}
+
+void CSOCompressor::DispatchBatch(CSOBatch& batch) {
+    // Stato appreso fino all'ultimo lotto scritto: con CSO_BATCHES_IN_FLIGHT
+    // lotti in volo è sempre quello di due lotti prima, con qualunque numero di
+    // worker e ordine di completamento
+    batch.selector = selector_;
+    batch.firstChunk = nextChunk_;
+    batch.chunks = 0;
+    for (uint32_t begin = 0; begin < batch.count; begin += CSO_BLOCKS_PER_CHUNK) {
+        CSOChunk chunk;
+        chunk.batch = &batch;
+        chunk.begin = begin;
+        chunk.end = std::min(batch.count, begin + CSO_BLOCKS_PER_CHUNK);
+        chunk.sequence = nextChunk_++;
+        batch.chunks++;
+
+        if (threads_.IsEmpty()) {
+            CompressChunk(workers_[0], chunk);
+            completedChunks_->Put(chunk.sequence, chunk);
+        } else {
+            chunkQueue_->Push(ChunkNode(begin / CSO_BLOCKS_PER_CHUNK), chunk);
+        }
+    }
+}
+
+void CSOCompressor::SelectBlockLoops() {
+    // Indice: un solo candidato, analisi dei file, cache
+    static const ChunkLoop sectorLoops[8] = {
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, false, false, false>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, false, false, true>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, false, true, false>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, false, true, true>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, true, false, false>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, true, false, true>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, true, true, false>,
+        &CSOCompressor::CompressChunkAs<SECTOR_SIZE, true, true, true>,
+    };
+    static const ChunkLoop frameLoops[8] = {
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, false, false, false>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, false, false, true>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, false, true, false>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, false, true, true>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, true, false, false>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, true, false, true>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, true, true, false>,
+        &CSOCompressor::CompressChunkAs<DAX_FRAME_SIZE, true, true, true>,
+    };
+    size_t loop = (candidates_.size() == 1 ? 4 : 0) + (!layout_.IsEmpty() ? 2 : 0) + (cache_ ? 1 : 0);
+    chunkLoop_ = (blockSize_ == DAX_FRAME_SIZE) ? frameLoops[loop] : sectorLoops[loop];
+
+    switch (config_.format) {
+        case CSO_FORMAT_CSO2:
+            writeLoop_ = &CSOCompressor::WriteBlocksAs<CSO_FORMAT_CSO2>;
+            break;
+        case CSO_FORMAT_ZSO:
+            writeLoop_ = &CSOCompressor::WriteBlocksAs<CSO_FORMAT_ZSO>;
+            break;
+        case CSO_FORMAT_ZCSO:
+            writeLoop_ = &CSOCompressor::WriteBlocksAs<CSO_FORMAT_ZCSO>;
+            break;
+        case CSO_FORMAT_DAX:
+            writeLoop_ = &CSOCompressor::WriteBlocksAs<CSO_FORMAT_DAX>;
+            break;
+        default:
+            writeLoop_ = &CSOCompressor::WriteBlocksAs<CSO_FORMAT_CSO1>;
+            break;
+    }
+}
+
+template <uint32_t BlockSize, bool SingleCandidate, bool Layout, bool Cache>
+void CSOCompressor::CompressChunkAs(CSOWorkerContext& ctx, const CSOChunk& chunk) {
+    CSOBatch& batch = *chunk.batch;
+
+    for (uint32_t i = chunk.begin; i < chunk.end; ++i) {
+        // Annullamento: il resto della porzione viene scartato
+        if (control_ && control_->IsCancelled()) {
+            return;
+        }
+        const uint8_t* input = batch.input.data() + static_cast<size_t>(i) * BlockSize;
+        CSOBlockResult& result = batch.results[i];
+        result.size = -1;
+        result.slot = -1;
+
+        // Copia di un blocco precedente: la scrittura riusa il suo risultato
+        if (result.source != -1) {
+            continue;
+        }
+
+        // Riempimento costante (zeri dei file dummy, 0xFF delle zone vuote):
+        // compresso la prima volta per valore di byte, poi copiato dalla cache
+        uint8_t fill;
+        if (IsConstantBlock(input, BlockSize, fill)) {
+            CSOFillEntry& entry = ctx.fills[fill];
+            if (!entry.ready) {
+                // Fuori dal selettore: quale porzione incontra per prima il
+                // valore dipende da come i worker si dividono le porzioni
+                entry.size = CompressBlock<BlockSize, SingleCandidate>(ctx, input, entry.slot, CONTENT_PADDING, false);
+                if (entry.size > 0) {
+                    entry.data.assign(ctx.outputBuffer.begin(), ctx.outputBuffer.begin() + entry.size);
+                }
+                entry.ready = true;
+            } else {
+                ctx.fillBlocks++;
+            }
+            result.size = entry.size;
+            result.slot = entry.slot;
+            if (entry.size > 0) {
+                memcpy(batch.output.data() + static_cast<size_t>(i) * BlockSize,
+                       entry.data.data(), entry.size);
+            }
+            continue;
+        }
+
+        // Blocco dell'output precedente che decodifica negli stessi dati
+        if (batch.reuse[i].size > 0 && ReuseBlock(ctx, batch, i)) {
+            continue;
+        }
+
+        // Video, audio e archivi già compressi: salvati senza tentativi
+        ContentClass content = CONTENT_UNKNOWN;
+        if constexpr (Layout) {
+            uint64_t offset = static_cast<uint64_t>(batch.firstSector + i) * BlockSize;
+            content = layout_.ClassifyRange(offset, BlockSize);
+            if (content == CONTENT_COMPRESSED && layout_.HasRawSectors()) {
+                // Nei settori raw l'intestazione e l'ECC restano comprimibili: basta il codec più veloce
+                content = CONTENT_PADDING;
+            } else if (content == CONTENT_COMPRESSED) {
+                ctx.layoutStored++;
+                continue;
+            }
+        }
+
+        // Blocco già compresso in un'altra immagine: nessun codec né aggiornamento del selettore
+        uint8_t* output = batch.output.data() + static_cast<size_t>(i) * BlockSize;
+        uint8_t key[BlockCache::KEY_SIZE];
+        if constexpr (Cache) {
+            BlockCache::MakeKey(input, BlockSize, content, key);
+            if (cache_->Lookup(key, output, BlockSize, result.size, result.slot) &&
+                (result.size < 0 || static_cast<size_t>(result.slot) < candidates_.size())) {
+                continue;
+            }
+        }
+
+        // Selezione adattiva del codec con interruzione anticipata
+        result.size = CompressBlock<BlockSize, SingleCandidate>(ctx, input, result.slot, content);
+        if (result.size > 0) {
+            memcpy(output, ctx.outputBuffer.data(), result.size);
+        }
+        if constexpr (Cache) {
+            cache_->Store(key, output, result.size, result.slot);
+        }
+    }
+}
+
+void CSOCompressor::MarkRuns(CSOBatch& batch, const CSOBatch* previous) {
+    for (uint32_t i = 0; i < batch.count; ++i) {
+        const uint8_t* input = batch.input.data() + static_cast<size_t>(i) * blockSize_;
+        int& source = batch.results[i].source;
+        source = -1;
+
+        // Confronto solo con il blocco precedente: le sequenze puntano al loro primo blocco.
+        // Il lotto precedente può essere ancora in compressione, ma i suoi dati non cambiano.
+        if (i == 0) {
+            const uint8_t* last = previous ? previous->input.data() +
+                                             static_cast<size_t>(previous->count - 1) * blockSize_
+                                           : nullptr;
+            if (last && memcmp(input, last, blockSize_) == 0) {
+                source = CSO_SOURCE_CARRY;
+            }
+        } else if (memcmp(input, input - blockSize_, blockSize_) == 0) {
+            int previousSource = batch.results[i - 1].source;
+            source = (previousSource != -1) ? previousSource : static_cast<int>(i - 1);
+        }
+    }
+}
+
+bool CSOCompressor::WriteBatch(CSOBatch& batch, bool& cancelled) {
+    uint64_t startPos = outputPos_;
+    for (uint32_t c = 0; c < batch.chunks; ++c) {
+        CSOChunk chunk;
+        completedChunks_->Take(chunk);
+
+        // Porzione interrotta: il checkpoint resta all'inizio del lotto
+        if (control_ && control_->IsCancelled()) {
+            outputPos_ = startPos;
+            cancelled = true;
+            return false;
+        }
+        if (!WriteBlocks(batch, chunk.begin, chunk.end)) {
+            return false;
+        }
+        selector_.Learn(batch.selector, batch.learned[chunk.begin / CSO_BLOCKS_PER_CHUNK]);
+    }
+    return true;
+}
+
+template <CSOFormat Format>
+bool CSOCompressor::WriteBlocksAs(const CSOBatch& batch, uint32_t begin, uint32_t end) {
+    // In CSO2 e ZCSO il bit alto dell'indice indica LZ4 e i blocchi non compressi
+    // si riconoscono dalla dimensione, come i frame NC di DAX; negli altri
+    // formati serve il flag
+    constexpr bool lz4Flag = (Format == CSO_FORMAT_CSO2 || Format == CSO_FORMAT_ZCSO);
+    constexpr uint32_t uncompressedFlag = (lz4Flag || Format == CSO_FORMAT_DAX) ? 0 : CSO_INDEX_UNCOMPRESSED;
+    constexpr uint32_t blockSize = (Format == CSO_FORMAT_DAX) ? DAX_FRAME_SIZE : SECTOR_SIZE;
+
+    for (uint32_t i = begin; i < end; ++i) {
+        const uint8_t* input = batch.input.data() + static_cast<size_t>(i) * blockSize;
+        const CSOBlockResult* result = &batch.results[i];
+        const uint8_t* output = batch.output.data() + static_cast<size_t>(i) * blockSize;
+
+        // Blocco ripetuto: stesso payload del primo della sequenza (già scritto)
+        if (result->source == CSO_SOURCE_CARRY) {
+            result = &carry_.result;
+            output = carry_.output.data();
+            runBlocks_++;
+        } else if (result->source >= 0) {
+            output = batch.output.data() + static_cast<size_t>(result->source) * blockSize;
+            result = &batch.results[result->source];
+            runBlocks_++;
+        }
+
+        // Offset scalato di index_shift: outputPos_ è sempre allineato. Un blocco
+        // della cache o di --reuse che allineato non resta sotto blockSize va salvato
+        // non compresso (in CSO2 e ZCSO lo riconosce solo la dimensione)
+        uint32_t& entry = indexTable_[batch.firstSector + i];
+        entry = static_cast<uint32_t>(outputPos_ >> indexShift_);
+        if (result->size > 0 && static_cast<uint32_t>(result->size) <= maxCompressed_) {
+            if constexpr (lz4Flag) {
+                entry |= candidates_[result->slot].indexFlags;
+            }
+            if (!output_->Write(output, result->size)) {
+                return false;
+            }
+            outputPos_ += result->size;
+            if (!PadOutput()) {
+                return false;
+            }
+        } else {
+            // Compressione non conveniente - salva non compresso
+            if constexpr (Format == CSO_FORMAT_DAX) {
+                // Il frame apre un'area NC o allunga quella del frame precedente.
+                // Aree riservate esaurite: resta un frame zlib, con un blocco stored
+                const uint32_t frame = batch.firstSector + i;
+                if (frame == 0 || entry - indexTable_[frame - 1] != DAX_FRAME_SIZE) {
+                    if (ncAreas_ == ncCapacity_) {
+                        if (!WriteStoredFrame(input)) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    ncAreas_++;
+                }
+            }
+            entry |= uncompressedFlag;
+            if (!output_->Write(input, blockSize)) {
+                return false;
+            }
+            outputPos_ += blockSize;
+            if (!PadOutput()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void CSOCompressor::UpdateCarry(const CSOBatch& batch) {
+    if (batch.count == 0) {
+        return;
+    }
+
+    // L'ultimo blocco del lotto, con il risultato già risolto rispetto alla sua sequenza
+    uint32_t last = batch.count - 1;
+    int source = batch.results[last].source;
+    if (source == CSO_SOURCE_CARRY) {
+        return; // la sequenza continua: il blocco di riferimento resta quello salvato
+    }
+    uint32_t block = (source >= 0) ? static_cast<uint32_t>(source) : last;
+
+    const uint8_t* output = batch.output.data() + static_cast<size_t>(block) * blockSize_;
+    carry_.result = batch.results[block];
+    carry_.result.source = -1;
+    carry_.output.assign(output, output + std::max(carry_.result.size, 0));
+}
+
+void CSOCompressor::OpenCache() {
+    cache_.reset();
+    if (cacheDirectory_.empty()) {
+        return;
+    }
+    // Una cache inutilizzabile non impedisce la compressione
+    auto cache = std::make_unique<BlockCache>();
+    if (!cache->Open(cacheDirectory_, CacheConfiguration(), dictionary_)) {
+        std::cerr << "Avviso: --cache ignorato: " << cache->GetLastError() << std::endl;
+        return;
+    }
+    UpdateProgress("Cache: " + std::to_string(cache->GetEntryCount()) + " blocchi");
+    cache_ = std::move(cache);
+}
+
+std::string CSOCompressor::CacheConfiguration() const {
+    // Formato, candidati e costi; non lo stato del selettore adattivo, che cambia
+    // blocco per blocco: un blocco dalla cache è valido e sotto il limite di costo,
+    // ma con più candidati può differire da quello che sceglierebbe questa compressione
+    std::string text = "cso " + std::to_string(config_.format) + " " + std::to_string(blockSize_) + " " +
+                       std::to_string(config_.zcsoCodec) + " " + std::to_string(config_.origCostPercent);
+    for (const auto& candidate : candidates_) {
+        text += " " + std::string(candidate.codec->GetName()) + ":" + std::to_string(candidate.options.level) +
+                ":" + std::to_string(candidate.options.rawDeflate) + ":" + std::to_string(candidate.costPercent) +
+                ":" + std::to_string(candidate.indexFlags);
+    }
+    return text;
+}
+
+void CSOCompressor::SettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]) const {
+    // L'analisi dei file decide i blocchi di riempimento e quelli già compressi
+    std::string text = CacheConfiguration() + " layout " + std::to_string(!layout_.IsEmpty());
+    SHA1 sha;
+    sha.Update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    sha.Update(dictionary_.data(), dictionary_.size());
+    sha.Final(digest);
+}
+
+bool CSOCompressor::WriteSettingsTrailer() {
+    // DAX non ha un lettore per --reuse: il file resta quello del formato
+    if (config_.format == CSO_FORMAT_DAX) {
+        return true;
+    }
+    CSOSettingsTrailer trailer;
+    memcpy(trailer.magic, CSO_SETTINGS_MAGIC, sizeof(trailer.magic));
+    SettingsDigest(trailer.digest);
+    return output_->Seek(outputPos_) && output_->Write(&trailer, sizeof(trailer));
+}
+
+bool CSOCompressor::OpenReuse() {
+    reuse_.reset();
+    reuseSlots_.assign(CSO_BLOCK_KINDS, -1);
+    if (reuseFile_.empty()) {
+        return true;
+    }
+
+    // Un file precedente inutilizzabile non impedisce la compressione
+    auto reader = std::make_unique<CSOReader>();
+    if (!reader->Open(reuseFile_)) {
+        std::cerr << "Avviso: --reuse ignorato: " << reader->GetLastError() << std::endl;
+        return true;
+    }
+    if (reader->GetBlockSize() != blockSize_ || reader->GetUncompressedSize() != inputSize_) {
+        std::cerr << "Avviso: --reuse ignorato: dimensione o blocchi diversi in " << reuseFile_ << std::endl;
+        return true;
+    }
+    // Solo con le stesse impostazioni (codec, livelli, costi, analisi dei file e
+    // dizionario) il vecchio file ha preso per ogni blocco la decisione di adesso
+    uint8_t expected[SHA1::DIGEST_SIZE];
+    uint8_t stored[SHA1::DIGEST_SIZE];
+    SettingsDigest(expected);
+    if (!reader->ReadSettingsDigest(stored) || memcmp(stored, expected, sizeof(expected)) != 0) {
+        std::cerr << "Avviso: --reuse ignorato: " << reuseFile_ << " è stato scritto con impostazioni diverse" << std::endl;
+        return true;
+    }
+
+    // Decoder di ogni tipo di blocco: il candidato che lo scrive
+    for (int slot = 0; slot < static_cast<int>(candidates_.size()); ++slot) {
+        const CSOCandidate& candidate = candidates_[slot];
+        int kind = -1;
+        switch (candidate.codec->GetFormat()) {
+            case CODEC_FORMAT_DEFLATE:
+                kind = CSO_BLOCK_DEFLATE;
+                break;
+            case CODEC_FORMAT_LZ4:
+                kind = CSO_BLOCK_LZ4;
+                break;
+            case CODEC_FORMAT_ZSTD:
+                kind = CSO_BLOCK_ZSTD;
+                break;
+            default:
+                break;
+        }
+        if (kind >= 0 && reuseSlots_[kind] < 0) {
+            reuseSlots_[kind] = slot;
+        }
+    }
+
+    UpdateProgress("Riuso dei blocchi da " + reuseFile_);
+    reuse_ = std::move(reader);
+    return true;
+}
+
+bool CSOCompressor::LoadReuseBatch(CSOBatch& batch) {
+    for (uint32_t i = 0; i < batch.count; ++i) {
+        batch.reuse[i].size = -1;
+    }
+    if (!reuse_) {
+        return true;
+    }
+
+    // Blocchi copiabili del lotto: nel vecchio file sono consecutivi, una sola lettura
+    uint64_t spanStart = UINT64_MAX;
+    uint64_t spanEnd = 0;
+    for (uint32_t i = 0; i < batch.count; ++i) {
+        if (batch.results[i].source != -1) {
+            continue;
+        }
+        CSOBlockInfo info = reuse_->GetBlockInfo(batch.firstSector + i);
+        if (info.kind == CSO_BLOCK_RAW || reuseSlots_[info.kind] < 0 ||
+            info.size == 0 || info.size >= blockSize_) {
+            continue;
+        }
+        batch.reuse[i].size = static_cast<int>(info.size);
+        batch.reuse[i].kind = info.kind;
+        spanStart = std::min(spanStart, info.offset);
+        spanEnd = std::max(spanEnd, info.offset + info.size);
+    }
+    if (spanEnd == 0) {
+        return true;
+    }
+
+    reuseSpan_.resize(static_cast<size_t>(spanEnd - spanStart));
+    if (reuse_->ReadStored(spanStart, reuseSpan_.data(), reuseSpan_.size()) != reuseSpan_.size()) {
+        std::cerr << "Errore: lettura non riuscita da " << reuseFile_ << std::endl;
+        return false;
+    }
+    for (uint32_t i = 0; i < batch.count; ++i) {
+        if (batch.reuse[i].size > 0) {
+            CSOBlockInfo info = reuse_->GetBlockInfo(batch.firstSector + i);
+            memcpy(batch.reuseData.data() + static_cast<size_t>(i) * blockSize_,
+                   reuseSpan_.data() + (info.offset - spanStart), batch.reuse[i].size);
+        }
+    }
+    return true;
+}
+
+bool CSOCompressor::ReuseBlock(CSOWorkerContext& ctx, CSOBatch& batch, uint32_t index) {
+    const CSOReuseBlock& block = batch.reuse[index];
+    const uint8_t* stored = batch.reuseData.data() + static_cast<size_t>(index) * blockSize_;
+    const uint8_t* input = batch.input.data() + static_cast<size_t>(index) * blockSize_;
+    CodecContext* decoder = ctx.decoders[block.kind].get();
+
+    // Verifica: il blocco salvato deve decodificare esattamente nei dati attuali
+    if (!decoder || decoder->Decompress(stored, block.size, ctx.verifyBuffer.data(), blockSize_) != static_cast<int>(blockSize_) ||
+        memcmp(ctx.verifyBuffer.data(), input, blockSize_) != 0) {
+        return false;
+    }
+
+    CSOBlockResult& result = batch.results[index];
+    result.size = block.size;
+    result.slot = reuseSlots_[block.kind];
+    memcpy(batch.output.data() + static_cast<size_t>(index) * blockSize_, stored, block.size);
+    ctx.reusedBlocks++;
+    return true;
+}
+
+template <uint32_t BlockSize, bool SingleCandidate>
+int CSOCompressor::CompressBlock(CSOWorkerContext& ctx, const uint8_t* data, int& winnerSlot,
+                                 ContentClass content, bool learn) {
+    winnerSlot = -1;
+
+    // Stima economica: l'entropia di ordine 0 non vede le ripetizioni (tabelle,
+    // texture, record duplicati), quindi un blocco ad alta entropia resta non
+    // compresso solo se neanche la sonda LZ trova ripetizioni sotto il limite
+    double entropy = CodecSelector::EstimateEntropy(data, BlockSize);
+    if (entropy >= CodecSelector::INCOMPRESSIBLE_ENTROPY && ctx.probe &&
+        ctx.probe->Compress(data, BlockSize, ctx.candidateBuffer.data(), maxCompressed_) <= 0) {
+        return -1;
+    }
+    int bucket = CodecSelector::BucketFor(entropy);
+
+    // File dummy: basta il codec più veloce (slot 0). Eseguibili: tutti i candidati,
+    // perché le statistiche apprese sui dati generici non valgono per il codice.
+    // Con un solo candidato non c'è nulla da ordinare.
+    std::vector<int>& candidates = ctx.order;
+    if constexpr (SingleCandidate) {
+        candidates.assign(1, 0);
     } else {
-        return LZ4_compress_HC(reinterpret_cast<const char*>(input), 
-                             reinterpret_cast<char*>(output), 
-                             inputSize, outputSize, LZ4HC_CLEVEL_MAX);
+        candidates.clear();
+        for (int slot = 0; slot < static_cast<int>(candidates_.size()); ++slot) {
+            candidates.push_back(slot);
+        }
+        ctx.selector.Order(bucket, candidates);
+        if (content == CONTENT_PADDING && !candidates.empty()) {
+            candidates.assign(1, 0);
+        }
+    }
+    bool forceTry = (content == CONTENT_PADDING || content == CONTENT_EXECUTABLE);
+
+    // Modello di costo: ogni candidato pesa la sua dimensione per la percentuale
+    // di costo del suo formato (deflate = 100%). Il blocco non compresso parte
+    // come riferimento e un codec si interrompe appena non può più batterlo.
+    double bestCost = BlockSize * config_.origCostPercent / 100.0;
+    int bestSize = -1;
+    std::vector<int>& tried = ctx.tried;
+    tried.clear();
+
+    for (int slot : candidates) {
+        double costPercent = candidates_[slot].costPercent;
+        double maxSize = std::ceil(bestCost * 100.0 / costPercent) - 1.0;
+        // Un blocco compresso, con l'allineamento, deve restare più piccolo dell'originale
+        uint32_t limit = static_cast<uint32_t>(std::clamp(maxSize, 0.0, static_cast<double>(maxCompressed_)));
+        if (limit == 0) {
+            continue;
+        }
+        if (!forceTry && !ctx.selector.ShouldTry(bucket, slot)) {
+            continue;
+        }
+
+        int result = ctx.codecs[slot]->Compress(data, BlockSize, ctx.candidateBuffer.data(), limit);
+        if (learn) {
+            ctx.selector.RecordAttempt(bucket, slot, result <= 0);
+        }
+        tried.push_back(slot);
+
+        if (result > 0) {
+            // Il vincitore corrente stringe il limite per i codec successivi
+            bestCost = result * costPercent / 100.0;
+            bestSize = result;
+            winnerSlot = slot;
+            ctx.outputBuffer.swap(ctx.candidateBuffer);
+        }
+    }
+
+    if (learn) {
+        ctx.selector.RecordWinner(bucket, tried, winnerSlot);
     }
-    #else
-    return -1; // LZ4 non disponibile
-    #endif
+    return bestSize;
 }
 
 bool CSOCompressor::WriteHeader() {
+    if (config_.format == CSO_FORMAT_DAX) {
+        // Le aree NC si conoscono solo alla fine (WriteDAXTables)
+        DAXHeader header = {};
+        memcpy(header.magic, DAX_MAGIC, 4);
+        header.uncompressed_size = static_cast<uint32_t>(inputSize_);
+        header.version = DAX_VERSION;
+        if (!output_->Write(&header, sizeof(header))) {
+            return false;
+        }
+        outputPos_ = headerSize_;
+        return true;
+    }
+
     CSOHeader header = {};
     
     // Magic number basato sul formato
@@ -258,41 +1292,176 @@ bool CSOCompressor::WriteHeader() {
         case CSO_FORMAT_ZSO:
             memcpy(header.magic, ZSO_MAGIC, 4);
             break;
+        case CSO_FORMAT_ZCSO:
+            memcpy(header.magic, ZCSO_MAGIC, 4);
+            break;
         default:
             memcpy(header.magic, CSO_MAGIC, 4);
             break;
     }
     
-    header.header_size = sizeof(CSOHeader);
+    header.header_size = headerSize_;
     header.uncompressed_size = inputSize_;
     header.sector_size = SECTOR_SIZE;
-    header.version = (config_.format == CSO_FORMAT_CSO2) ? 2 : 1;
-    header.index_shift = SECTOR_SHIFT;
+    // ZCSO usa la stessa semantica dell'indice di CSO2
+    header.version = (config_.format == CSO_FORMAT_CSO2 || config_.format == CSO_FORMAT_ZCSO) ? 2 : 1;
+    header.index_shift = indexShift_;
+    if (config_.format == CSO_FORMAT_ZCSO) {
+        header.unused[0] = static_cast<uint8_t>(config_.zcsoCodec);
+        header.unused[1] = dictionary_.empty() ? 0 : ZCSO_FLAG_DICTIONARY;
+    }
     
     // Scrivi header
-    if (fwrite(&header, sizeof(header), 1, outputFile_) != 1) {
+    if (!output_->Write(&header, sizeof(header))) {
+        return false;
+    }
+
+    // Il dizionario segue l'header, prima dell'indice
+    if (!dictionary_.empty() &&
+        !output_->Write(dictionary_.data(), dictionary_.size())) {
         return false;
     }
     
-    outputPos_ = sizeof(header);
+    outputPos_ = headerSize_;
     return true;
 }
 
 bool CSOCompressor::WriteIndexTable() {
+    if (config_.format == CSO_FORMAT_DAX) {
+        return WriteDAXTables();
+    }
+
     // Vai all'inizio della tabella indici
-    if (fseek(outputFile_, sizeof(CSOHeader), SEEK_SET) != 0) {
+    if (!output_->Seek(headerSize_)) {
         return false;
     }
     
     // Scrivi tabella
     size_t indexCount = totalSectors_ + 1;
-    if (fwrite(indexTable_.data(), sizeof(uint32_t), indexCount, outputFile_) != indexCount) {
+    if (!output_->Write(indexTable_.data(), indexCount * sizeof(uint32_t))) {
         return false;
     }
     
     return true;
 }
 
+void CSOCompressor::SelectIndexShift() {
+    // Caso peggiore: tutti i blocchi non compressi e allineati. DAX ha offset
+    // assoluti a 32 bit, senza allineamento
+    indexShift_ = 0;
+    if (config_.format != CSO_FORMAT_DAX) {
+        for (; indexShift_ < 31; ++indexShift_) {
+            uint64_t end = AlignOffset(headerSize_ + GetIndexSize()) +
+                           static_cast<uint64_t>(totalSectors_) * AlignOffset(blockSize_);
+            if ((end >> indexShift_) <= ~CSO_INDEX_UNCOMPRESSED) {
+                break;
+            }
+        }
+    }
+    const uint32_t align = 1u << indexShift_;
+    maxCompressed_ = (align < blockSize_) ? blockSize_ - align : 0;
+}
+
+uint64_t CSOCompressor::AlignOffset(uint64_t offset) const {
+    const uint64_t mask = (1ull << indexShift_) - 1;
+    return (offset + mask) & ~mask;
+}
+
+bool CSOCompressor::PadOutput() {
+    static const uint8_t zeros[256] = {};
+    uint64_t padding = AlignOffset(outputPos_) - outputPos_;
+    while (padding > 0) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(padding, sizeof(zeros)));
+        if (!output_->Write(zeros, size)) {
+            return false;
+        }
+        outputPos_ += size;
+        padding -= size;
+    }
+    return true;
+}
+
+uint64_t CSOCompressor::GetIndexSize() const {
+    if (config_.format == CSO_FORMAT_DAX) {
+        return static_cast<uint64_t>(totalSectors_) * (sizeof(uint32_t) + sizeof(uint16_t)) +
+               static_cast<uint64_t>(ncCapacity_) * sizeof(DAXNCArea);
+    }
+    return static_cast<uint64_t>(totalSectors_ + 1) * sizeof(uint32_t);
+}
+
+bool CSOCompressor::WriteDAXTables() {
+    // Offset a 32 bit: i frame non compressi allungano l'output oltre l'input
+    if (outputPos_ > UINT32_MAX) {
+        std::cerr << "Errore: output DAX oltre 4 GB, non rappresentabile negli offset" << std::endl;
+        return false;
+    }
+
+    std::vector<uint16_t> sizes(totalSectors_);
+    std::vector<DAXNCArea> areas;
+    for (uint32_t frame = 0; frame < totalSectors_; ++frame) {
+        sizes[frame] = static_cast<uint16_t>(indexTable_[frame + 1] - indexTable_[frame]);
+        if (sizes[frame] != DAX_FRAME_SIZE) {
+            continue;
+        }
+        if (!areas.empty() && areas.back().frame + areas.back().size == frame) {
+            areas.back().size++;
+        } else {
+            areas.push_back(DAXNCArea{frame, 1});
+        }
+    }
+
+    // Header con il numero di aree, poi le tabelle: lo spazio riservato e non
+    // usato resta tra le aree NC e i dati
+    DAXHeader header = {};
+    memcpy(header.magic, DAX_MAGIC, 4);
+    header.uncompressed_size = static_cast<uint32_t>(inputSize_);
+    header.version = DAX_VERSION;
+    header.nc_areas = static_cast<uint32_t>(areas.size());
+    return output_->Seek(0) &&
+           output_->Write(&header, sizeof(header)) &&
+           output_->Write(indexTable_.data(), static_cast<size_t>(totalSectors_) * sizeof(uint32_t)) &&
+           output_->Write(sizes.data(), sizes.size() * sizeof(uint16_t)) &&
+           (areas.empty() || output_->Write(areas.data(), areas.size() * sizeof(DAXNCArea)));
+}
+
+void CSOCompressor::CountNCAreas(uint32_t committedSectors) {
+    // Ripresa: le aree dei frame già scritti occupano parte dello spazio riservato
+    ncAreas_ = 0;
+    if (config_.format != CSO_FORMAT_DAX) {
+        return;
+    }
+    bool previous = false;
+    for (uint32_t frame = 0; frame < committedSectors; ++frame) {
+        uint64_t end = (frame + 1 < committedSectors) ? indexTable_[frame + 1] : outputPos_;
+        bool stored = (end - indexTable_[frame] == DAX_FRAME_SIZE);
+        if (stored && !previous) {
+            ncAreas_++;
+        }
+        previous = stored;
+    }
+}
+
+bool CSOCompressor::WriteStoredFrame(const uint8_t* data) {
+    // Stream zlib con un solo blocco deflate non compresso (BFINAL, BTYPE 00):
+    // 0x78 0x01, intestazione del blocco, LEN/NLEN, dati e Adler-32
+    uint8_t head[7] = {0x78, 0x01, 0x01,
+                       static_cast<uint8_t>(DAX_FRAME_SIZE & 0xFF), static_cast<uint8_t>(DAX_FRAME_SIZE >> 8),
+                       static_cast<uint8_t>(~DAX_FRAME_SIZE & 0xFF), static_cast<uint8_t>((~DAX_FRAME_SIZE >> 8) & 0xFF)};
+    uint32_t a = 1, b = 0;
+    for (uint32_t i = 0; i < DAX_FRAME_SIZE; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint8_t adler[4] = {static_cast<uint8_t>(b >> 8), static_cast<uint8_t>(b),
+                        static_cast<uint8_t>(a >> 8), static_cast<uint8_t>(a)};
+    if (!output_->Write(head, sizeof(head)) || !output_->Write(data, DAX_FRAME_SIZE) ||
+        !output_->Write(adler, sizeof(adler))) {
+        return false;
+    }
+    outputPos_ += sizeof(head) + DAX_FRAME_SIZE + sizeof(adler);
+    return true;
+}
+
 void CSOCompressor::UpdateProgress(const std::string& status) {
     if (progressCallback_) {
         int progress = 0;
@@ -312,33 +1481,17 @@ uint32_t CSOCompressor::CalculateBlockSize() {
     }
 }
 
-bool CSOCompressor::ShouldCompress(const uint8_t* data, uint32_t size) {
-    // Controlla se vale la pena comprimere
-    // Salta settori che sembrano già compressi o random
-    
-    // Conta byte unici
-    bool seen[256] = {};
-    uint32_t uniqueBytes = 0;
-    
-    for (uint32_t i = 0; i < size; ++i) {
-        if (!seen[data[i]]) {
-            seen[data[i]] = true;
-            uniqueBytes++;
-        }
-    }
-    
-    // Se troppi byte unici, probabilmente già compresso
-    return uniqueBytes < 250;
+uint32_t CSOCompressor::GetBlockSize(CSOFormat format) {
+    return (format == CSO_FORMAT_DAX) ? DAX_FRAME_SIZE : SECTOR_SIZE;
 }
 
-bool CSOCompressor::IsEmptySector(const uint8_t* data, uint32_t size) {
-    // Controlla se il settore è tutto zero
-    for (uint32_t i = 0; i < size; ++i) {
-        if (data[i] != 0) {
-            return false;
-        }
+bool CSOCompressor::IsConstantBlock(const uint8_t* data, uint32_t size, uint8_t& fill) {
+    // Blocco formato da un solo valore di byte ripetuto
+    if (size == 0) {
+        return false;
     }
-    return true;
+    fill = data[0];
+    return data[size - 1] == fill && memcmp(data, data + 1, size - 1) == 0;
 }
 
 } // namespace UniversalCompressor
@@ -2,22 +2,43 @@
 #define CSO_COMPRESSOR_H
 
 #include "universal_compressor.h"
+#include "block_cache.h"
+#include "codec_arena.h"
+#include "codec_registry.h"
+#include "codec_selector.h"
+#include "disc_layout.h"
+#include "job_control.h"
+#include "journal.h"
+#include "numa_placement.h"
+#include "sha1.h"
+#include "stream_io.h"
+#include "work_queue.h"
+#include "worker_pool.h"
 #include <cstdint>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <thread>
 
 namespace UniversalCompressor {
 
+class CSOReader;
+
 // Costanti CSO (da maxcso)
 static const char* CSO_MAGIC = "CISO";
 static const char* ZSO_MAGIC = "ZISO";
+inline constexpr char ZCSO_MAGIC[] = "ZCSO";
 static const uint32_t CSO_INDEX_UNCOMPRESSED = 0x80000000;
 static const uint32_t CSO2_INDEX_LZ4 = 0x80000000;
 static const uint32_t SECTOR_SIZE = 0x800;
 static const uint32_t SECTOR_MASK = 0x7FF;
 static const uint8_t SECTOR_SHIFT = 11;
 
+// ZCSO: unused[0] = ZCSOCodec dei blocchi non-LZ4, unused[1] = flag.
+// Con ZCSO_FLAG_DICTIONARY il dizionario segue l'header fino a header_size
+// e va caricato dal decoder per tutti i blocchi compressi (anche LZ4).
+static const uint8_t ZCSO_FLAG_DICTIONARY = 0x01;
+
 // Header CSO
 #pragma pack(push, 1)
 struct CSOHeader {
@@ -29,8 +50,137 @@ struct CSOHeader {
     uint8_t index_shift;
     uint8_t unused[2];
 };
+
+// DAX: frame da 8 KB compressi con zlib (con header). Dopo l'header vengono gli
+// offset dei frame (32 bit), le loro dimensioni (16 bit) e, dalla versione 1,
+// le aree NC: sequenze di frame salvati non compressi
+struct DAXHeader {
+    char magic[4];
+    uint32_t uncompressed_size;
+    uint32_t version;
+    uint32_t nc_areas;
+    uint32_t unused[4];
+};
+
+struct DAXNCArea {
+    uint32_t frame;     // primo frame non compresso
+    uint32_t size;      // numero di frame
+};
+
+// Impronta delle impostazioni che hanno deciso i blocchi, subito dopo l'ultimo
+// blocco (non in DAX): i lettori seguono l'indice e non la vedono, --reuse
+// copia i blocchi solo da un file con la stessa impronta
+struct CSOSettingsTrailer {
+    char magic[4];
+    uint8_t digest[SHA1::DIGEST_SIZE];
+};
 #pragma pack(pop)
 
+inline constexpr char CSO_SETTINGS_MAGIC[] = "UCS1";
+
+inline constexpr char DAX_MAGIC[] = "DAX";   // con il terminatore: 4 byte
+static const uint32_t DAX_FRAME_SIZE = 0x2000;
+static const uint32_t DAX_VERSION = 1;
+
+// Aree NC riservate prima dei dati: una ogni DAX_FRAMES_PER_NC_AREA frame (il
+// numero reale si conosce solo alla fine). Esaurite, i frame non comprimibili
+// vengono scritti come blocco zlib non compresso
+static const uint32_t DAX_FRAMES_PER_NC_AREA = 16;
+
+// Blocchi letti insieme per ciascun worker in ogni lotto
+static const uint32_t CSO_BLOCKS_PER_WORKER = 256;
+
+// Blocchi di una porzione di lotto, l'unità passata ai worker: il passaggio
+// avviene una volta ogni 64 blocchi invece che per ciascun blocco
+static const uint32_t CSO_BLOCKS_PER_CHUNK = 64;
+
+// Lotti in volo: uno in lettura mentre il precedente viene compresso e scritto
+static const uint32_t CSO_BATCHES_IN_FLIGHT = 2;
+
+// Settori contigui di ogni porzione campionata da --estimate: una porzione di
+// lotto, così le sequenze di blocchi identici restano visibili
+static const uint32_t CSO_ESTIMATE_SECTORS = CSO_BLOCKS_PER_CHUNK;
+
+// Codec candidato per i blocchi, con costo e flag d'indice nel formato scelto
+struct CSOCandidate {
+    const Codec* codec;
+    CodecOptions options;
+    double costPercent;     // peso della dimensione nel modello di costo
+    uint32_t indexFlags;    // es. CSO2_INDEX_LZ4
+};
+
+// Blocco a riempimento costante già compresso (uno per valore di byte)
+struct CSOFillEntry {
+    bool ready = false;
+    int size = -1;
+    int slot = -1;
+    std::vector<uint8_t> data;
+};
+
+// Stato privato di un worker: buffer, contesti codec e statistiche di selezione
+struct CSOWorkerContext {
+    std::vector<uint8_t> outputBuffer;
+    std::vector<uint8_t> candidateBuffer;
+    std::unique_ptr<CodecArena> arena;  // stato dei codec, distrutta dopo i contesti
+    std::vector<std::unique_ptr<CodecContext>> codecs;  // uno per candidato
+    std::unique_ptr<CodecContext> probe;    // LZ veloce, prova dei blocchi ad alta entropia
+    CodecSelector selector;             // della porzione in corso, copiato dal lotto
+    std::vector<CSOFillEntry> fills;    // 256 voci, compresse al primo uso
+    std::vector<std::unique_ptr<CodecContext>> decoders;   // per CSOBlockKind, verifica di --reuse
+    std::vector<uint8_t> verifyBuffer;
+    std::vector<int> order;     // candidati nell'ordine di prova del blocco corrente
+    std::vector<int> tried;     // candidati provati sul blocco corrente
+    uint64_t layoutStored = 0;  // blocchi di file già compressi salvati senza tentativi
+    uint64_t fillBlocks = 0;    // blocchi costanti serviti dalla cache
+    uint64_t reusedBlocks = 0;  // blocchi copiati dall'output precedente
+    uint32_t node = 0;          // nodo NUMA di thread, buffer e contesti (con --numa)
+};
+
+// Sorgente di un blocco identico all'ultimo del lotto precedente
+static const int CSO_SOURCE_CARRY = -2;
+
+// Esito della compressione di un blocco del lotto
+struct CSOBlockResult {
+    int size;       // dimensione compressa, -1 = salva non compresso
+    int slot;       // indice del candidato vincitore
+    int source;     // blocco identico già compresso (indice nel lotto o CSO_SOURCE_CARRY), -1 = nessuno
+};
+
+// Blocco dell'output precedente candidato al riuso (dati in CSOBatch::reuseData)
+struct CSOReuseBlock {
+    int size;       // byte salvati, -1 = nessun candidato
+    int kind;       // CSOBlockKind
+};
+
+// Ultimo blocco del lotto precedente: le sequenze di blocchi identici proseguono oltre il lotto
+struct CSOCarryBlock {
+    std::vector<uint8_t> output;
+    CSOBlockResult result = {-1, -1, -1};
+};
+
+// Lotto letto in ordine: dati, risultati per blocco e candidati al riuso
+struct CSOBatch {
+    uint32_t firstSector = 0;
+    uint32_t count = 0;
+    uint64_t firstChunk = 0;    // numero progressivo della prima porzione
+    uint32_t chunks = 0;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    std::vector<CSOBlockResult> results;
+    std::vector<CSOReuseBlock> reuse;
+    std::vector<uint8_t> reuseData;     // dati salvati dei candidati al riuso
+    CodecSelector selector;             // stato di partenza di tutte le porzioni
+    std::vector<CodecSelector> learned; // stato a fine porzione, una voce per porzione
+};
+
+// Porzione di lotto passata ai worker e restituita allo scrittore
+struct CSOChunk {
+    CSOBatch* batch = nullptr;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    uint64_t sequence = 0;      // ordine di scrittura
+};
+
 // Classe per compressione CSO
 class CSOCompressor {
 public:
@@ -40,49 +190,201 @@ public:
     // Compressione principale
     TaskStatus Compress(const std::string& inputFile, const std::string& outputFile);
 
+    // Stima senza output (--estimate): strata porzioni dell'immagine passano
+    // per CompressChunk nei worker, il risultato viene esteso all'immagine
+    TaskStatus Estimate(const std::string& inputFile, uint32_t strata, CompressionEstimate& estimate);
+
     // Callback per progresso
     using ProgressCallback = std::function<void(int progress, const std::string& status)>;
     void SetProgressCallback(ProgressCallback callback);
 
+    // Checkpoint periodici nel journal e ripresa di un lavoro interrotto
+    void SetCheckpointOptions(uint32_t intervalSeconds, bool resume);
+
+    // Dimensione dell'input quando non è seekable (pipe su stdin)
+    void SetDeclaredInputSize(uint64_t size);
+
+    // Output precedente da cui copiare i blocchi che decodificano nei dati attuali
+    void SetReuseFile(const std::string& path);
+
+    // Cache dei blocchi compressi condivisa tra le immagini (vuota = nessuna)
+    void SetCacheDirectory(const std::string& directory);
+
+    // Annullamento e pausa (nullptr = lavoro non controllabile). Annullato,
+    // il lavoro salva un checkpoint per --resume e ritorna TASK_CANCELLED
+    void SetJobControl(JobControl* control);
+
+    // Thread e memoria condivisi tra i lavori (daemon); nullptr = propri del lavoro
+    void SetSharedPools(WorkerPool* threads, BufferPool* buffers);
+
+    // Dimensione dei blocchi del formato: settori da 2048 byte, frame da 8 KB in DAX
+    static uint32_t GetBlockSize(CSOFormat format);
+
+    // Codec candidati per la configurazione, nell'ordine di prova (anche per
+    // --auto). Le opzioni puntano a dictionary, che deve restare valido.
+    static bool BuildCandidates(const CSOConfig& config, const std::vector<uint8_t>& dictionary,
+                                std::vector<CSOCandidate>& candidates);
+
 private:
     // Configurazione
     CSOConfig config_;
     ProgressCallback progressCallback_;
 
     // Buffer e stato
-    std::vector<uint8_t> inputBuffer_;
-    std::vector<uint8_t> outputBuffer_;
+    std::vector<CSOBatch> batches_;
+    std::vector<uint8_t> reuseSpan_;
+    CSOCarryBlock carry_;
     std::vector<uint32_t> indexTable_;
+    std::vector<CSOCandidate> candidates_;
+    std::vector<CSOWorkerContext> workers_;
+
+    // Pipeline: porzioni da comprimere e porzioni completate, riordinate per la scrittura
+    WorkerGroup threads_;
+    BufferPool* buffers_;   // nullptr = buffer e arene allocati per il lavoro
+    // Con --numa una coda per nodo: le porzioni di un lotto sono divise in parti
+    // contigue per nodo e i loro buffer stanno nella memoria di quel nodo
+    std::unique_ptr<ShardedQueue<CSOChunk>> chunkQueue_;
+    std::unique_ptr<ReorderBuffer<CSOChunk>> completedChunks_;
+    uint64_t nextChunk_;
+    // Selezione dei codec appresa dai lotti già scritti, aggiornata dallo
+    // scrittore in ordine di porzione: l'output non dipende dai thread
+    CodecSelector selector_;
+    uint32_t numaNodes_;    // 1 = nessun posizionamento
+    std::vector<uint8_t> dictionary_;   // dizionario zstd condiviso dai worker
+    DiscLayout layout_;                 // file dell'immagine (vuota se non analizzata)
+
+    // --reuse: output precedente e candidato che scrive ogni CSOBlockKind (-1 = nessuno)
+    std::string reuseFile_;
+    std::unique_ptr<CSOReader> reuse_;
+    std::vector<int> reuseSlots_;
+
+    // --cache: blocchi già compressi in altre immagini con gli stessi candidati
+    std::string cacheDirectory_;
+    std::unique_ptr<BlockCache> cache_;
+
+    JobControl* control_;
+
+    // Journal di checkpoint
+    CompressionJournal journal_;
+    uint32_t checkpointInterval_;
+    bool resume_;
     
-    // File handles
-    FILE* inputFile_;
-    FILE* outputFile_;
+    // Input sequenziale e output (file o stdout tramite spool)
+    InputStream input_;
+    std::unique_ptr<OutputStream> output_;
     
+    uint64_t declaredInputSize_;
     uint64_t inputSize_;
     uint64_t outputPos_;
+    uint32_t headerSize_;   // header più eventuale dizionario ZCSO
+    uint32_t blockSize_;    // GetBlockSize(formato): i "settori" DAX sono frame da 8 KB
+    uint8_t indexShift_;    // index_shift: i blocchi iniziano a multipli di 1 << indexShift_
+    uint32_t maxCompressed_; // blocco compresso più grande che, allineato, resta sotto blockSize_
     uint32_t totalSectors_;
     uint32_t currentSector_;
+    uint64_t runBlocks_;    // blocchi che riusano il payload del precedente
+    uint32_t ncCapacity_;   // DAX: aree NC riservate
+    uint32_t ncAreas_;      // DAX: aree NC usate dai frame già scritti
 
     // Metodi interni
-    bool InitializeCompression(const std::string& inputFile, const std::string& outputFile);
+    bool InitializeCompression(const std::string& inputFile);   // l'output è aperto da OpenOutput
     void CleanupCompression();
+    TaskStatus CancelCompression(const std::string& outputFile);
+    bool FinishOutput();    // verifica la fine dell'input e completa l'output
     
-    bool ReadInputSector(uint32_t sectorIndex, uint8_t* buffer);
-    bool WriteCompressedSector(const uint8_t* data, uint32_t dataSize, uint32_t sectorIndex);
-    bool WriteUncompressedSector(const uint8_t* data, uint32_t sectorIndex);
-    
-    // Algoritmi di compressione
-    int CompressWithZlib(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize);
-    int CompressWithLZ4(const uint8_t* input, uint32_t inputSize, uint8_t* output, uint32_t outputSize);
+    bool ReadInputBatch(uint32_t firstSector, uint32_t count, uint8_t* buffer);
     
+    // Dizionario ZCSO da file (se configurato)
+    bool LoadDictionary();
+
+    // Apre l'output: da capo, o dall'ultimo checkpoint valido se richiesto
+    bool OpenOutput(const std::string& inputFile, const std::string& outputFile, JournalState& resumeState);
+    bool SaveCheckpoint(uint32_t committedSectors);
+    uint64_t LayoutFingerprint() const;
+
+    // Codec candidati dal registro, filtrati per formato e algoritmi abilitati
+    bool SetupCandidates();
+
+    // Worker paralleli: prendono le porzioni dalla coda nell'ordine in cui si
+    // liberano e le depositano nel buffer di riordino. SetupWorkers prepara
+    // solo buffer e contesti (--estimate li usa senza pipeline).
+    bool SetupWorkers();
+    bool CreateWorkers();
+    void DestroyWorkers();
+    void WorkerLoop(CSOWorkerContext& ctx);
+    void PlaceBatch(CSOBatch& batch);   // pagine di ogni porzione sul suo nodo
+    uint32_t ChunkNode(uint32_t chunk) const;
+    void DispatchBatch(CSOBatch& batch);
+    void CompressChunk(CSOWorkerContext& ctx, const CSOChunk& chunk);
+
+    // Sequenze di blocchi identici: solo il primo viene compresso, gli altri ne
+    // riscrivono il payload (il formato ricava la dimensione dall'indice successivo,
+    // quindi ogni blocco deve avere la propria copia). previous è il lotto letto prima.
+    void MarkRuns(CSOBatch& batch, const CSOBatch* previous);
+    // Scrive le porzioni del lotto man mano che arrivano in ordine; false con
+    // cancelled = lotto interrotto dall'annullamento
+    bool WriteBatch(CSOBatch& batch, bool& cancelled);
+    bool WriteBlocks(const CSOBatch& batch, uint32_t begin, uint32_t end) {
+        return (this->*writeLoop_)(batch, begin, end);
+    }
+    void UpdateCarry(const CSOBatch& batch);
+
+    // --reuse: con la stessa impronta delle impostazioni i blocchi compressi del
+    // vecchio file vengono letti in blocco e copiati se decodificano nei dati attuali
+    bool OpenReuse();
+    bool LoadReuseBatch(CSOBatch& batch);
+    bool ReuseBlock(CSOWorkerContext& ctx, CSOBatch& batch, uint32_t index);
+
+    // --cache: aperta dopo i candidati, che ne determinano la sottodirectory
+    void OpenCache();
+    std::string CacheConfiguration() const;
+
+    // Impronta scritta dopo l'ultimo blocco: configurazione della cache, analisi
+    // dei file e dizionario
+    void SettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]) const;
+    bool WriteSettingsTrailer();
+
+    // Cicli dei blocchi istanziati per ogni combinazione di dimensione del blocco,
+    // un solo candidato, analisi dei file e --cache (compressione) e per formato
+    // (scrittura): SelectBlockLoops sceglie le istanze una volta per lavoro, dopo
+    // candidati e cache, e i rami delle funzioni non attive spariscono dal ciclo
+    using ChunkLoop = void (CSOCompressor::*)(CSOWorkerContext&, const CSOChunk&);
+    using WriteLoop = bool (CSOCompressor::*)(const CSOBatch&, uint32_t, uint32_t);
+    ChunkLoop chunkLoop_;
+    WriteLoop writeLoop_;
+    void SelectBlockLoops();
+    template <uint32_t BlockSize, bool SingleCandidate, bool Layout, bool Cache>
+    void CompressChunkAs(CSOWorkerContext& ctx, const CSOChunk& chunk);
+    template <CSOFormat Format>
+    bool WriteBlocksAs(const CSOBatch& batch, uint32_t begin, uint32_t end);
+
+    // Selezione adattiva: risultato migliore in ctx.outputBuffer, -1 se non conveniente.
+    // content restringe o allarga i candidati in base al file di appartenenza;
+    // con learn = false il selettore non registra l'esito.
+    template <uint32_t BlockSize, bool SingleCandidate>
+    int CompressBlock(CSOWorkerContext& ctx, const uint8_t* data, int& winnerSlot, ContentClass content,
+                      bool learn = true);
+
     // Utilità
     bool WriteHeader();
     bool WriteIndexTable();
+    uint64_t GetIndexSize() const;  // spazio tra header e dati
+
+    // Allineamento dei blocchi: index_shift minimo perché la fine dell'output nel
+    // caso peggiore stia nei 31 bit dell'indice (0 sotto i 2 GB)
+    void SelectIndexShift();
+    uint64_t AlignOffset(uint64_t offset) const;
+    bool PadOutput();
+
+    // DAX: tabelle di offset, dimensioni e aree NC ricavate dall'indice (un frame
+    // lungo DAX_FRAME_SIZE è non compresso); CountNCAreas conta le aree già scritte
+    bool WriteDAXTables();
+    void CountNCAreas(uint32_t committedSectors);
+    bool WriteStoredFrame(const uint8_t* data);
     void UpdateProgress(const std::string& status = "");
     
     uint32_t CalculateBlockSize();
-    bool ShouldCompress(const uint8_t* data, uint32_t size);
-    bool IsEmptySector(const uint8_t* data, uint32_t size);
+    static bool IsConstantBlock(const uint8_t* data, uint32_t size, uint8_t& fill);
 };
 
 } // namespace UniversalCompressor
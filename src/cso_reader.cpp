@@ -0,0 +1,236 @@
+#include "cso_reader.h"
+#include <algorithm>
+#include <cstring>
+
+namespace UniversalCompressor {
+
+// Offset nell'indice: il bit alto è un flag (non compresso o LZ4, secondo il formato)
+static const uint32_t CSO_INDEX_OFFSET_MASK = 0x7FFFFFFF;
+
+// Blocchi più grandi non esistono in nessuna variante del formato
+static const uint32_t CSO_MAX_BLOCK_SIZE = 1u << 24;
+
+CSOReader::CSOReader()
+    : format_(CSO_FORMAT_CSO1), uncompressedSize_(0), blockSize_(0), blockCount_(0),
+      indexShift_(0), dataEnd_(0), zcsoCodec_(ZCSO_CODEC_ZSTD), deflateRaw_(false) {
+}
+
+bool CSOReader::Open(const std::string& path) {
+    Close();
+    lastError_.clear();
+
+    if (!file_.Open(path)) {
+        lastError_ = file_.GetLastError();
+        return false;
+    }
+    if (!file_.IsSeekable()) {
+        lastError_ = "Il file " + path + " deve essere seekable";
+        Close();
+        return false;
+    }
+
+    CSOHeader header;
+    if (file_.ReadAt(0, &header, sizeof(header)) != sizeof(header)) {
+        lastError_ = "File troppo corto: " + path;
+        Close();
+        return false;
+    }
+
+    if (memcmp(header.magic, CSO_MAGIC, 4) == 0) {
+        format_ = (header.version >= 2) ? CSO_FORMAT_CSO2 : CSO_FORMAT_CSO1;
+    } else if (memcmp(header.magic, ZSO_MAGIC, 4) == 0) {
+        format_ = CSO_FORMAT_ZSO;
+    } else if (memcmp(header.magic, ZCSO_MAGIC, 4) == 0) {
+        format_ = CSO_FORMAT_ZCSO;
+        zcsoCodec_ = header.unused[0];
+    } else {
+        lastError_ = "Formato non riconosciuto: " + path;
+        Close();
+        return false;
+    }
+
+    blockSize_ = header.sector_size;
+    uncompressedSize_ = header.uncompressed_size;
+    if (blockSize_ == 0 || blockSize_ > CSO_MAX_BLOCK_SIZE || header.index_shift > 31) {
+        lastError_ = "Header non valido: " + path;
+        Close();
+        return false;
+    }
+    blockCount_ = static_cast<uint32_t>((uncompressedSize_ + blockSize_ - 1) / blockSize_);
+
+    // Alcuni vecchi CSO hanno header_size 0: l'indice segue comunque l'header
+    uint32_t indexOffset = std::max<uint32_t>(header.header_size, sizeof(header));
+    if (format_ == CSO_FORMAT_ZCSO && (header.unused[1] & ZCSO_FLAG_DICTIONARY)) {
+        dictionary_.resize(indexOffset - sizeof(header));
+        if (dictionary_.empty() ||
+            file_.ReadAt(sizeof(header), dictionary_.data(), dictionary_.size()) != dictionary_.size()) {
+            lastError_ = "Dizionario ZCSO non leggibile: " + path;
+            Close();
+            return false;
+        }
+    }
+
+    index_.resize(static_cast<size_t>(blockCount_) + 1);
+    size_t indexBytes = index_.size() * sizeof(uint32_t);
+    if (file_.ReadAt(indexOffset, index_.data(), indexBytes) != indexBytes) {
+        lastError_ = "Indice incompleto: " + path;
+        Close();
+        return false;
+    }
+
+    // Le versioni precedenti di questo tool scrivevano index_shift 11 con offset
+    // non scalati: si riconoscono perché con lo scorrimento la fine dei dati
+    // cadrebbe oltre la fine del file. In quei file CSO2 aveva ancora l'indice
+    // v1 (bit alto = blocco non compresso), quindi si legge come CSO1
+    indexShift_ = header.index_shift;
+    uint64_t end = index_[blockCount_] & CSO_INDEX_OFFSET_MASK;
+    if ((end << indexShift_) > file_.GetSize() && end <= file_.GetSize()) {
+        indexShift_ = 0;
+        if (format_ == CSO_FORMAT_CSO2) {
+            format_ = CSO_FORMAT_CSO1;
+        }
+    }
+    if ((end << indexShift_) > file_.GetSize()) {
+        lastError_ = "File troncato: " + path;
+        Close();
+        return false;
+    }
+    dataEnd_ = end << indexShift_;
+
+    deflateRaw_ = (format_ == CSO_FORMAT_ZCSO) || !DetectDeflateWrapper();
+    return true;
+}
+
+void CSOReader::Close() {
+    file_.Close();
+    index_.clear();
+    dictionary_.clear();
+    blockCount_ = 0;
+    uncompressedSize_ = 0;
+}
+
+bool CSOReader::ReadSettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]) {
+    CSOSettingsTrailer trailer;
+    if (file_.ReadAt(dataEnd_, &trailer, sizeof(trailer)) != sizeof(trailer) ||
+        memcmp(trailer.magic, CSO_SETTINGS_MAGIC, sizeof(trailer.magic)) != 0) {
+        return false;
+    }
+    memcpy(digest, trailer.digest, SHA1::DIGEST_SIZE);
+    return true;
+}
+
+CSOBlockInfo CSOReader::GetBlockInfo(uint32_t block) const {
+    uint32_t entry = index_[block];
+    uint64_t start = static_cast<uint64_t>(entry & CSO_INDEX_OFFSET_MASK) << indexShift_;
+    uint64_t end = static_cast<uint64_t>(index_[block + 1] & CSO_INDEX_OFFSET_MASK) << indexShift_;
+
+    CSOBlockInfo info;
+    info.offset = start;
+    info.size = (end > start) ? static_cast<uint32_t>(end - start) : 0;
+
+    bool flag = (entry & ~CSO_INDEX_OFFSET_MASK) != 0;
+    switch (format_) {
+        case CSO_FORMAT_CSO1:
+            info.kind = flag ? CSO_BLOCK_RAW : CSO_BLOCK_DEFLATE;
+            break;
+        case CSO_FORMAT_ZSO:
+            info.kind = flag ? CSO_BLOCK_RAW : CSO_BLOCK_LZ4;
+            break;
+        default:
+            // CSO2 e ZCSO: flag = LZ4, i blocchi non compressi si riconoscono dalla dimensione
+            if (flag) {
+                info.kind = CSO_BLOCK_LZ4;
+            } else if (info.size >= blockSize_) {
+                info.kind = CSO_BLOCK_RAW;
+            } else if (format_ == CSO_FORMAT_ZCSO && zcsoCodec_ == ZCSO_CODEC_ZSTD) {
+                info.kind = CSO_BLOCK_ZSTD;
+            } else {
+                info.kind = CSO_BLOCK_DEFLATE;
+            }
+            break;
+    }
+    return info;
+}
+
+size_t CSOReader::ReadStored(uint64_t offset, void* buffer, size_t size) {
+    return file_.ReadAt(offset, buffer, size);
+}
+
+std::unique_ptr<CodecContext> CSOReader::CreateDecoder(CSOBlockKind kind) const {
+    CodecFormat format;
+    uint32_t required = CODEC_CAP_DECOMPRESS;
+    CodecOptions options;
+    switch (kind) {
+        case CSO_BLOCK_DEFLATE:
+            format = CODEC_FORMAT_DEFLATE;
+            options.rawDeflate = deflateRaw_;
+            if (deflateRaw_) {
+                required |= CODEC_CAP_RAW_DEFLATE;
+            }
+            break;
+        case CSO_BLOCK_LZ4:
+            format = CODEC_FORMAT_LZ4;
+            break;
+        case CSO_BLOCK_ZSTD:
+            format = CODEC_FORMAT_ZSTD;
+            break;
+        default:
+            return nullptr;
+    }
+    options.blockSizeHint = blockSize_;
+
+    // Con un dizionario serve un codec che lo sappia caricare
+    if (!dictionary_.empty()) {
+        options.dictionary = dictionary_.data();
+        options.dictionarySize = static_cast<uint32_t>(dictionary_.size());
+        required |= CODEC_CAP_DICTIONARY;
+    }
+
+    for (const Codec* codec : CodecRegistry::Instance().GetCodecs(format)) {
+        if (codec->HasCapability(required)) {
+            return codec->CreateContext(options);
+        }
+    }
+    return nullptr;
+}
+
+bool CSOReader::DetectDeflateWrapper() {
+    // Il primo blocco deflate dice se il file usa il wrapper zlib (versioni
+    // precedenti di questo tool) o deflate raw: CMF con metodo 8 e finestra
+    // <= 32 KB, (CMF * 256 + FLG) multiplo di 31. Anche uno stream raw può
+    // iniziare così: l'header va confermato decodificando il blocco
+    for (uint32_t block = 0; block < blockCount_; ++block) {
+        CSOBlockInfo info = GetBlockInfo(block);
+        if (info.kind != CSO_BLOCK_DEFLATE) {
+            continue;
+        }
+        std::vector<uint8_t> stored(info.size);
+        if (info.size < 2 || ReadStored(info.offset, stored.data(), stored.size()) != stored.size()) {
+            return false;
+        }
+        if ((stored[0] & 0x0F) != 8 || (stored[0] >> 4) > 7 || ((stored[0] << 8) | stored[1]) % 31 != 0) {
+            return false;
+        }
+
+        CodecOptions options;
+        options.blockSizeHint = blockSize_;
+        if (!dictionary_.empty()) {
+            options.dictionary = dictionary_.data();
+            options.dictionarySize = static_cast<uint32_t>(dictionary_.size());
+        }
+        std::vector<uint8_t> output(blockSize_);
+        for (const Codec* codec : CodecRegistry::Instance().GetCodecs(CODEC_FORMAT_DEFLATE)) {
+            if (!codec->HasCapability(CODEC_CAP_DECOMPRESS)) {
+                continue;
+            }
+            auto decoder = codec->CreateContext(options);
+            return decoder && decoder->Decompress(stored.data(), info.size, output.data(), blockSize_) ==
+                                  static_cast<int>(blockSize_);
+        }
+        // Nessun decoder in questa build: vale l'header
+        return true;
+    }
+    return false;
+}
+
+} // namespace UniversalCompressor
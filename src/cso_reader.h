@@ -0,0 +1,79 @@
+#ifndef CSO_READER_H
+#define CSO_READER_H
+
+#include "cso_compressor.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Codifica di un blocco salvato in un file CSO, ZSO o ZCSO
+enum CSOBlockKind {
+    CSO_BLOCK_RAW = 0,      // non compresso
+    CSO_BLOCK_DEFLATE,      // deflate (wrapper zlib o raw, vedi IsDeflateRaw)
+    CSO_BLOCK_LZ4,
+    CSO_BLOCK_ZSTD,
+    CSO_BLOCK_KINDS
+};
+
+// Posizione e codifica di un blocco nel file
+struct CSOBlockInfo {
+    CSOBlockKind kind;
+    uint64_t offset;
+    uint32_t size;          // byte salvati, compreso l'eventuale allineamento
+};
+
+// Lettore di file CSO1/CSO2, ZSO e ZCSO: header, indice e byte salvati dei blocchi.
+// Usato da --reuse per copiare i blocchi di un output precedente e come
+// sorgente della transcodifica CSO -> CHD/CSO.
+class CSOReader {
+public:
+    CSOReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const std::string& GetLastError() const { return lastError_; }
+    CSOFormat GetFormat() const { return format_; }
+    uint64_t GetUncompressedSize() const { return uncompressedSize_; }
+    uint32_t GetBlockSize() const { return blockSize_; }
+    uint32_t GetBlockCount() const { return blockCount_; }
+    const std::vector<uint8_t>& GetDictionary() const { return dictionary_; }
+
+    // Deflate senza header zlib (ZCSO) o con wrapper zlib
+    bool IsDeflateRaw() const { return deflateRaw_; }
+
+    CSOBlockInfo GetBlockInfo(uint32_t block) const;
+
+    // Impronta delle impostazioni dopo l'ultimo blocco (false nei file che non l'hanno)
+    bool ReadSettingsDigest(uint8_t digest[SHA1::DIGEST_SIZE]);
+
+    // Byte salvati così come sono nel file, senza decomprimerli
+    size_t ReadStored(uint64_t offset, void* buffer, size_t size);
+
+    // Contesto in grado di decodificare i blocchi del tipo indicato
+    // (nullptr se il codec non è presente in questa build)
+    std::unique_ptr<CodecContext> CreateDecoder(CSOBlockKind kind) const;
+
+private:
+    bool DetectDeflateWrapper();
+
+    InputStream file_;
+    std::string lastError_;
+    CSOFormat format_;
+    uint64_t uncompressedSize_;
+    uint32_t blockSize_;
+    uint32_t blockCount_;
+    uint8_t indexShift_;
+    uint64_t dataEnd_;      // fine dell'ultimo blocco
+    uint32_t zcsoCodec_;
+    bool deflateRaw_;
+    std::vector<uint32_t> index_;
+    std::vector<uint8_t> dictionary_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // CSO_READER_H
@@ -0,0 +1,944 @@
+#include "daemon.h"
+#include "journal.h"
+#include "stream_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// macOS non ha MSG_NOSIGNAL: SIGPIPE è comunque ignorato in Run()
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace UniversalCompressor {
+
+// Una richiesta più lunga non è un comando valido: la connessione viene chiusa
+static const size_t DAEMON_MAX_REQUEST = 1024 * 1024;
+
+// Righe in attesa per un client che non legge: oltre, la connessione viene chiusa
+static const size_t DAEMON_MAX_OUTGOING = 1024 * 1024;
+
+// Alla chiusura della connessione si attende il client al più per questo tempo
+// per consegnare le righe ancora in coda (es. gli eventi dello shutdown)
+static const int DAEMON_FLUSH_TIMEOUT_MS = 1000;
+
+// Valore JSON: quanto basta per le richieste del protocollo
+struct JsonValue {
+    enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+    Type type = JSON_NULL;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> fields;
+
+    const JsonValue* Get(const std::string& key) const {
+        auto it = fields.find(key);
+        return (it != fields.end()) ? &it->second : nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text_(text), pos_(0) {}
+
+    bool Parse(JsonValue& value) {
+        if (!ParseValue(value, 0)) {
+            return false;
+        }
+        SkipSpace();
+        return pos_ == text_.size();
+    }
+
+private:
+    static const int MAX_DEPTH = 32;
+
+    void SkipSpace() {
+        while (pos_ < text_.size() &&
+               (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r' || text_[pos_] == '\n')) {
+            ++pos_;
+        }
+    }
+
+    bool Match(const char* word) {
+        size_t length = strlen(word);
+        if (text_.compare(pos_, length, word) != 0) {
+            return false;
+        }
+        pos_ += length;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& value, int depth) {
+        SkipSpace();
+        if (pos_ >= text_.size() || depth > MAX_DEPTH) {
+            return false;
+        }
+        char c = text_[pos_];
+        if (c == '{') {
+            value.type = JsonValue::JSON_OBJECT;
+            ++pos_;
+            SkipSpace();
+            if (pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            while (true) {
+                std::string key;
+                SkipSpace();
+                if (!ParseString(key)) {
+                    return false;
+                }
+                SkipSpace();
+                if (pos_ >= text_.size() || text_[pos_++] != ':') {
+                    return false;
+                }
+                if (!ParseValue(value.fields[key], depth + 1)) {
+                    return false;
+                }
+                SkipSpace();
+                if (pos_ >= text_.size()) {
+                    return false;
+                }
+                char next = text_[pos_++];
+                if (next == '}') {
+                    return true;
+                }
+                if (next != ',') {
+                    return false;
+                }
+            }
+        }
+        if (c == '[') {
+            value.type = JsonValue::JSON_ARRAY;
+            ++pos_;
+            SkipSpace();
+            if (pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+            while (true) {
+                value.items.emplace_back();
+                if (!ParseValue(value.items.back(), depth + 1)) {
+                    return false;
+                }
+                SkipSpace();
+                if (pos_ >= text_.size()) {
+                    return false;
+                }
+                char next = text_[pos_++];
+                if (next == ']') {
+                    return true;
+                }
+                if (next != ',') {
+                    return false;
+                }
+            }
+        }
+        if (c == '"') {
+            value.type = JsonValue::JSON_STRING;
+            return ParseString(value.text);
+        }
+        if (Match("true")) {
+            value.type = JsonValue::JSON_BOOL;
+            value.boolean = true;
+            return true;
+        }
+        if (Match("false")) {
+            value.type = JsonValue::JSON_BOOL;
+            return true;
+        }
+        if (Match("null")) {
+            value.type = JsonValue::JSON_NULL;
+            return true;
+        }
+
+        // Numero: strtod accetta un sovrainsieme della sintassi JSON
+        const char* start = text_.c_str() + pos_;
+        char* end = nullptr;
+        value.number = strtod(start, &end);
+        if (end == start) {
+            return false;
+        }
+        value.type = JsonValue::JSON_NUMBER;
+        pos_ += end - start;
+        return true;
+    }
+
+    bool ParseHex(uint32_t& code) {
+        if (pos_ + 4 > text_.size()) {
+            return false;
+        }
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = text_[pos_++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool ParseString(std::string& out) {
+        if (pos_ >= text_.size() || text_[pos_] != '"') {
+            return false;
+        }
+        ++pos_;
+        while (pos_ < text_.size()) {
+            char c = text_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= text_.size()) {
+                return false;
+            }
+            char escape = text_[pos_++];
+            switch (escape) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t code;
+                    if (!ParseHex(code)) {
+                        return false;
+                    }
+                    // Coppia surrogata: carattere fuori dal piano base
+                    if (code >= 0xD800 && code <= 0xDBFF) {
+                        uint32_t low;
+                        if (!Match("\\u") || !ParseHex(low) || low < 0xDC00 || low > 0xDFFF) {
+                            return false;
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(out, code);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    static void AppendUtf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    const std::string& text_;
+    size_t pos_;
+};
+
+// Stringa JSON tra virgolette (i byte UTF-8 passano invariati)
+static std::string JsonQuote(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+                break;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string JsonError(const std::string& message) {
+    return "{\"ok\":false,\"error\":" + JsonQuote(message) + "}";
+}
+
+static const char* JobStateName(DaemonJobState state) {
+    switch (state) {
+        case JOB_QUEUED: return "queued";
+        case JOB_RUNNING: return "running";
+        case JOB_COMPLETED: return "completed";
+        case JOB_FAILED: return "failed";
+        case JOB_CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+static uint64_t GetJobId(const JsonValue& request) {
+    const JsonValue* id = request.Get("job");
+    return (id && id->type == JsonValue::JSON_NUMBER && id->number >= 1) ? static_cast<uint64_t>(id->number) : 0;
+}
+
+static std::mutex g_logMutex;
+
+static void DaemonLog(const std::string& message) {
+    std::lock_guard<std::mutex> lock(g_logMutex);
+    std::cout << message << std::endl;
+}
+
+CompressionDaemon::CompressionDaemon(const DaemonConfig& config, DaemonJobParser parser)
+    : config_(config), parser_(std::move(parser)), listenFd_(-1), stopping_(false),
+      nextJobId_(1), activeClients_(0) {
+    config_.jobs = std::max(1u, config_.jobs);
+}
+
+CompressionDaemon::~CompressionDaemon() {
+}
+
+std::string CompressionDaemon::HandleRequest(const std::string& line, Client& client) {
+    JsonValue request;
+    if (!JsonParser(line).Parse(request) || request.type != JsonValue::JSON_OBJECT) {
+        return JsonError("Richiesta JSON non valida");
+    }
+    const JsonValue* command = request.Get("cmd");
+    std::string cmd = (command && command->type == JsonValue::JSON_STRING) ? command->text : "";
+
+    if (cmd == "submit") {
+        const JsonValue* input = request.Get("input");
+        const JsonValue* output = request.Get("output");
+        const JsonValue* args = request.Get("args");
+        if (!input || input->type != JsonValue::JSON_STRING || input->text.empty()) {
+            return JsonError("Campo input mancante");
+        }
+        if (output && output->type != JsonValue::JSON_STRING) {
+            return JsonError("Campo output non valido");
+        }
+        std::vector<std::string> options;
+        if (args) {
+            if (args->type != JsonValue::JSON_ARRAY) {
+                return JsonError("Campo args non valido");
+            }
+            for (const JsonValue& item : args->items) {
+                if (item.type != JsonValue::JSON_STRING) {
+                    return JsonError("Campo args non valido");
+                }
+                options.push_back(item.text);
+            }
+        }
+        return Submit(input->text, output ? output->text : "", options);
+    }
+
+    if (cmd == "status") {
+        uint64_t id = GetJobId(request);
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        if (id) {
+            auto it = jobs_.find(id);
+            if (it == jobs_.end()) {
+                return JsonError("Lavoro sconosciuto");
+            }
+            return "{\"ok\":true," + DescribeJob(it->second).substr(1);
+        }
+        std::string list;
+        for (const auto& entry : jobs_) {
+            list += (list.empty() ? "" : ",") + DescribeJob(entry.second);
+        }
+        return "{\"ok\":true,\"jobs\":[" + list + "]}";
+    }
+
+    if (cmd == "cancel") {
+        return Cancel(GetJobId(request));
+    }
+
+    if (cmd == "pause" || cmd == "resume") {
+        return SetPaused(GetJobId(request), cmd == "pause");
+    }
+
+    if (cmd == "watch") {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        client.watching = true;
+        client.watchJob = GetJobId(request);
+        return "{\"ok\":true}";
+    }
+
+    if (cmd == "shutdown") {
+        // Coda e lavori in esecuzione annullati (questi ultimi con un checkpoint)
+        stopping_ = true;
+#ifndef _WIN32
+        ::shutdown(listenFd_, SHUT_RDWR);
+#endif
+        return "{\"ok\":true}";
+    }
+
+    return JsonError("Comando sconosciuto: " + cmd);
+}
+
+std::string CompressionDaemon::Submit(const std::string& input, const std::string& output,
+                                      const std::vector<std::string>& args) {
+    if (stopping_) {
+        return JsonError("Il daemon è in chiusura");
+    }
+
+    // Le opzioni vengono interpretate come dalla CLI, con l'input come unico file
+    std::vector<std::string> options = args;
+    options.push_back(input);
+    DaemonJob job;
+    std::string error;
+    if (!parser_(options, job, error)) {
+        return JsonError(error);
+    }
+    if (!output.empty()) {
+        job.outputFile = output;
+    }
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        id = nextJobId_++;
+        Job& entry = jobs_[id];
+        entry.id = id;
+        entry.job = job;
+        queue_.push_back(id);
+    }
+    jobsReady_.notify_one();
+    DaemonLog("Lavoro " + std::to_string(id) + " in coda: " + job.inputFile + " -> " + job.outputFile);
+    return "{\"ok\":true,\"job\":" + std::to_string(id) + "}";
+}
+
+std::string CompressionDaemon::Cancel(uint64_t id) {
+    std::string event;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        auto it = jobs_.find(id);
+        if (it == jobs_.end()) {
+            return JsonError("Lavoro sconosciuto");
+        }
+        Job& job = it->second;
+        if (job.state == JOB_RUNNING) {
+            // L'engine si ferma al prossimo blocco e salva un checkpoint
+            job.cancelRequested = true;
+            if (job.compressor) {
+                job.compressor->Cancel();
+            }
+            return "{\"ok\":true}";
+        }
+        if (job.state != JOB_QUEUED) {
+            return JsonError("Il lavoro è già terminato");
+        }
+        queue_.erase(std::find(queue_.begin(), queue_.end(), id));
+        job.state = JOB_CANCELLED;
+        event = "{\"event\":\"done\"," + DescribeJob(job).substr(1);
+    }
+    Broadcast(id, event);
+    DaemonLog("Lavoro " + std::to_string(id) + " annullato");
+    return "{\"ok\":true}";
+}
+
+std::string CompressionDaemon::SetPaused(uint64_t id, bool paused) {
+    std::string event;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        auto it = jobs_.find(id);
+        if (it == jobs_.end()) {
+            return JsonError("Lavoro sconosciuto");
+        }
+        Job& job = it->second;
+        if (job.state != JOB_QUEUED && job.state != JOB_RUNNING) {
+            return JsonError("Il lavoro è già terminato");
+        }
+        if (job.paused == paused) {
+            return "{\"ok\":true}";
+        }
+        // Un lavoro in coda messo in pausa parte già sospeso
+        job.paused = paused;
+        if (job.compressor) {
+            if (paused) {
+                job.compressor->GetJobControl().Pause();
+            } else {
+                job.compressor->GetJobControl().Resume();
+            }
+        }
+        event = "{\"event\":\"progress\"," + DescribeJob(job).substr(1);
+    }
+    Broadcast(id, event);
+    DaemonLog("Lavoro " + std::to_string(id) + (paused ? " in pausa" : " ripreso"));
+    return "{\"ok\":true}";
+}
+
+std::string CompressionDaemon::DescribeJob(const Job& job) const {
+    std::string out = "{\"job\":" + std::to_string(job.id) +
+                      ",\"state\":\"" + JobStateName(job.state) + "\"" +
+                      ",\"input\":" + JsonQuote(job.job.inputFile) +
+                      ",\"output\":" + JsonQuote(job.job.outputFile) +
+                      ",\"progress\":" + std::to_string(job.progress) +
+                      ",\"message\":" + JsonQuote(job.message);
+    if (job.paused && (job.state == JOB_QUEUED || job.state == JOB_RUNNING)) {
+        out += ",\"paused\":true";
+    }
+    if (job.state == JOB_COMPLETED) {
+        out += ",\"output_size\":" + std::to_string(job.outputSize);
+    }
+    if (!job.error.empty()) {
+        out += ",\"error\":" + JsonQuote(job.error);
+    }
+    return out + "}";
+}
+
+void CompressionDaemon::Broadcast(uint64_t id, const std::string& event) {
+    std::vector<std::shared_ptr<Client>> targets;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        for (const auto& client : clients_) {
+            if (client->watching && (client->watchJob == 0 || client->watchJob == id)) {
+                targets.push_back(client);
+            }
+        }
+    }
+    for (const auto& client : targets) {
+        QueueLine(*client, event);
+    }
+}
+
+void CompressionDaemon::RunJobs() {
+    std::unique_lock<std::mutex> lock(jobsMutex_);
+    while (true) {
+        jobsReady_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        uint64_t id = queue_.front();
+        queue_.pop_front();
+        Job& job = jobs_[id];     // i nodi della map restano validi
+        job.state = JOB_RUNNING;
+        std::string event = "{\"event\":\"progress\"," + DescribeJob(job).substr(1);
+        lock.unlock();
+
+        Broadcast(id, event);
+        ExecuteJob(job);
+
+        lock.lock();
+    }
+}
+
+void CompressionDaemon::ExecuteJob(Job& job) {
+    const DaemonJob& task = job.job;
+    DaemonLog("Lavoro " + std::to_string(job.id) + " avviato");
+
+    UniversalCompressor compressor;
+    compressor.SetCSOConfig(task.csoConfig);
+    compressor.SetCHDConfig(task.chdConfig);
+    compressor.SetGeneralConfig(task.generalConfig);
+    compressor.SetSharedPools(&workers_, &buffers_);
+
+    // Si inoltrano solo i cambiamenti: l'engine aggiorna a ogni lotto
+    compressor.SetProgressCallback([this, &job](int current, int total, const std::string& status) {
+        int progress = (total > 0) ? static_cast<int>(static_cast<int64_t>(current) * 100 / total) : 0;
+        std::string event;
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex_);
+            if (progress == job.progress && status == job.message) {
+                return;
+            }
+            job.progress = progress;
+            job.message = status;
+            event = "{\"event\":\"progress\"," + DescribeJob(job).substr(1);
+        }
+        Broadcast(job.id, event);
+        if (config_.verbose) {
+            DaemonLog("Lavoro " + std::to_string(job.id) + " [" + std::to_string(progress) + "%] " + status);
+        }
+    });
+    compressor.SetErrorCallback([this, &job](const std::string& error) {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        job.error = error;
+    });
+
+    // Da qui cancel, pause e resume agiscono sull'engine
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        job.compressor = &compressor;
+        if (job.paused) {
+            compressor.GetJobControl().Pause();
+        }
+        if (job.cancelRequested) {
+            compressor.Cancel();
+        }
+    }
+
+    TaskStatus result = compressor.CompressFile(task.inputFile, task.outputFile, task.type);
+
+    std::string event;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        job.compressor = nullptr;
+        if (result == TASK_SUCCESS) {
+            job.state = JOB_COMPLETED;
+            job.outputSize = Utils::GetFileSize(task.outputFile);
+        } else {
+            job.state = (result == TASK_CANCELLED) ? JOB_CANCELLED : JOB_FAILED;
+            if (job.error.empty() && result != TASK_CANCELLED) {
+                job.error = "Compressione non riuscita";
+            }
+        }
+        if (result == TASK_CANCELLED) {
+            // Come la CLI: l'output parziale resta solo se --resume può usarlo
+            if (Utils::FileExists(CompressionJournal::PathFor(task.outputFile))) {
+                job.message = "Annullato: riprendibile con --resume";
+            } else if (!task.generalConfig.keepIncomplete) {
+                std::error_code ignored;
+                std::filesystem::remove(task.outputFile, ignored);
+            }
+        }
+        event = "{\"event\":\"done\"," + DescribeJob(job).substr(1);
+    }
+    Broadcast(job.id, event);
+    DaemonLog("Lavoro " + std::to_string(job.id) + " " + JobStateName(job.state));
+    if (config_.verbose) {
+        DaemonLog("Pool: " + std::to_string(workers_.GetThreadCount()) + " thread, " +
+                  Utils::FormatBytes(buffers_.GetRetainedBytes()) + " di buffer e arene");
+    }
+}
+
+#ifndef _WIN32
+
+// Il gestore dei segnali chiude il socket in ascolto: accept() ritorna e Run() termina
+static volatile sig_atomic_t g_daemonListenFd = -1;
+
+static void DaemonSignalHandler(int) {
+    if (g_daemonListenFd >= 0) {
+        ::shutdown(g_daemonListenFd, SHUT_RDWR);
+    }
+}
+
+int CompressionDaemon::Run() {
+    if (!Listen()) {
+        return 1;
+    }
+
+    g_daemonListenFd = listenFd_;
+    struct sigaction action = {};
+    action.sa_handler = DaemonSignalHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    DaemonLog("Daemon in ascolto su " + config_.socketPath + " (" + std::to_string(config_.jobs) +
+              " lavori contemporanei)");
+    for (uint32_t i = 0; i < config_.jobs; ++i) {
+        runners_.emplace_back(&CompressionDaemon::RunJobs, this);
+    }
+
+    AcceptLoop();
+
+    // Chiusura: annulla la coda e i lavori in esecuzione, attende gli esecutori, poi i client
+    std::vector<std::pair<uint64_t, std::string>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex_);
+        stopping_ = true;
+        for (uint64_t id : queue_) {
+            Job& job = jobs_[id];
+            job.state = JOB_CANCELLED;
+            cancelled.emplace_back(id, "{\"event\":\"done\"," + DescribeJob(job).substr(1));
+        }
+        queue_.clear();
+        for (auto& entry : jobs_) {
+            if (entry.second.state == JOB_RUNNING) {
+                entry.second.cancelRequested = true;
+                if (entry.second.compressor) {
+                    entry.second.compressor->Cancel();
+                }
+            }
+        }
+    }
+    jobsReady_.notify_all();
+    for (const auto& event : cancelled) {
+        Broadcast(event.first, event.second);
+    }
+    DaemonLog("Daemon in chiusura: interruzione dei lavori in esecuzione");
+    for (auto& runner : runners_) {
+        runner.join();
+    }
+    runners_.clear();
+
+    {
+        std::unique_lock<std::mutex> lock(clientsMutex_);
+        for (const auto& client : clients_) {
+            ::shutdown(client->fd, SHUT_RD);
+        }
+        clientsDone_.wait(lock, [this] { return activeClients_ == 0; });
+    }
+
+    g_daemonListenFd = -1;
+    close(listenFd_);
+    listenFd_ = -1;
+    unlink(config_.socketPath.c_str());
+    DaemonLog("Daemon terminato");
+    return 0;
+}
+
+bool CompressionDaemon::Listen() {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (config_.socketPath.empty() || config_.socketPath.size() >= sizeof(address.sun_path)) {
+        lastError_ = "Percorso del socket non valido: " + config_.socketPath;
+        return false;
+    }
+    memcpy(address.sun_path, config_.socketPath.c_str(), config_.socketPath.size());
+
+    // Un socket rimasto da un daemon terminato male si rimuove solo se nessuno risponde
+    struct stat info;
+    if (stat(config_.socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            lastError_ = "Il percorso esiste e non è un socket: " + config_.socketPath;
+            return false;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = probe >= 0 &&
+                     connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (alive) {
+            lastError_ = "Un daemon è già in ascolto su " + config_.socketPath;
+            return false;
+        }
+        unlink(config_.socketPath.c_str());
+    }
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd_ < 0) {
+        lastError_ = std::string("Impossibile creare il socket: ") + strerror(errno);
+        return false;
+    }
+
+    // Solo l'utente che avvia il daemon può inviargli lavori
+    mode_t previousMask = umask(0077);
+    int bound = bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(previousMask);
+    if (bound != 0 || listen(listenFd_, 16) != 0) {
+        lastError_ = "Impossibile ascoltare su " + config_.socketPath + ": " + strerror(errno);
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+void CompressionDaemon::AcceptLoop() {
+    while (!stopping_) {
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) {
+            if ((errno == EINTR || errno == ECONNABORTED) && !stopping_) {
+                continue;
+            }
+            break;      // socket chiuso da shutdown o da un segnale
+        }
+
+        auto client = std::make_shared<Client>();
+        client->fd = fd;
+        if (pipe(client->wakeFds) != 0) {
+            close(fd);
+            continue;
+        }
+        fcntl(client->wakeFds[0], F_SETFL, O_NONBLOCK);
+        fcntl(client->wakeFds[1], F_SETFL, O_NONBLOCK);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            clients_.push_back(client);
+            ++activeClients_;
+        }
+        std::thread(&CompressionDaemon::ServeClient, this, client).detach();
+    }
+}
+
+void CompressionDaemon::ServeClient(std::shared_ptr<Client> client) {
+    std::string pending;
+    char buffer[4096];
+    bool reading = true;
+    bool overflow = false;
+    while (reading) {
+        // Richieste in arrivo, righe accodate da altri thread (pipe) e, con
+        // righe in coda, spazio libero nel socket
+        pollfd fds[2] = {};
+        fds[0].fd = client->fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = client->wakeFds[0];
+        fds[1].events = POLLIN;
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            overflow = client->overflow;
+            if (!client->outgoing.empty()) {
+                fds[0].events |= POLLOUT;
+            }
+        }
+        if (overflow) {
+            DaemonLog("Client disconnesso: oltre " + Utils::FormatBytes(DAEMON_MAX_OUTGOING) + " non letti");
+            break;
+        }
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(client->wakeFds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if ((fds[0].revents & POLLOUT) && !FlushClient(*client)) {
+            break;
+        }
+        if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+
+        ssize_t received = recv(client->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        pending.append(buffer, static_cast<size_t>(received));
+
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                QueueLine(*client, HandleRequest(line, *client));
+            }
+        }
+        if (pending.size() > DAEMON_MAX_REQUEST) {
+            QueueLine(*client, JsonError("Richiesta troppo lunga"));
+            reading = false;
+        }
+    }
+
+    // Righe ancora in coda, come gli eventi dello shutdown: consegnate finché
+    // il client le legge
+    while (!overflow) {
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            if (client->outgoing.empty() || client->overflow) {
+                break;
+            }
+        }
+        pollfd out = {};
+        out.fd = client->fd;
+        out.events = POLLOUT;
+        if (poll(&out, 1, DAEMON_FLUSH_TIMEOUT_MS) <= 0 || !FlushClient(*client)) {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    clients_.erase(std::find(clients_.begin(), clients_.end(), client));
+    {
+        std::lock_guard<std::mutex> clientLock(client->mutex);
+        close(client->fd);
+        close(client->wakeFds[0]);
+        close(client->wakeFds[1]);
+        client->fd = -1;
+        client->wakeFds[0] = client->wakeFds[1] = -1;
+        client->outgoing.clear();
+    }
+    --activeClients_;
+    clientsDone_.notify_all();
+}
+
+bool CompressionDaemon::QueueLine(Client& client, const std::string& line) {
+    std::lock_guard<std::mutex> lock(client.mutex);
+    if (client.fd < 0 || client.overflow) {
+        return false;
+    }
+    if (client.outgoingBytes + line.size() + 1 > DAEMON_MAX_OUTGOING) {
+        // Il client non legge: niente altre righe, la connessione si chiude
+        client.overflow = true;
+    } else {
+        client.outgoing.push_back(line + "\n");
+        client.outgoingBytes += line.size() + 1;
+    }
+
+    // Pipe piena: il thread della connessione ha già una sveglia in attesa
+    char wake = 0;
+    ssize_t ignored = write(client.wakeFds[1], &wake, 1);
+    (void)ignored;
+    return !client.overflow;
+}
+
+bool CompressionDaemon::FlushClient(Client& client) {
+    std::lock_guard<std::mutex> lock(client.mutex);
+    while (!client.outgoing.empty()) {
+        const std::string& line = client.outgoing.front();
+        ssize_t written = send(client.fd, line.data() + client.sentBytes, line.size() - client.sentBytes,
+                               MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        client.sentBytes += static_cast<size_t>(written);
+        if (client.sentBytes == line.size()) {
+            client.outgoingBytes -= line.size();
+            client.sentBytes = 0;
+            client.outgoing.pop_front();
+        }
+    }
+    return true;
+}
+
+#else
+
+// Windows: i socket Unix richiedono Winsock (afunix.h), non ancora supportato
+int CompressionDaemon::Run() {
+    lastError_ = "La modalità daemon non è disponibile su Windows";
+    return 1;
+}
+
+bool CompressionDaemon::QueueLine(Client&, const std::string&) {
+    return false;
+}
+
+#endif
+
+} // namespace UniversalCompressor
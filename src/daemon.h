@@ -0,0 +1,139 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "universal_compressor.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Lavoro inviato al daemon: opzioni già interpretate come dalla CLI
+struct DaemonJob {
+    std::string inputFile;
+    std::string outputFile;
+    CompressionType type = COMPRESSION_CSO;
+    CSOConfig csoConfig;
+    CHDConfig chdConfig;
+    GeneralConfig generalConfig;
+};
+
+// Interpreta le opzioni CLI di un submit (fornita da main.cpp)
+using DaemonJobParser = std::function<bool(const std::vector<std::string>& args, DaemonJob& job,
+                                           std::string& error)>;
+
+struct DaemonConfig {
+    std::string socketPath;
+    uint32_t jobs = 1;          // lavori eseguiti contemporaneamente
+    bool verbose = false;
+};
+
+// Stato di un lavoro in coda
+enum DaemonJobState {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_COMPLETED,
+    JOB_FAILED,
+    JOB_CANCELLED
+};
+
+// Daemon su socket Unix: i client inviano una richiesta JSON per riga
+// (submit, status, cancel, pause, resume, watch, shutdown) e ricevono una risposta JSON per
+// riga; con watch la connessione riceve anche gli eventi di avanzamento.
+// I lavori di tutti i client condividono una coda e un numero fisso di
+// esecutori nello stesso processo; i motori CSO e CHD di ogni lavoro usano i
+// thread e i buffer del daemon invece di crearne di propri.
+class CompressionDaemon {
+public:
+    CompressionDaemon(const DaemonConfig& config, DaemonJobParser parser);
+    ~CompressionDaemon();
+
+    // Ascolta sul socket fino a shutdown o SIGINT/SIGTERM; 0 = uscita regolare
+    int Run();
+
+    const std::string& GetLastError() const { return lastError_; }
+
+private:
+    struct Job {
+        uint64_t id = 0;
+        DaemonJob job;
+        DaemonJobState state = JOB_QUEUED;
+        int progress = 0;
+        std::string message;
+        std::string error;
+        uint64_t outputSize = 0;
+        bool paused = false;
+        bool cancelRequested = false;
+        UniversalCompressor* compressor = nullptr;     // solo durante l'esecuzione
+    };
+
+    // Le righe per il client passano da una coda limitata che solo il thread
+    // della connessione svuota: esecutori e worker non attendono mai il socket
+    struct Client {
+        int fd = -1;
+        int wakeFds[2] = {-1, -1};  // pipe che sveglia il thread della connessione
+        std::mutex mutex;           // protegge fd, wakeFds e la coda in uscita
+        std::deque<std::string> outgoing;   // righe complete di '\n'
+        size_t outgoingBytes = 0;
+        size_t sentBytes = 0;       // byte già inviati della prima riga
+        bool overflow = false;      // coda piena: la connessione viene chiusa
+        bool watching = false;
+        uint64_t watchJob = 0;      // 0 = tutti i lavori
+    };
+
+    bool Listen();
+    void AcceptLoop();
+    void ServeClient(std::shared_ptr<Client> client);
+    std::string HandleRequest(const std::string& line, Client& client);
+    void RunJobs();
+    void ExecuteJob(Job& job);
+
+    std::string Submit(const std::string& input, const std::string& output,
+                       const std::vector<std::string>& args);
+    std::string Cancel(uint64_t id);
+    std::string SetPaused(uint64_t id, bool paused);
+    std::string DescribeJob(const Job& job) const;
+
+    // Accoda un evento ai client in watch sul lavoro
+    void Broadcast(uint64_t id, const std::string& event);
+
+    // Accoda una riga senza bloccare; false se il client è chiuso o in overflow
+    static bool QueueLine(Client& client, const std::string& line);
+    // Invia quanto il socket accetta senza bloccare; false su errore
+    static bool FlushClient(Client& client);
+
+    DaemonConfig config_;
+    DaemonJobParser parser_;
+    std::string lastError_;
+    int listenFd_;
+    std::atomic<bool> stopping_;
+
+    std::mutex jobsMutex_;          // protegge jobs_, queue_ e lo stato dei lavori
+    std::condition_variable jobsReady_;
+    std::map<uint64_t, Job> jobs_;
+    std::deque<uint64_t> queue_;
+    uint64_t nextJobId_;
+
+    std::mutex clientsMutex_;
+    std::vector<std::shared_ptr<Client>> clients_;
+    int activeClients_;             // thread dei client ancora attivi
+    std::condition_variable clientsDone_;
+    std::vector<std::thread> runners_;
+
+    // Worker e memoria dei motori, riusati da tutti i lavori
+    BufferPool buffers_;
+    WorkerPool workers_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // DAEMON_H
@@ -0,0 +1,174 @@
+#include "dictionary_trainer.h"
+#include "codec_selector.h"
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#ifdef HAVE_ZSTD
+#include <zdict.h>
+#endif
+
+namespace UniversalCompressor {
+
+// Segmenti usati dalla selezione senza libzstd: passo di mezzo segmento
+// per tollerare strutture non allineate (es. record di directory)
+static const uint32_t SEGMENT_SIZE = 64;
+static const uint32_t SEGMENT_STEP = SEGMENT_SIZE / 2;
+
+DictionaryTrainer::DictionaryTrainer(const DictionaryConfig& config)
+    : config_(config) {
+    if (config_.blockSize == 0) {
+        config_.blockSize = 2048;
+    }
+}
+
+bool DictionaryTrainer::AddSamples(const std::string& inputFile) {
+    FILE* file = fopen(inputFile.c_str(), "rb");
+    if (!file) {
+        lastError_ = "Impossibile aprire file: " + inputFile;
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    uint64_t fileSize = ftell(file);
+
+    const uint32_t blockSize = config_.blockSize;
+    const uint64_t totalBlocks = fileSize / blockSize;
+    const uint64_t stride = std::max<uint64_t>(1, totalBlocks / std::max<uint32_t>(config_.samplesPerFile, 1));
+
+    std::vector<uint8_t> block(blockSize);
+    uint32_t taken = 0;
+    for (uint64_t i = 0; i < totalBlocks && taken < config_.samplesPerFile; i += stride) {
+        if (fseek(file, i * blockSize, SEEK_SET) != 0 ||
+            fread(block.data(), 1, blockSize, file) != blockSize) {
+            break;
+        }
+
+        // Blocchi di riempimento e dati già compressi non insegnano nulla al dizionario
+        if (std::all_of(block.begin(), block.end(), [&](uint8_t b) { return b == block[0]; })) {
+            continue;
+        }
+        if (CodecSelector::EstimateEntropy(block.data(), blockSize) >= CodecSelector::INCOMPRESSIBLE_ENTROPY) {
+            continue;
+        }
+
+        samples_.insert(samples_.end(), block.begin(), block.end());
+        sampleSizes_.push_back(blockSize);
+        taken++;
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool DictionaryTrainer::Train(std::vector<uint8_t>& dictionary) {
+    dictionary.clear();
+    if (sampleSizes_.empty()) {
+        lastError_ = "Nessun blocco utilizzabile per l'addestramento";
+        return false;
+    }
+
+    uint32_t dictSize = config_.size;
+    if (dictSize == 0) {
+        dictSize = (config_.type == DICTIONARY_ZSTD) ? DICTIONARY_ZSTD_DEFAULT_SIZE : DICTIONARY_RAW_DEFAULT_SIZE;
+    }
+
+    if (config_.type == DICTIONARY_ZSTD) {
+        return TrainZstd(dictSize, dictionary);
+    }
+    return TrainRaw(dictSize, dictionary);
+}
+
+bool DictionaryTrainer::TrainZstd(uint32_t dictSize, std::vector<uint8_t>& dictionary) {
+#ifdef HAVE_ZSTD
+    dictionary.resize(dictSize);
+    size_t result = ZDICT_trainFromBuffer(dictionary.data(), dictSize, samples_.data(),
+                                          sampleSizes_.data(), static_cast<unsigned>(sampleSizes_.size()));
+    if (ZDICT_isError(result)) {
+        lastError_ = std::string("Addestramento zstd fallito: ") + ZDICT_getErrorName(result);
+        dictionary.clear();
+        return false;
+    }
+    dictionary.resize(result);
+    return true;
+#else
+    (void)dictSize;
+    (void)dictionary;
+    lastError_ = "Dizionari zstd non disponibili in questa build";
+    return false;
+#endif
+}
+
+bool DictionaryTrainer::TrainRaw(uint32_t dictSize, std::vector<uint8_t>& dictionary) {
+#ifdef HAVE_ZSTD
+    // Il contenuto di un dizionario zstd è già ordinato con i segmenti migliori
+    // in fondo, cioè più vicini ai dati: basta togliere l'header entropico
+    std::vector<uint8_t> trained;
+    if (TrainZstd(dictSize + 4096, trained)) {
+        size_t headerSize = ZDICT_getDictHeaderSize(trained.data(), trained.size());
+        if (!ZDICT_isError(headerSize) && headerSize < trained.size()) {
+            size_t contentSize = std::min<size_t>(trained.size() - headerSize, dictSize);
+            dictionary.assign(trained.end() - contentSize, trained.end());
+            return true;
+        }
+    }
+    lastError_.clear();
+#endif
+    SelectFrequentSegments(dictSize, dictionary);
+    if (dictionary.empty()) {
+        lastError_ = "Nessun contenuto ricorrente nei blocchi campionati";
+        return false;
+    }
+    return true;
+}
+
+void DictionaryTrainer::SelectFrequentSegments(uint32_t dictSize, std::vector<uint8_t>& dictionary) {
+    struct SegmentInfo {
+        uint32_t count;         // campioni distinti in cui compare
+        size_t offset;          // prima occorrenza in samples_
+        size_t lastSample;
+    };
+    std::unordered_map<uint64_t, SegmentInfo> segments;
+
+    size_t sampleStart = 0;
+    for (size_t s = 0; s < sampleSizes_.size(); ++s) {
+        for (size_t pos = 0; pos + SEGMENT_SIZE <= sampleSizes_[s]; pos += SEGMENT_STEP) {
+            // FNV-1a sul segmento
+            uint64_t hash = 1469598103934665603ULL;
+            const uint8_t* data = samples_.data() + sampleStart + pos;
+            for (uint32_t i = 0; i < SEGMENT_SIZE; ++i) {
+                hash = (hash ^ data[i]) * 1099511628211ULL;
+            }
+
+            auto it = segments.find(hash);
+            if (it == segments.end()) {
+                segments.emplace(hash, SegmentInfo{1, sampleStart + pos, s});
+            } else if (it->second.lastSample != s) {
+                it->second.count++;
+                it->second.lastSample = s;
+            }
+        }
+        sampleStart += sampleSizes_[s];
+    }
+
+    // Solo i segmenti presenti in più campioni, i più frequenti per primi
+    std::vector<SegmentInfo> ranked;
+    for (const auto& entry : segments) {
+        if (entry.second.count >= 2) {
+            ranked.push_back(entry.second);
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const SegmentInfo& a, const SegmentInfo& b) {
+        return a.count != b.count ? a.count > b.count : a.offset < b.offset;
+    });
+    ranked.resize(std::min<size_t>(ranked.size(), dictSize / SEGMENT_SIZE));
+
+    // I segmenti più frequenti vanno in fondo: distanze minori nel match finder
+    dictionary.clear();
+    for (auto it = ranked.rbegin(); it != ranked.rend(); ++it) {
+        const uint8_t* data = samples_.data() + it->offset;
+        dictionary.insert(dictionary.end(), data, data + SEGMENT_SIZE);
+    }
+}
+
+} // namespace UniversalCompressor
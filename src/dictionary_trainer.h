@@ -0,0 +1,47 @@
+#ifndef DICTIONARY_TRAINER_H
+#define DICTIONARY_TRAINER_H
+
+#include "universal_compressor.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Dimensioni di default dei dizionari
+static const uint32_t DICTIONARY_ZSTD_DEFAULT_SIZE = 64 * 1024;
+static const uint32_t DICTIONARY_RAW_DEFAULT_SIZE = 32 * 1024;   // finestra deflate
+
+// Addestramento di dizionari condivisi per blocchi piccoli.
+// Con settori da 2 KB ogni blocco parte da una finestra vuota: un dizionario
+// costruito dalle strutture ricorrenti delle immagini (record di directory
+// ISO9660, header di file, tabelle) recupera gran parte del rapporto perso.
+class DictionaryTrainer {
+public:
+    explicit DictionaryTrainer(const DictionaryConfig& config);
+
+    // Campiona blocchi a intervalli regolari, scartando quelli vuoti o incomprimibili
+    bool AddSamples(const std::string& inputFile);
+
+    // Costruisce il dizionario dai campioni raccolti
+    bool Train(std::vector<uint8_t>& dictionary);
+
+    size_t GetSampleCount() const { return sampleSizes_.size(); }
+    const std::string& GetLastError() const { return lastError_; }
+
+private:
+    bool TrainZstd(uint32_t dictSize, std::vector<uint8_t>& dictionary);
+    bool TrainRaw(uint32_t dictSize, std::vector<uint8_t>& dictionary);
+
+    // Selezione dei segmenti più ricorrenti nei campioni (senza libzstd)
+    void SelectFrequentSegments(uint32_t dictSize, std::vector<uint8_t>& dictionary);
+
+    DictionaryConfig config_;
+    std::vector<uint8_t> samples_;
+    std::vector<size_t> sampleSizes_;
+    std::string lastError_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // DICTIONARY_TRAINER_H
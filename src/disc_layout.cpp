@@ -0,0 +1,470 @@
+#include "disc_layout.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace UniversalCompressor {
+
+static const uint32_t LOGICAL_SECTOR_SIZE = 2048;
+static const uint32_t RAW_SECTOR_SIZE = 2352;
+static const uint32_t VOLUME_DESCRIPTOR_START = 16;
+static const uint32_t UDF_ANCHOR_SECTOR = 256;
+
+// Limiti contro immagini corrotte o costruite ad arte
+static const uint32_t MAX_DIRECTORY_DEPTH = 64;
+static const uint32_t MAX_FILES = 1000000;
+static const uint64_t MAX_DIRECTORY_SIZE = 16 * 1024 * 1024;
+
+// Formati già compressi: tentare la compressione costa CPU senza guadagno
+static const char* const COMPRESSED_EXTENSIONS[] = {
+    // Video
+    "pmf", "mps", "pss", "str", "sfd", "usm", "bik", "bk2", "m2v", "mp4", "wmv", "thp",
+    // Audio
+    "at3", "at9", "xa", "vag", "adx", "hca", "mp3", "ogg", "wma", "aac",
+    // Archivi e immagini
+    "cpk", "zip", "gz", "7z", "rar", "cab", "lzh", "jpg", "jpeg", "png",
+};
+
+static const char* const EXECUTABLE_EXTENSIONS[] = {
+    "elf", "prx", "sprx", "irx", "self", "exe", "dll", "xex",
+};
+
+static const char* const PADDING_EXTENSIONS[] = {
+    "dmy", "dum", "pad",
+};
+
+static inline uint16_t ReadLE16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t ReadLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+template <size_t N>
+static bool InList(const std::string& value, const char* const (&list)[N]) {
+    return std::any_of(std::begin(list), std::end(list), [&](const char* item) { return value == item; });
+}
+
+DiscLayout::DiscLayout() {
+    Clear();
+}
+
+void DiscLayout::Clear() {
+    input_ = nullptr;
+    imageSectorSize_ = LOGICAL_SECTOR_SIZE;
+    dataOffset_ = 0;
+    sectorLimit_ = 0;
+    filesystem_ = DISC_FS_NONE;
+    extents_.clear();
+    visitedDirs_.clear();
+    fileCount_ = 0;
+    std::fill(std::begin(classBytes_), std::end(classBytes_), 0);
+}
+
+bool DiscLayout::Analyze(InputStream& input) {
+    Clear();
+    if (!input.IsSeekable()) {
+        return false;
+    }
+    input_ = &input;
+
+    bool found = false;
+    if (DetectSectorFormat()) {
+        // Descrittori di volume fino al terminatore: il primario ISO9660 ha la precedenza
+        std::vector<uint8_t> sector(LOGICAL_SECTOR_SIZE);
+        bool udf = false;
+        for (uint32_t lba = VOLUME_DESCRIPTOR_START; lba < VOLUME_DESCRIPTOR_START + 64; ++lba) {
+            if (!ReadSector(lba, sector.data())) {
+                break;
+            }
+            const char* id = reinterpret_cast<const char*>(sector.data() + 1);
+            // La sequenza UDF (BEA01 ... TEA01) segue il terminatore ISO9660 nei dischi bridge
+            if (memcmp(id, "CD001", 5) == 0) {
+                AddExtent(lba, LOGICAL_SECTOR_SIZE, CONTENT_SYSTEM);
+                if (sector[0] == 1 && !found) {
+                    found = WalkISO9660(sector.data());
+                }
+            } else if (memcmp(id, "NSR02", 5) == 0 || memcmp(id, "NSR03", 5) == 0) {
+                udf = true;
+            } else if (memcmp(id, "BEA01", 5) != 0 && memcmp(id, "TEA01", 5) != 0 &&
+                       memcmp(id, "BOOT2", 5) != 0 && memcmp(id, "CDW02", 5) != 0) {
+                break;
+            }
+        }
+        if (!found && udf) {
+            extents_.clear();
+            fileCount_ = 0;
+            found = WalkUDF();
+        }
+    }
+
+    if (!found) {
+        Clear();
+        return false;
+    }
+    Finalize();
+    input_ = nullptr;
+    return true;
+}
+
+bool DiscLayout::DetectSectorFormat() {
+    uint64_t size = input_->GetSize();
+    uint8_t header[16];
+
+    // Immagine ISO: descrittore di volume direttamente a 16 * 2048
+    imageSectorSize_ = LOGICAL_SECTOR_SIZE;
+    dataOffset_ = 0;
+    sectorLimit_ = size / LOGICAL_SECTOR_SIZE;
+    if (input_->ReadAt(VOLUME_DESCRIPTOR_START * LOGICAL_SECTOR_SIZE, header, 6) == 6 &&
+        (memcmp(header + 1, "CD001", 5) == 0 || memcmp(header + 1, "BEA01", 5) == 0)) {
+        return true;
+    }
+
+    // CD raw: sync di 12 byte, mode nel byte 15 (mode 2 ha 8 byte di subheader)
+    static const uint8_t SYNC[12] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+    if (input_->ReadAt(static_cast<uint64_t>(VOLUME_DESCRIPTOR_START) * RAW_SECTOR_SIZE, header, 16) != 16 ||
+        memcmp(header, SYNC, sizeof(SYNC)) != 0 || (header[15] != 1 && header[15] != 2)) {
+        return false;
+    }
+    imageSectorSize_ = RAW_SECTOR_SIZE;
+    dataOffset_ = (header[15] == 1) ? 16 : 24;
+    sectorLimit_ = size / RAW_SECTOR_SIZE;
+    return true;
+}
+
+bool DiscLayout::ReadSector(uint32_t lba, uint8_t* buffer) {
+    if (lba >= sectorLimit_) {
+        return false;
+    }
+    uint64_t offset = static_cast<uint64_t>(lba) * imageSectorSize_ + dataOffset_;
+    return input_->ReadAt(offset, buffer, LOGICAL_SECTOR_SIZE) == LOGICAL_SECTOR_SIZE;
+}
+
+bool DiscLayout::WalkISO9660(const uint8_t* pvd) {
+    if (ReadLE16(pvd + 128) != LOGICAL_SECTOR_SIZE) {
+        return false;
+    }
+    filesystem_ = DISC_FS_ISO9660;
+
+    struct PendingDir {
+        uint32_t lba;
+        uint32_t size;
+        uint32_t depth;
+    };
+    // Record della directory radice nel descrittore primario
+    const uint8_t* root = pvd + 156;
+    std::vector<PendingDir> pending = {{ReadLE32(root + 2), ReadLE32(root + 10), 0}};
+    std::vector<uint8_t> sector(LOGICAL_SECTOR_SIZE);
+
+    while (!pending.empty()) {
+        PendingDir dir = pending.back();
+        pending.pop_back();
+        if (dir.depth > MAX_DIRECTORY_DEPTH ||
+            std::find(visitedDirs_.begin(), visitedDirs_.end(), dir.lba) != visitedDirs_.end()) {
+            continue;
+        }
+        visitedDirs_.push_back(dir.lba);
+        AddExtent(dir.lba, dir.size, CONTENT_SYSTEM);
+
+        uint32_t sectors = (dir.size + LOGICAL_SECTOR_SIZE - 1) / LOGICAL_SECTOR_SIZE;
+        for (uint32_t s = 0; s < sectors; ++s) {
+            if (!ReadSector(dir.lba + s, sector.data())) {
+                return !extents_.empty();
+            }
+
+            // I record non attraversano i confini di settore: lunghezza 0 = fine settore
+            for (uint32_t pos = 0; pos + 34 <= LOGICAL_SECTOR_SIZE; ) {
+                const uint8_t* record = sector.data() + pos;
+                uint8_t length = record[0];
+                if (length < 34 || pos + length > LOGICAL_SECTOR_SIZE) {
+                    break;
+                }
+                pos += length;
+
+                uint8_t nameLength = record[32];
+                if (33u + nameLength > length) {
+                    continue;
+                }
+                // Voci "." e ".."
+                if (nameLength == 1 && (record[33] == 0 || record[33] == 1)) {
+                    continue;
+                }
+
+                uint32_t extent = ReadLE32(record + 2);
+                uint32_t size = ReadLE32(record + 10);
+                if (record[25] & 0x02) {
+                    pending.push_back({extent, size, dir.depth + 1});
+                    continue;
+                }
+
+                if (++fileCount_ > MAX_FILES) {
+                    return true;
+                }
+                // Nome senza versione (";1"); i file multi-extent hanno un record per extent
+                std::string name(reinterpret_cast<const char*>(record + 33), nameLength);
+                name = name.substr(0, name.find(';'));
+                AddExtent(extent, size, ClassifyName(name));
+            }
+        }
+    }
+    return true;
+}
+
+bool DiscLayout::WalkUDF() {
+    std::vector<uint8_t> sector(LOGICAL_SECTOR_SIZE);
+
+    // Anchor Volume Descriptor Pointer: posizione della sequenza principale
+    if (!ReadSector(UDF_ANCHOR_SECTOR, sector.data()) || ReadLE16(sector.data()) != 2) {
+        return false;
+    }
+    uint32_t sequenceLength = ReadLE32(sector.data() + 16) / LOGICAL_SECTOR_SIZE;
+    uint32_t sequenceStart = ReadLE32(sector.data() + 20);
+
+    // Partition Descriptor (inizio della partizione) e Logical Volume Descriptor (File Set)
+    uint32_t partitionStart = 0;
+    uint32_t fileSetBlock = 0;
+    bool havePartition = false;
+    bool haveVolume = false;
+    for (uint32_t i = 0; i < std::min<uint32_t>(sequenceLength, 64); ++i) {
+        if (!ReadSector(sequenceStart + i, sector.data())) {
+            return false;
+        }
+        uint16_t tag = ReadLE16(sector.data());
+        if (tag == 5) {
+            partitionStart = ReadLE32(sector.data() + 188);
+            havePartition = true;
+        } else if (tag == 6) {
+            if (ReadLE32(sector.data() + 212) != LOGICAL_SECTOR_SIZE) {
+                return false;
+            }
+            fileSetBlock = ReadLE32(sector.data() + 252);
+            haveVolume = true;
+        } else if (tag == 8) {
+            break;
+        }
+    }
+    if (!havePartition || !haveVolume) {
+        return false;
+    }
+
+    // File Set Descriptor: ICB della directory radice
+    if (!ReadSector(partitionStart + fileSetBlock, sector.data()) || ReadLE16(sector.data()) != 256) {
+        return false;
+    }
+    filesystem_ = DISC_FS_UDF;
+    return ReadUDFFileEntry(partitionStart, ReadLE32(sector.data() + 404), true, std::string(), 0);
+}
+
+bool DiscLayout::ReadUDFFileEntry(uint32_t partitionStart, uint32_t block, bool isDirectory,
+                                  const std::string& name, uint32_t depth) {
+    if (depth > MAX_DIRECTORY_DEPTH || fileCount_ > MAX_FILES) {
+        return true;
+    }
+    if (isDirectory) {
+        if (std::find(visitedDirs_.begin(), visitedDirs_.end(), partitionStart + block) != visitedDirs_.end()) {
+            return true;
+        }
+        visitedDirs_.push_back(partitionStart + block);
+    }
+
+    std::vector<uint8_t> entry(LOGICAL_SECTOR_SIZE);
+    if (!ReadSector(partitionStart + block, entry.data())) {
+        return false;
+    }
+    AddExtent(partitionStart + block, LOGICAL_SECTOR_SIZE, CONTENT_SYSTEM);
+
+    // File Entry (261) o Extended File Entry (266): differiscono per la posizione dei descrittori
+    uint16_t tag = ReadLE16(entry.data());
+    uint32_t adOffset;
+    uint32_t eaLength;
+    uint32_t adLength;
+    if (tag == 261) {
+        eaLength = ReadLE32(entry.data() + 168);
+        adLength = ReadLE32(entry.data() + 172);
+        adOffset = 176;
+    } else if (tag == 266) {
+        eaLength = ReadLE32(entry.data() + 208);
+        adLength = ReadLE32(entry.data() + 212);
+        adOffset = 216;
+    } else {
+        return false;
+    }
+    adOffset += eaLength;
+    if (adOffset + adLength > LOGICAL_SECTOR_SIZE) {
+        return false;
+    }
+
+    // Tipo di allocation descriptor nei 3 bit bassi dei flag dell'ICB tag
+    uint16_t allocationType = ReadLE16(entry.data() + 34) & 0x07;
+    uint32_t adSize = (allocationType == 0) ? 8 : (allocationType == 1) ? 16 : 0;
+    if (adSize == 0) {
+        return true; // dati incorporati nell'entry o extended_ad: nessun extent da mappare
+    }
+
+    ContentClass content = isDirectory ? CONTENT_SYSTEM : ClassifyName(name);
+    std::vector<uint8_t> directory;
+    for (uint32_t pos = adOffset; pos + adSize <= adOffset + adLength; pos += adSize) {
+        uint32_t length = ReadLE32(entry.data() + pos);
+        uint32_t position = ReadLE32(entry.data() + pos + 4);
+        // Bit alti della lunghezza: 0 = extent registrato e allocato
+        if ((length >> 30) != 0 || (length & 0x3FFFFFFF) == 0) {
+            continue;
+        }
+        length &= 0x3FFFFFFF;
+        AddExtent(partitionStart + position, length, content);
+
+        if (isDirectory && directory.size() + length <= MAX_DIRECTORY_SIZE) {
+            size_t start = directory.size();
+            directory.resize(start + ((length + LOGICAL_SECTOR_SIZE - 1) / LOGICAL_SECTOR_SIZE) * LOGICAL_SECTOR_SIZE);
+            for (uint32_t s = 0; start + s * LOGICAL_SECTOR_SIZE < directory.size(); ++s) {
+                if (!ReadSector(partitionStart + position + s, directory.data() + start + s * LOGICAL_SECTOR_SIZE)) {
+                    return false;
+                }
+            }
+            directory.resize(start + length);
+        }
+    }
+    if (!isDirectory) {
+        fileCount_++;
+        return true;
+    }
+
+    // File Identifier Descriptor: caratteristiche, nome (OSTA CS0) e ICB della voce
+    for (size_t pos = 0; pos + 38 <= directory.size(); ) {
+        const uint8_t* fid = directory.data() + pos;
+        if (ReadLE16(fid) != 257) {
+            break;
+        }
+        uint8_t characteristics = fid[18];
+        uint8_t nameLength = fid[19];
+        uint32_t icbBlock = ReadLE32(fid + 24);
+        uint16_t implLength = ReadLE16(fid + 36);
+        size_t recordLength = (38u + implLength + nameLength + 3) & ~static_cast<size_t>(3);
+        if (pos + 38 + implLength + nameLength > directory.size()) {
+            break;
+        }
+
+        // Voci cancellate e riferimento alla directory padre
+        if (!(characteristics & 0x0C)) {
+            const uint8_t* id = fid + 38 + implLength;
+            std::string childName;
+            if (nameLength > 0) {
+                uint32_t step = (id[0] == 16) ? 2 : 1;
+                for (uint32_t i = 1 + (step - 1); i < nameLength; i += step) {
+                    childName.push_back(static_cast<char>(id[i]));
+                }
+            }
+            if (!ReadUDFFileEntry(partitionStart, icbBlock, (characteristics & 0x02) != 0, childName, depth + 1)) {
+                return !extents_.empty();
+            }
+        }
+        pos += recordLength;
+    }
+    return true;
+}
+
+void DiscLayout::AddExtent(uint32_t firstSector, uint64_t size, ContentClass content) {
+    if (size == 0 || firstSector >= sectorLimit_) {
+        return;
+    }
+    uint64_t sectors = (size + LOGICAL_SECTOR_SIZE - 1) / LOGICAL_SECTOR_SIZE;
+    sectors = std::min<uint64_t>(sectors, sectorLimit_ - firstSector);
+    extents_.push_back({firstSector, static_cast<uint32_t>(sectors), content});
+    classBytes_[content] += size;
+}
+
+void DiscLayout::Finalize() {
+    // Ordina e risolvi le sovrapposizioni (hard link, extent condivisi): vince il primo
+    std::stable_sort(extents_.begin(), extents_.end(), [](const Extent& a, const Extent& b) {
+        return a.firstSector < b.firstSector;
+    });
+    std::vector<Extent> merged;
+    merged.reserve(extents_.size());
+    for (const Extent& extent : extents_) {
+        uint64_t end = static_cast<uint64_t>(extent.firstSector) + extent.sectorCount;
+        if (!merged.empty()) {
+            const Extent& last = merged.back();
+            uint64_t lastEnd = static_cast<uint64_t>(last.firstSector) + last.sectorCount;
+            if (end <= lastEnd) {
+                continue;
+            }
+            if (extent.firstSector < lastEnd) {
+                merged.push_back({static_cast<uint32_t>(lastEnd), static_cast<uint32_t>(end - lastEnd), extent.content});
+                continue;
+            }
+        }
+        merged.push_back(extent);
+    }
+    extents_.swap(merged);
+}
+
+ContentClass DiscLayout::ClassifyRange(uint64_t offset, uint64_t size) const {
+    if (extents_.empty() || size == 0) {
+        return CONTENT_UNKNOWN;
+    }
+    uint64_t first = offset / imageSectorSize_;
+    uint64_t last = (offset + size - 1) / imageSectorSize_;
+
+    auto it = std::upper_bound(extents_.begin(), extents_.end(), first, [](uint64_t sector, const Extent& extent) {
+        return sector < extent.firstSector;
+    });
+    if (it == extents_.begin()) {
+        return CONTENT_UNKNOWN;
+    }
+    --it;
+    if (last >= static_cast<uint64_t>(it->firstSector) + it->sectorCount) {
+        // Intervallo su più extent: è uniforme solo se tutti sono contigui e della stessa classe
+        ContentClass content = it->content;
+        uint64_t covered = static_cast<uint64_t>(it->firstSector) + it->sectorCount;
+        for (++it; it != extents_.end() && covered <= last; ++it) {
+            if (it->firstSector != covered || it->content != content) {
+                return CONTENT_UNKNOWN;
+            }
+            covered += it->sectorCount;
+        }
+        return (covered > last) ? content : CONTENT_UNKNOWN;
+    }
+    return it->content;
+}
+
+ContentClass DiscLayout::ClassifyName(const std::string& name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    while (!lower.empty() && lower.back() == '.') {
+        lower.pop_back();
+    }
+
+    size_t dot = lower.rfind('.');
+    std::string stem = (dot == std::string::npos) ? lower : lower.substr(0, dot);
+    std::string extension = (dot == std::string::npos) ? std::string() : lower.substr(dot + 1);
+
+    if (stem.find("dummy") != std::string::npos || stem == "padding" || InList(extension, PADDING_EXTENSIONS)) {
+        return CONTENT_PADDING;
+    }
+    if (InList(extension, COMPRESSED_EXTENSIONS)) {
+        return CONTENT_COMPRESSED;
+    }
+    if (InList(extension, EXECUTABLE_EXTENSIONS) || lower == "eboot.bin" || lower == "boot.bin") {
+        return CONTENT_EXECUTABLE;
+    }
+    // Eseguibile di boot PS1/PS2: SLUS_123.45, SCES_012.34, ...
+    if (lower.size() == 11 && lower[4] == '_' && lower[8] == '.' &&
+        std::all_of(lower.begin(), lower.begin() + 4, [](unsigned char c) { return std::isalpha(c); }) &&
+        std::isdigit(static_cast<unsigned char>(lower[5]))) {
+        return CONTENT_EXECUTABLE;
+    }
+    return CONTENT_UNKNOWN;
+}
+
+std::string DiscLayout::Summary() const {
+    const char* fs = (filesystem_ == DISC_FS_UDF) ? "UDF" : "ISO9660";
+    auto mb = [](uint64_t bytes) { return std::to_string(bytes / (1024 * 1024)) + " MB"; };
+    return std::string(fs) + ", " + std::to_string(fileCount_) + " file: " +
+           mb(classBytes_[CONTENT_COMPRESSED]) + " già compressi, " +
+           mb(classBytes_[CONTENT_PADDING]) + " riempimento, " +
+           mb(classBytes_[CONTENT_EXECUTABLE]) + " eseguibili";
+}
+
+} // namespace UniversalCompressor
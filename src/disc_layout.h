@@ -0,0 +1,84 @@
+#ifndef DISC_LAYOUT_H
+#define DISC_LAYOUT_H
+
+#include "stream_io.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Classe del contenuto di un intervallo di settori, dedotta dal filesystem
+enum ContentClass : uint8_t {
+    CONTENT_UNKNOWN = 0,        // nessuna informazione: decidono le statistiche dei byte
+    CONTENT_SYSTEM,             // descrittori di volume e directory
+    CONTENT_COMPRESSED,         // video, audio e archivi già compressi
+    CONTENT_PADDING,            // file dummy di riempimento
+    CONTENT_EXECUTABLE          // eseguibili e moduli
+};
+
+// Filesystem riconosciuto nell'immagine
+enum DiscFilesystem {
+    DISC_FS_NONE = 0,
+    DISC_FS_ISO9660,
+    DISC_FS_UDF
+};
+
+// Mappa settori -> file dell'immagine. Percorre le directory ISO9660 (o UDF
+// se manca il descrittore ISO9660) e classifica ogni file dal nome, così gli
+// engine possono saltare o semplificare la compressione senza tentativi.
+// Supporta immagini a settori da 2048 byte e CD raw da 2352 (mode 1 e mode 2).
+class DiscLayout {
+public:
+    DiscLayout();
+
+    // Legge i metadati del filesystem; l'input deve essere seekable.
+    // false se non c'è un filesystem riconosciuto (la mappa resta vuota).
+    bool Analyze(InputStream& input);
+    void Clear();
+
+    // Classe dell'intervallo di byte dell'immagine: quella del file che lo
+    // contiene per intero, CONTENT_UNKNOWN se attraversa più file o zone libere
+    ContentClass ClassifyRange(uint64_t offset, uint64_t size) const;
+
+    // Classe di un nome di file (estensione e nomi noti)
+    static ContentClass ClassifyName(const std::string& name);
+
+    bool IsEmpty() const { return extents_.empty(); }
+    bool HasRawSectors() const { return imageSectorSize_ != 2048; }   // CD raw: sync, header ed ECC
+    DiscFilesystem GetFilesystem() const { return filesystem_; }
+    std::string Summary() const;
+
+private:
+    struct Extent {
+        uint32_t firstSector;
+        uint32_t sectorCount;
+        ContentClass content;
+    };
+
+    // Settore logico da 2048 byte, con l'eventuale intestazione raw del CD
+    bool ReadSector(uint32_t lba, uint8_t* buffer);
+    bool DetectSectorFormat();
+
+    bool WalkISO9660(const uint8_t* pvd);
+    bool WalkUDF();
+    bool ReadUDFFileEntry(uint32_t partitionStart, uint32_t block, bool isDirectory,
+                          const std::string& name, uint32_t depth);
+
+    void AddExtent(uint32_t firstSector, uint64_t size, ContentClass content);
+    void Finalize();
+
+    InputStream* input_;
+    uint32_t imageSectorSize_;  // 2048 o 2352
+    uint32_t dataOffset_;       // byte di intestazione prima dei dati utente
+    uint64_t sectorLimit_;
+    DiscFilesystem filesystem_;
+    std::vector<Extent> extents_;
+    std::vector<uint32_t> visitedDirs_;
+    uint32_t fileCount_;
+    uint64_t classBytes_[CONTENT_EXECUTABLE + 1];
+};
+
+} // namespace UniversalCompressor
+
+#endif // DISC_LAYOUT_H
@@ -0,0 +1,333 @@
+#include "image_source.h"
+#include "cso_reader.h"
+#include "chd_reader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
+
+namespace UniversalCompressor {
+
+BlockImageSource::BlockImageSource(uint64_t size, uint32_t blockSize, uint32_t threads)
+    : size_(size), blockSize_(blockSize), threads_(std::max(1u, threads)) {
+    blockCount_ = static_cast<uint32_t>((size_ + blockSize_ - 1) / blockSize_);
+    windowBlocks_ = std::max(1u, IMAGE_WINDOW_SIZE / blockSize_);
+    windowCount_ = (blockCount_ + windowBlocks_ - 1) / windowBlocks_;
+}
+
+BlockImageSource::~BlockImageSource() {
+    WaitPrefetch();
+}
+
+void BlockImageSource::WaitPrefetch() {
+    if (prefetch_.valid()) {
+        prefetch_.wait();
+    }
+}
+
+size_t BlockImageSource::ReadAt(uint64_t offset, void* buffer, size_t size) {
+    if (offset >= size_) {
+        return 0;
+    }
+    size = static_cast<size_t>(std::min<uint64_t>(size, size_ - offset));
+
+    const uint64_t windowBytes = static_cast<uint64_t>(windowBlocks_) * blockSize_;
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    size_t copied = 0;
+    while (copied < size) {
+        uint64_t position = offset + copied;
+        uint64_t index = position / windowBytes;
+        if (!SelectWindow(index)) {
+            break;
+        }
+        uint64_t within = position - index * windowBytes;
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(size - copied, current_.data.size() - within));
+        memcpy(output + copied, current_.data.data() + within, chunk);
+        copied += chunk;
+    }
+    return copied;
+}
+
+bool BlockImageSource::SelectWindow(uint64_t index) {
+    if (current_.index != index) {
+        // Una sola decodifica alla volta: i worker hanno stato privato
+        if (prefetch_.valid() && prefetch_.get() && next_.index == index) {
+            std::swap(current_, next_);
+        }
+        if (current_.index != index && !DecodeWindow(index, current_)) {
+            return false;
+        }
+    }
+
+    // Lettura sequenziale: prepara la finestra successiva mentre l'engine comprime
+    if (!prefetch_.valid() && index + 1 < windowCount_ && next_.index != index + 1) {
+        prefetch_ = std::async(std::launch::async, &BlockImageSource::DecodeWindow, this, index + 1, std::ref(next_));
+    }
+    return true;
+}
+
+bool BlockImageSource::DecodeWindow(uint64_t index, Window& window) {
+    window.index = UINT64_MAX;
+    uint32_t first = static_cast<uint32_t>(index * windowBlocks_);
+    uint32_t count = std::min(windowBlocks_, blockCount_ - first);
+    window.data.resize(static_cast<size_t>(count) * blockSize_);
+    if (!LoadBlocks(first, count)) {
+        std::cerr << "Errore: lettura dell'immagine compressa non riuscita (blocco " << first << ")" << std::endl;
+        return false;
+    }
+
+    // Blocchi interlacciati tra i worker, come nella compressione CSO
+    std::atomic<bool> ok(true);
+    std::atomic<uint32_t> failed(UINT32_MAX);
+    auto decode = [&](uint32_t worker, uint32_t stride) {
+        for (uint32_t i = worker; i < count && ok; i += stride) {
+            if (!DecodeBlock(first + i, window.data.data() + static_cast<size_t>(i) * blockSize_, worker)) {
+                failed = first + i;
+                ok = false;
+            }
+        }
+    };
+    uint32_t workers = std::min(threads_, count);
+    if (workers <= 1) {
+        decode(0, 1);
+    } else {
+        std::vector<std::thread> threads;
+        for (uint32_t w = 0; w < workers; ++w) {
+            threads.emplace_back(decode, w, workers);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    if (!ok) {
+        std::cerr << "Errore: blocco " << failed << " dell'immagine compressa non valido" << std::endl;
+        return false;
+    }
+    window.index = index;
+    return true;
+}
+
+// Blocchi di un CSO, ZSO o ZCSO
+class CSOImageSource : public BlockImageSource {
+public:
+    CSOImageSource(std::unique_ptr<CSOReader> reader, uint32_t threads)
+        : BlockImageSource(reader->GetUncompressedSize(), reader->GetBlockSize(), threads),
+          reader_(std::move(reader)), spanStart_(0) {
+        decoders_.resize(GetWorkerCount());
+        scratch_.resize(GetWorkerCount());
+        for (auto& worker : decoders_) {
+            worker.resize(CSO_BLOCK_KINDS);
+            for (int kind = CSO_BLOCK_DEFLATE; kind < CSO_BLOCK_KINDS; ++kind) {
+                worker[kind] = reader_->CreateDecoder(static_cast<CSOBlockKind>(kind));
+            }
+        }
+    }
+
+    ~CSOImageSource() override {
+        WaitPrefetch();
+    }
+
+protected:
+    bool LoadBlocks(uint32_t first, uint32_t count) override {
+        // I blocchi sono salvati in ordine: una sola lettura per la finestra
+        CSOBlockInfo head = reader_->GetBlockInfo(first);
+        CSOBlockInfo tail = reader_->GetBlockInfo(first + count - 1);
+        uint64_t end = tail.offset + tail.size;
+        spanStart_ = head.offset;
+        span_.resize(end > spanStart_ ? static_cast<size_t>(end - spanStart_) : 0);
+        return reader_->ReadStored(spanStart_, span_.data(), span_.size()) == span_.size();
+    }
+
+    bool DecodeBlock(uint32_t block, uint8_t* output, uint32_t worker) override {
+        CSOBlockInfo info = reader_->GetBlockInfo(block);
+        uint32_t blockSize = reader_->GetBlockSize();
+        const uint8_t* stored;
+        if (info.offset >= spanStart_ && info.offset + info.size <= spanStart_ + span_.size()) {
+            stored = span_.data() + (info.offset - spanStart_);
+        } else {
+            // Blocco fuori ordine (file di altri tool): lettura diretta
+            std::lock_guard<std::mutex> lock(fileMutex_);
+            scratch_[worker].resize(info.size);
+            if (reader_->ReadStored(info.offset, scratch_[worker].data(), info.size) != info.size) {
+                return false;
+            }
+            stored = scratch_[worker].data();
+        }
+
+        if (info.kind == CSO_BLOCK_RAW) {
+            if (info.size < blockSize) {
+                return false;
+            }
+            memcpy(output, stored, blockSize);
+            return true;
+        }
+        CodecContext* decoder = decoders_[worker][info.kind].get();
+        return decoder && decoder->Decompress(stored, info.size, output, blockSize) == static_cast<int>(blockSize);
+    }
+
+private:
+    std::unique_ptr<CSOReader> reader_;
+    std::vector<std::vector<std::unique_ptr<CodecContext>>> decoders_;     // [worker][CSOBlockKind]
+    std::vector<std::vector<uint8_t>> scratch_;
+    std::vector<uint8_t> span_;
+    uint64_t spanStart_;
+    std::mutex fileMutex_;
+};
+
+// Hunk di un CHD scritto da questo tool
+class CHDImageSource : public BlockImageSource {
+public:
+    CHDImageSource(std::unique_ptr<CHDReader> reader, uint32_t threads)
+        : BlockImageSource(reader->GetLogicalBytes(), reader->GetHunkSize(), threads),
+          reader_(std::move(reader)), spanStart_(0) {
+        decoders_.resize(GetWorkerCount());
+        scratch_.resize(GetWorkerCount());
+    }
+
+    ~CHDImageSource() override {
+        WaitPrefetch();
+    }
+
+protected:
+    bool LoadBlocks(uint32_t first, uint32_t count) override {
+        // Dati salvati degli hunk della finestra; MINI e SELF_HUNK non ne hanno
+        uint64_t start = UINT64_MAX;
+        uint64_t end = 0;
+        for (uint32_t hunk = first; hunk < first + count; ++hunk) {
+            const CHDMapEntry& entry = reader_->GetMapEntry(hunk);
+            uint8_t type = CHDReader::GetEntryType(entry);
+            if (type == CHD_MAP_COMPRESSED || type == CHD_MAP_UNCOMPRESSED) {
+                start = std::min(start, entry.offset);
+                end = std::max(end, entry.offset + CHDReader::GetEntryLength(entry));
+            }
+        }
+        span_.clear();
+        spanStart_ = 0;
+        if (end == 0) {
+            return true;
+        }
+        spanStart_ = start;
+        span_.resize(static_cast<size_t>(end - start));
+        return reader_->ReadStored(spanStart_, span_.data(), span_.size()) == span_.size();
+    }
+
+    bool DecodeBlock(uint32_t block, uint8_t* output, uint32_t worker) override {
+        const CHDMapEntry& entry = reader_->GetMapEntry(block);
+        uint32_t hunkSize = reader_->GetHunkSize();
+
+        bool ok;
+        switch (CHDReader::GetEntryType(entry)) {
+            case CHD_MAP_MINI:
+                // Pattern di 8 byte salvato big-endian nel campo offset
+                for (uint32_t i = 0; i < hunkSize; ++i) {
+                    output[i] = static_cast<uint8_t>(entry.offset >> (56 - 8 * (i % 8)));
+                }
+                ok = true;
+                break;
+            case CHD_MAP_SELF_HUNK:
+                ok = entry.offset < block &&
+                     DecodeStored(reader_->GetMapEntry(static_cast<uint32_t>(entry.offset)), output, worker);
+                break;
+            default:
+                ok = DecodeStored(entry, output, worker);
+                break;
+        }
+
+        // Il CRC della mappa copre l'hunk decodificato
+        return ok && static_cast<uint32_t>(crc32(0L, output, hunkSize)) == entry.crc;
+    }
+
+private:
+    bool DecodeStored(const CHDMapEntry& entry, uint8_t* output, uint32_t worker) {
+        uint8_t type = CHDReader::GetEntryType(entry);
+        uint32_t length = CHDReader::GetEntryLength(entry);
+        uint32_t hunkSize = reader_->GetHunkSize();
+
+        const uint8_t* stored;
+        if (entry.offset >= spanStart_ && entry.offset + length <= spanStart_ + span_.size()) {
+            stored = span_.data() + (entry.offset - spanStart_);
+        } else {
+            // Hunk di riferimento di una voce SELF_HUNK, salvato fuori dalla finestra
+            std::lock_guard<std::mutex> lock(fileMutex_);
+            if (!reader_->ReadStored(entry, scratch_[worker])) {
+                return false;
+            }
+            stored = scratch_[worker].data();
+        }
+
+        if (type == CHD_MAP_UNCOMPRESSED) {
+            if (length != hunkSize) {
+                return false;
+            }
+            memcpy(output, stored, hunkSize);
+            return true;
+        }
+        if (type != CHD_MAP_COMPRESSED) {
+            return false;
+        }
+
+        // Decoder creati al primo uso, privati del worker
+        uint32_t implId = reader_->GetEntryCodec(entry);
+        auto& decoder = decoders_[worker][implId];
+        if (!decoder) {
+            decoder = reader_->CreateDecoder(implId);
+        }
+        return decoder && decoder->Decompress(stored, length, output, hunkSize) == static_cast<int>(hunkSize);
+    }
+
+    std::unique_ptr<CHDReader> reader_;
+    std::vector<std::map<uint32_t, std::unique_ptr<CodecContext>>> decoders_;  // [worker][implId]
+    std::vector<std::vector<uint8_t>> scratch_;
+    std::vector<uint8_t> span_;
+    uint64_t spanStart_;
+    std::mutex fileMutex_;
+};
+
+bool OpenImageInput(InputStream& input, const std::string& path, uint64_t declaredSize,
+                    uint32_t threads, std::string& error) {
+    error.clear();
+
+    // Il contenitore si riconosce dal magic; stdin è sempre un'immagine grezza
+    char magic[8] = {};
+    if (!IsStdioPath(path)) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file) {
+            size_t ignored = fread(magic, 1, sizeof(magic), file);
+            (void)ignored;
+            fclose(file);
+        }
+    }
+
+    if (memcmp(magic, CSO_MAGIC, 4) == 0 || memcmp(magic, ZSO_MAGIC, 4) == 0 ||
+        memcmp(magic, ZCSO_MAGIC, 4) == 0) {
+        auto reader = std::make_unique<CSOReader>();
+        if (!reader->Open(path)) {
+            error = reader->GetLastError();
+            return false;
+        }
+        input.Open(std::make_unique<CSOImageSource>(std::move(reader), threads));
+        return true;
+    }
+    if (memcmp(magic, CHD_MAGIC, 8) == 0) {
+        auto reader = std::make_unique<CHDReader>();
+        if (!reader->Open(path)) {
+            error = reader->GetLastError();
+            return false;
+        }
+        input.Open(std::make_unique<CHDImageSource>(std::move(reader), threads));
+        return true;
+    }
+
+    if (!input.Open(path, declaredSize)) {
+        error = input.GetLastError();
+        return false;
+    }
+    return true;
+}
+
+} // namespace UniversalCompressor
@@ -0,0 +1,68 @@
+#ifndef IMAGE_SOURCE_H
+#define IMAGE_SOURCE_H
+
+#include "stream_io.h"
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Finestra di immagine decodificata in una volta (arrotondata ai blocchi)
+static const uint32_t IMAGE_WINDOW_SIZE = 8 * 1024 * 1024;
+
+// Immagine decompressa a blocchi da un contenitore (CSO/ZSO/ZCSO o CHD).
+// L'immagine viene decodificata a finestre: i blocchi di una finestra sono
+// decodificati in parallelo e la finestra successiva viene preparata in
+// background mentre l'engine comprime quella corrente.
+class BlockImageSource : public InputSource {
+public:
+    ~BlockImageSource() override;
+
+    uint64_t GetSize() const override { return size_; }
+    size_t ReadAt(uint64_t offset, void* buffer, size_t size) override;
+
+protected:
+    BlockImageSource(uint64_t size, uint32_t blockSize, uint32_t threads);
+
+    // Legge dal file i dati salvati dei blocchi [first, first + count), in un solo thread
+    virtual bool LoadBlocks(uint32_t first, uint32_t count) = 0;
+
+    // Decodifica un blocco caricato; worker indica lo stato privato del thread
+    virtual bool DecodeBlock(uint32_t block, uint8_t* output, uint32_t worker) = 0;
+
+    // Le classi derivate la chiamano nel distruttore, prima di liberare i decoder
+    void WaitPrefetch();
+
+    uint32_t GetWorkerCount() const { return threads_; }
+
+private:
+    struct Window {
+        uint64_t index = UINT64_MAX;
+        std::vector<uint8_t> data;
+    };
+
+    bool DecodeWindow(uint64_t index, Window& window);
+    bool SelectWindow(uint64_t index);
+
+    uint64_t size_;
+    uint32_t blockSize_;
+    uint32_t blockCount_;
+    uint32_t windowBlocks_;
+    uint64_t windowCount_;
+    uint32_t threads_;
+    Window current_;
+    Window next_;
+    std::future<bool> prefetch_;    // decodifica di next_ in corso
+};
+
+// Apre l'input di una compressione: i file CSO/ZSO/ZCSO e CHD vengono
+// decompressi al volo (transcodifica senza file temporanei), gli altri letti
+// così come sono. threads = decoder paralleli per i contenitori.
+bool OpenImageInput(InputStream& input, const std::string& path, uint64_t declaredSize,
+                    uint32_t threads, std::string& error);
+
+} // namespace UniversalCompressor
+
+#endif // IMAGE_SOURCE_H
@@ -0,0 +1,48 @@
+#include "job_control.h"
+
+namespace UniversalCompressor {
+
+JobControl::JobControl() : cancelled_(false), paused_(false) {
+}
+
+void JobControl::Cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    resumed_.notify_all();
+}
+
+void JobControl::CancelFromSignal() {
+    cancelled_ = true;
+}
+
+void JobControl::Pause() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    paused_ = true;
+}
+
+void JobControl::Resume() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = false;
+    }
+    resumed_.notify_all();
+}
+
+void JobControl::Reset() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = false;
+        paused_ = false;
+    }
+    resumed_.notify_all();
+}
+
+bool JobControl::WaitResume() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    resumed_.wait(lock, [this] { return !paused_ || cancelled_; });
+    return !cancelled_;
+}
+
+} // namespace UniversalCompressor
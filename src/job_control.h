@@ -0,0 +1,52 @@
+#ifndef JOB_CONTROL_H
+#define JOB_CONTROL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace UniversalCompressor {
+
+// Comandi di un lavoro in corso, condivisi tra chi lo controlla (CLI, daemon)
+// e gli stadi della compressione. I controlli degli stadi sono letture atomiche
+// rilassate; il mutex serve solo a chi si ferma in pausa.
+class JobControl {
+public:
+    JobControl();
+
+    // Annulla il lavoro e risveglia gli stadi in pausa
+    void Cancel();
+
+    // Solo il flag atomico: utilizzabile da un gestore di segnali
+    void CancelFromSignal();
+
+    void Pause();
+    void Resume();
+
+    // Nuovo lavoro: né annullato né in pausa
+    void Reset();
+
+    bool IsCancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+    bool IsPaused() const { return paused_.load(std::memory_order_relaxed); }
+
+    // Punto di sospensione tra due unità di lavoro: in pausa attende senza
+    // consumare CPU. false = lavoro annullato
+    bool WaitIfPaused() {
+        if (!paused_.load(std::memory_order_relaxed)) {
+            return !IsCancelled();
+        }
+        return WaitResume();
+    }
+
+private:
+    bool WaitResume();
+
+    std::atomic<bool> cancelled_;
+    std::atomic<bool> paused_;
+    std::mutex mutex_;
+    std::condition_variable resumed_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // JOB_CONTROL_H
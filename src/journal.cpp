@@ -0,0 +1,189 @@
+#include "journal.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace UniversalCompressor {
+
+static const char JOURNAL_MAGIC[4] = {'U', 'C', 'J', '1'};
+static const uint32_t JOURNAL_VERSION = 1;
+
+#pragma pack(push, 1)
+struct JournalHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t totalBlocks;
+    uint64_t inputSize;
+    int64_t inputTime;
+    uint64_t fingerprint;
+    uint32_t committedBlocks;
+    uint32_t hasDigest;
+    uint64_t outputPos;
+    uint64_t tableSize;
+    SHA1State digest;
+    uint32_t crc;           // CRC32 di header (senza questo campo) e tabella
+};
+#pragma pack(pop)
+
+// Forza su disco i dati già passati al sistema operativo
+static bool SyncFile(FILE* file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+static uint32_t JournalCRC(const JournalHeader& header, const uint8_t* table, size_t tableSize) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(&header), offsetof(JournalHeader, crc));
+    if (tableSize > 0) {
+        crc = crc32(crc, table, static_cast<uInt>(tableSize));
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+CompressionJournal::CompressionJournal()
+    : kind_(0), inputSize_(0), inputTime_(0), fingerprint_(0),
+      totalBlocks_(0), intervalSeconds_(0) {
+}
+
+std::string CompressionJournal::PathFor(const std::string& outputFile) {
+    return outputFile + ".journal";
+}
+
+void CompressionJournal::Open(const std::string& inputFile, const std::string& outputFile,
+                              JournalKind kind, uint64_t fingerprint, uint32_t totalBlocks,
+                              uint32_t intervalSeconds) {
+    path_ = PathFor(outputFile);
+    outputFile_ = outputFile;
+    kind_ = kind;
+    fingerprint_ = fingerprint;
+    totalBlocks_ = totalBlocks;
+    intervalSeconds_ = intervalSeconds;
+    lastCheckpoint_ = std::chrono::steady_clock::now();
+
+    std::error_code error;
+    inputSize_ = std::filesystem::file_size(inputFile, error);
+    inputTime_ = error ? 0 : std::filesystem::last_write_time(inputFile, error).time_since_epoch().count();
+}
+
+bool CompressionJournal::Load(JournalState& state, std::vector<uint8_t>& table) {
+    FILE* file = fopen(path_.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    JournalHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, JOURNAL_MAGIC, 4) == 0 &&
+                 header.version == JOURNAL_VERSION &&
+                 header.kind == kind_ &&
+                 header.inputSize == inputSize_ &&
+                 header.inputTime == inputTime_ &&
+                 header.fingerprint == fingerprint_ &&
+                 header.totalBlocks == totalBlocks_ &&
+                 header.committedBlocks <= totalBlocks_ &&
+                 header.tableSize <= static_cast<uint64_t>(totalBlocks_ + 1) * 16;
+    if (valid) {
+        table.resize(static_cast<size_t>(header.tableSize));
+        valid = table.empty() || fread(table.data(), 1, table.size(), file) == table.size();
+    }
+    fclose(file);
+
+    // Il checksum scarta journal troncati; l'output deve contenere tutti i dati registrati
+    std::error_code error;
+    uint64_t outputSize = std::filesystem::file_size(outputFile_, error);
+    if (!valid || header.crc != JournalCRC(header, table.data(), table.size()) ||
+        error || outputSize < header.outputPos) {
+        table.clear();
+        return false;
+    }
+
+    state.committedBlocks = header.committedBlocks;
+    state.outputPos = header.outputPos;
+    state.hasDigest = header.hasDigest != 0;
+    state.digest = header.digest;
+    return true;
+}
+
+bool CompressionJournal::ShouldCheckpoint() const {
+    if (intervalSeconds_ == 0) {
+        return false;
+    }
+    return std::chrono::steady_clock::now() - lastCheckpoint_ >= std::chrono::seconds(intervalSeconds_);
+}
+
+bool CompressionJournal::Checkpoint(OutputStream& output, const JournalState& state, const void* table, size_t tableSize) {
+    lastCheckpoint_ = std::chrono::steady_clock::now();
+
+    // Prima i dati: il journal non deve mai precedere l'output su disco
+    if (!output.Sync()) {
+        return false;
+    }
+
+    JournalHeader header = {};
+    memcpy(header.magic, JOURNAL_MAGIC, 4);
+    header.version = JOURNAL_VERSION;
+    header.kind = kind_;
+    header.totalBlocks = totalBlocks_;
+    header.inputSize = inputSize_;
+    header.inputTime = inputTime_;
+    header.fingerprint = fingerprint_;
+    header.committedBlocks = state.committedBlocks;
+    header.hasDigest = state.hasDigest ? 1 : 0;
+    header.outputPos = state.outputPos;
+    header.tableSize = tableSize;
+    header.digest = state.digest;
+    header.crc = JournalCRC(header, static_cast<const uint8_t*>(table), tableSize);
+
+    std::string tempPath = path_ + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              (tableSize == 0 || fwrite(table, 1, tableSize, file) == tableSize) &&
+              SyncFile(file);
+    fclose(file);
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(tempPath, path_, error);
+    }
+    if (!ok || error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+void CompressionJournal::Remove() {
+    if (path_.empty()) {
+        return;
+    }
+    std::error_code error;
+    std::filesystem::remove(path_, error);
+    std::filesystem::remove(path_ + ".tmp", error);
+}
+
+uint64_t CompressionJournal::Fingerprint(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace UniversalCompressor
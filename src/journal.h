@@ -0,0 +1,76 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "sha1.h"
+#include "stream_io.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Tipo di lavoro registrato nel journal
+enum JournalKind {
+    JOURNAL_CSO = 1,
+    JOURNAL_CHD = 2
+};
+
+// Punto di ripresa: tutto ciò che precede outputPos è già sul disco
+struct JournalState {
+    uint32_t committedBlocks = 0;   // blocchi/hunk scritti e registrati nella tabella
+    uint64_t outputPos = 0;         // fine dei dati validi nel file di output
+    bool hasDigest = false;
+    SHA1State digest = {};          // digest dei dati letti fino a committedBlocks
+};
+
+// Journal di checkpoint accanto al file di output (<output>.journal).
+// Ogni checkpoint riscrive il journal in modo atomico (file temporaneo +
+// rename) dopo aver forzato su disco l'output, così il journal non descrive
+// mai dati che potrebbero essere andati persi.
+class CompressionJournal {
+public:
+    CompressionJournal();
+
+    static std::string PathFor(const std::string& outputFile);
+
+    // Identità del lavoro: input (dimensione e data), tipo, layout e numero di blocchi.
+    // fingerprint riassume le opzioni che cambiano il layout dell'output.
+    void Open(const std::string& inputFile, const std::string& outputFile,
+              JournalKind kind, uint64_t fingerprint, uint32_t totalBlocks,
+              uint32_t intervalSeconds);
+
+    // Carica e valida il journal: stesso lavoro, checksum corretto, output abbastanza lungo
+    bool Load(JournalState& state, std::vector<uint8_t>& table);
+
+    // Vero se è passato l'intervallo dall'ultimo checkpoint (0 = checkpoint disabilitati)
+    bool ShouldCheckpoint() const;
+
+    // Checkpoint abilitati per questo lavoro (output su file e intervallo non nullo)
+    bool IsEnabled() const { return !path_.empty() && intervalSeconds_ > 0; }
+
+    // table: prefisso dell'indice CSO o della mappa hunk relativo ai blocchi registrati
+    bool Checkpoint(OutputStream& output, const JournalState& state, const void* table, size_t tableSize);
+
+    void Remove();
+
+    // Impronta FNV-1a incrementale delle opzioni di layout
+    static uint64_t Fingerprint(uint64_t hash, const void* data, size_t size);
+    static const uint64_t FINGERPRINT_SEED = 1469598103934665603ULL;
+
+private:
+    std::string path_;
+    std::string outputFile_;
+    uint32_t kind_;
+    uint64_t inputSize_;
+    int64_t inputTime_;
+    uint64_t fingerprint_;
+    uint32_t totalBlocks_;
+    uint32_t intervalSeconds_;
+    std::chrono::steady_clock::time_point lastCheckpoint_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // JOURNAL_H
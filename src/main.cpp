@@ -1,4 +1,7 @@
 #include "universal_compressor.h"
+#include "stream_io.h"
+#include "daemon.h"
+#include "journal.h"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -6,9 +9,21 @@
 #include <chrono>
 #include <iomanip>
 #include <algorithm>
+#include <csignal>
 
 using namespace UniversalCompressor;
 
+// Ctrl+C / SIGTERM annullano il lavoro in corso: l'output resta riprendibile
+// con --resume. Un secondo segnale termina subito il processo.
+static JobControl* g_jobControl = nullptr;
+
+static void CancelSignalHandler(int signal) {
+    if (g_jobControl) {
+        g_jobControl->CancelFromSignal();
+    }
+    std::signal(signal, SIG_DFL);
+}
+
 // Struttura per parsing argomenti
 struct Arguments {
     std::vector<std::string> inputFiles;
@@ -17,12 +32,28 @@ struct Arguments {
     
     // Opzioni CSO
     CSOConfig csoConfig;
+    bool csoNoLZ4 = false;  // applicata dopo tutte le opzioni, anche quelle di un lavoro del daemon
     
     // Opzioni CHD
     CHDConfig chdConfig;
     
     // Opzioni generali
     GeneralConfig generalConfig;
+
+    // Addestramento dizionario (al posto della compressione)
+    std::string trainDictionary;
+    DictionaryConfig dictionaryConfig;
+
+    // Stima di dimensione e tempo (al posto della compressione)
+    bool estimate = false;
+    uint32_t estimateSamples = 256;
+    
+    // Output su stdout (i messaggi vanno su stderr)
+    bool toStdout = false;
+
+    // Modalità daemon: socket su cui ricevere i lavori e lavori contemporanei
+    std::string daemonSocket;
+    uint32_t daemonJobs = 1;
     
     bool showHelp = false;
     bool showVersion = false;
@@ -46,101 +77,409 @@ void ShowHelp(const char* programName) {
     std::cout << "  --type=TIPO         Tipo compressione: cso o chd (default: cso)" << std::endl;
     std::cout << "  --output=CARTELLA   Cartella output (default: cartella corrente)" << std::endl;
     std::cout << "  --delete-input      Elimina file input dopo compressione" << std::endl;
+    std::cout << "  --checkpoint=SEC    Intervallo dei checkpoint nel journal (default: 60, 0 = no)" << std::endl;
+    std::cout << "  --resume            Riprende dall'ultimo checkpoint (file .journal)" << std::endl;
+    std::cout << "  --stdout            Scrive l'immagine compressa su stdout (un solo input)" << std::endl;
+    std::cout << "  --size=BYTE         Dimensione dell'input letto da pipe (input '-' = stdin)" << std::endl;
+    std::cout << "  --no-file-analysis  Non usare i file ISO9660/UDF per decidere cosa comprimere" << std::endl;
+    std::cout << "  --numa              Worker e buffer per nodo NUMA (macchine multi-socket)" << std::endl;
+    std::cout << "  --reuse=FILE        Copia i blocchi invariati da un output precedente (un solo input)" << std::endl;
+    std::cout << "  --cache=DIR         Cache dei blocchi compressi condivisa tra immagini ed esecuzioni" << std::endl;
+    std::cout << "  --auto[=OBIETTIVO]  Sceglie codec, livello, hunk e thread per ogni immagine:" << std::endl;
+    std::cout << "                      speed:MB/s = rapporto massimo a quella velocità," << std::endl;
+    std::cout << "                      ratio:R = più veloce con rapporto >= R (default: bilanciato)" << std::endl;
+    std::cout << "  --auto-samples=N    Porzioni dell'immagine provate da --auto (default: 256)" << std::endl;
+    std::cout << "  --estimate[=N]      Stima dimensione e tempo su N porzioni, senza output (default: 256)" << std::endl;
     std::cout << "  --verbose           Output verboso" << std::endl;
     std::cout << "  --quiet             Output silenzioso" << std::endl;
     std::cout << std::endl;
     std::cout << "Opzioni CSO:" << std::endl;
-    std::cout << "  --cso-format=FMT    Formato: cso1, cso2, zso, dax (default: cso1)" << std::endl;
+    std::cout << "  --cso-format=FMT    Formato: cso1, cso2, zso, dax, zcso (default: cso1)" << std::endl;
     std::cout << "  --cso-threads=N     Numero thread (default: 4)" << std::endl;
     std::cout << "  --cso-block=SIZE    Dimensione blocco (default: auto)" << std::endl;
     std::cout << "  --cso-fast          Modalità veloce" << std::endl;
     std::cout << "  --cso-no-zlib       Disabilita compressione zlib" << std::endl;
     std::cout << "  --cso-no-7zip       Disabilita compressione 7zip" << std::endl;
+    std::cout << "  --cso-no-libdeflate Disabilita compressione libdeflate" << std::endl;
+    std::cout << "  --cso-zopfli        Abilita Zopfli (massimo rapporto, molto lento)" << std::endl;
+    std::cout << "  --cso-lz4           Abilita blocchi LZ4 (zcso; attivi di default in cso2, zso usa solo LZ4)" << std::endl;
+    std::cout << "  --cso-no-lz4        Disabilita i blocchi LZ4 in cso2/zcso" << std::endl;
+    std::cout << "  --cso-orig-cost=P   Costo % dei blocchi non compressi, 1-1000 (default: 90)" << std::endl;
+    std::cout << "  --cso-lz4-cost=P    Costo % dei blocchi LZ4, 1-1000, <100 li favorisce (default: 100)" << std::endl;
+    std::cout << "  --lz4-accel=N       LZ4 veloce con accelerazione N (1 = massimo rapporto)" << std::endl;
+    std::cout << "  --lz4-level=N       LZ4 HC al livello N 1-12 (default: dal profilo)" << std::endl;
+    std::cout << "  --cso-no-zstd       Disabilita compressione zstd (solo zcso)" << std::endl;
+    std::cout << "  --zcso-codec=C      Codec dei blocchi zcso: zstd, deflate (default: zstd)" << std::endl;
     std::cout << std::endl;
     std::cout << "Opzioni CHD:" << std::endl;
     std::cout << "  --chd-hunk=SIZE     Dimensione hunk (default: 19584)" << std::endl;
     std::cout << "  --chd-processors=N  Numero processori (default: 4)" << std::endl;
-    std::cout << "  --chd-compression=C Codec: cdlz,cdzl,cdfl (default: tutti)" << std::endl;
+    std::cout << "  --chd-compression=C Codec: cdlz,cdzl,cdfl,zstd (default: cdlz,cdzl,cdfl)" << std::endl;
     std::cout << "  --chd-no-force      Non forzare sovrascrittura" << std::endl;
     std::cout << std::endl;
+    std::cout << "Opzioni zstd (zcso e CHD con codec zstd):" << std::endl;
+    std::cout << "  --zstd-level=N      Livello zstd 1-19 (default: dal profilo)" << std::endl;
+    std::cout << "  --dict=FILE         Dizionario addestrato (salvato nel file zcso)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Addestramento dizionari:" << std::endl;
+    std::cout << "  --train-dict=FILE   Campiona le immagini e scrive il dizionario in FILE" << std::endl;
+    std::cout << "  --dict-type=T       zstd o raw (preset deflate/LZ4) (default: zstd)" << std::endl;
+    std::cout << "  --dict-size=N       Dimensione in byte (default: 65536 zstd, 32768 raw)" << std::endl;
+    std::cout << "  --dict-samples=N    Blocchi campionati per immagine (default: 4096)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Modalità daemon:" << std::endl;
+    std::cout << "  --daemon=SOCKET     Riceve i lavori via JSON su un socket Unix (le altre opzioni fanno da default)" << std::endl;
+    std::cout << "  --jobs=N            Lavori eseguiti contemporaneamente dal daemon (default: 1)" << std::endl;
+    std::cout << std::endl;
     std::cout << "Esempi:" << std::endl;
     std::cout << "  " << programName << " game.iso" << std::endl;
     std::cout << "  " << programName << " --type=chd --output=compressed game.iso" << std::endl;
     std::cout << "  " << programName << " --cso-format=zso --cso-fast *.iso" << std::endl;
+    std::cout << "  " << programName << " --train-dict=psp.dict *.iso" << std::endl;
+    std::cout << "  " << programName << " --cso-format=zcso --dict=psp.dict game.iso" << std::endl;
+    std::cout << "  curl -s URL | " << programName << " --size=1468006400 --stdout - > game.cso" << std::endl;
+    std::cout << "  " << programName << " --cso-format=cso2 --output=new --reuse=old/game.cso game.iso" << std::endl;
+    std::cout << "  " << programName << " --type=chd --output=chd game.cso" << std::endl;
+    std::cout << "  " << programName << " --auto=speed:200 *.iso" << std::endl;
+    std::cout << "  " << programName << " --cache=/var/cache/uc --output=out *.iso" << std::endl;
+    std::cout << "  " << programName << " --type=chd --estimate big.iso" << std::endl;
+    std::cout << "  " << programName << " --daemon=/tmp/uc.sock --jobs=2 --output=out" << std::endl;
 }
 
-bool ParseArguments(int argc, char* argv[], Arguments& args) {
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        
-        if (arg == "--help" || arg == "-h") {
-            args.showHelp = true;
-            return true;
-        } else if (arg == "--version" || arg == "-v") {
-            args.showVersion = true;
-            return true;
-        } else if (arg.find("--type=") == 0) {
-            std::string type = arg.substr(7);
-            if (type == "cso") {
-                args.compressionType = COMPRESSION_CSO;
-            } else if (type == "chd") {
-                args.compressionType = COMPRESSION_CHD;
-            } else {
-                std::cerr << "Errore: Tipo compressione non valido: " << type << std::endl;
+// Costo % di un tipo di blocco: oltre 1000 il modello non cambia più le scelte,
+// sotto 1 un solo byte pesa quanto un blocco intero (NaN e infinito sono esclusi)
+static bool ParseCostPercent(const std::string& value, double& percent) {
+    percent = std::stod(value);
+    return percent >= 1.0 && percent <= 1000.0;
+}
+
+bool ParseArguments(const std::vector<std::string>& list, Arguments& args, std::string& error) {
+    // std::stoul e std::stod lanciano un'eccezione sui valori non numerici
+    std::string current;
+    try {
+        for (const std::string& arg : list) {
+            current = arg;
+            if (arg == "--help" || arg == "-h") {
+                args.showHelp = true;
+                return true;
+            } else if (arg == "--version" || arg == "-v") {
+                args.showVersion = true;
+                return true;
+            } else if (arg.find("--type=") == 0) {
+                std::string type = arg.substr(7);
+                if (type == "cso") {
+                    args.compressionType = COMPRESSION_CSO;
+                } else if (type == "chd") {
+                    args.compressionType = COMPRESSION_CHD;
+                } else {
+                    error = "Tipo compressione non valido: " + type;
+                    return false;
+                }
+            } else if (arg.find("--output=") == 0) {
+                args.outputPath = arg.substr(9);
+            } else if (arg == "--delete-input") {
+                args.generalConfig.deleteInputFiles = true;
+            } else if (arg.find("--checkpoint=") == 0) {
+                args.generalConfig.checkpointInterval = std::stoul(arg.substr(13));
+            } else if (arg == "--resume") {
+                args.generalConfig.resume = true;
+            } else if (arg == "--no-file-analysis") {
+                args.csoConfig.fileAnalysis = false;
+                args.chdConfig.fileAnalysis = false;
+            } else if (arg == "--numa") {
+                args.csoConfig.numa = true;
+                args.chdConfig.numa = true;
+            } else if (arg == "--stdout") {
+                args.toStdout = true;
+            } else if (arg.find("--size=") == 0) {
+                args.generalConfig.inputSize = std::stoull(arg.substr(7));
+            } else if (arg == "--auto") {
+                args.generalConfig.autoTune.enabled = true;
+                args.generalConfig.autoTune.objective = AUTO_BALANCED;
+            } else if (arg.find("--auto=") == 0) {
+                // speed:MB/s (rapporto massimo a quella velocità) o ratio:R (più veloce con quel rapporto)
+                std::string target = arg.substr(7);
+                AutoTuneConfig& autoTune = args.generalConfig.autoTune;
+                autoTune.enabled = true;
+                if (target.find("speed:") == 0) {
+                    autoTune.objective = AUTO_MAX_RATIO;
+                    autoTune.target = std::stod(target.substr(6));
+                } else if (target.find("ratio:") == 0) {
+                    autoTune.objective = AUTO_MIN_TIME;
+                    autoTune.target = std::stod(target.substr(6));
+                } else {
+                    error = "Obiettivo --auto non valido: " + target;
+                    return false;
+                }
+            } else if (arg.find("--auto-samples=") == 0) {
+                args.generalConfig.autoTune.samples = std::stoul(arg.substr(15));
+            } else if (arg == "--estimate") {
+                args.estimate = true;
+            } else if (arg.find("--estimate=") == 0) {
+                args.estimate = true;
+                args.estimateSamples = std::max(1ul, std::stoul(arg.substr(11)));
+            } else if (arg.find("--cache=") == 0) {
+                args.generalConfig.cacheDirectory = arg.substr(8);
+            } else if (arg.find("--reuse=") == 0) {
+                args.generalConfig.reuseFile = arg.substr(8);
+            } else if (arg.find("--daemon=") == 0) {
+                args.daemonSocket = arg.substr(9);
+            } else if (arg.find("--jobs=") == 0) {
+                args.daemonJobs = std::stoul(arg.substr(7));
+            } else if (arg == "--verbose") {
+                args.verbose = true;
+                args.generalConfig.verbose = true;
+            } else if (arg == "--quiet") {
+                args.quiet = true;
+            } else if (arg.find("--cso-format=") == 0) {
+                std::string format = arg.substr(13);
+                if (format == "cso1") args.csoConfig.format = CSO_FORMAT_CSO1;
+                else if (format == "cso2") {
+                    // CSO2: il selettore sceglie per ogni blocco tra deflate, LZ4 e non compresso
+                    args.csoConfig.format = CSO_FORMAT_CSO2;
+                    args.csoConfig.algorithms |= CSO_ALG_LZ4;
+                }
+                else if (format == "zso") args.csoConfig.format = CSO_FORMAT_ZSO;
+                else if (format == "dax") args.csoConfig.format = CSO_FORMAT_DAX;
+                else if (format == "zcso") args.csoConfig.format = CSO_FORMAT_ZCSO;
+                else {
+                    error = "Formato CSO non valido: " + format;
+                    return false;
+                }
+            } else if (arg.find("--cso-threads=") == 0) {
+                args.csoConfig.threads = std::stoul(arg.substr(14));
+            } else if (arg.find("--cso-block=") == 0) {
+                args.csoConfig.blockSize = std::stoul(arg.substr(12));
+            } else if (arg == "--cso-fast") {
+                args.csoConfig.fastMode = true;
+            } else if (arg == "--cso-no-zlib") {
+                args.csoConfig.algorithms &= ~CSO_ALG_ZLIB;
+            } else if (arg == "--cso-no-7zip") {
+                args.csoConfig.algorithms &= ~CSO_ALG_7ZIP;
+            } else if (arg == "--cso-no-libdeflate") {
+                args.csoConfig.algorithms &= ~CSO_ALG_LIBDEFLATE;
+            } else if (arg == "--cso-zopfli") {
+                args.csoConfig.algorithms |= CSO_ALG_ZOPFLI;
+            } else if (arg == "--cso-lz4") {
+                args.csoConfig.algorithms |= CSO_ALG_LZ4;
+                args.csoNoLZ4 = false;
+            } else if (arg == "--cso-no-lz4") {
+                args.csoNoLZ4 = true;
+            } else if (arg.find("--cso-orig-cost=") == 0) {
+                if (!ParseCostPercent(arg.substr(16), args.csoConfig.origCostPercent)) {
+                    error = "Costo dei blocchi non compressi non valido (1-1000): " + arg.substr(16);
+                    return false;
+                }
+            } else if (arg.find("--cso-lz4-cost=") == 0) {
+                // Il costo LZ4 ha senso solo con i blocchi LZ4 abilitati
+                if (!ParseCostPercent(arg.substr(15), args.csoConfig.lz4CostPercent)) {
+                    error = "Costo dei blocchi LZ4 non valido (1-1000): " + arg.substr(15);
+                    return false;
+                }
+                args.csoConfig.algorithms |= CSO_ALG_LZ4;
+            } else if (arg.find("--lz4-accel=") == 0) {
+                // Stessa convenzione dei livelli del codec: negativo = accelerazione
+                int acceleration = std::stoi(arg.substr(12));
+                if (acceleration < 1) {
+                    error = "Accelerazione LZ4 non valida: " + arg.substr(12);
+                    return false;
+                }
+                args.csoConfig.lz4Level = -acceleration;
+            } else if (arg.find("--lz4-level=") == 0) {
+                int level = std::stoi(arg.substr(12));
+                if (level < 1 || level > 12) {
+                    error = "Livello LZ4 HC non valido: " + arg.substr(12);
+                    return false;
+                }
+                args.csoConfig.lz4Level = level;
+            } else if (arg == "--cso-no-zstd") {
+                args.csoConfig.algorithms &= ~CSO_ALG_ZSTD;
+            } else if (arg.find("--zcso-codec=") == 0) {
+                std::string codec = arg.substr(13);
+                if (codec == "zstd") args.csoConfig.zcsoCodec = ZCSO_CODEC_ZSTD;
+                else if (codec == "deflate") args.csoConfig.zcsoCodec = ZCSO_CODEC_DEFLATE;
+                else {
+                    error = "Codec zcso non valido: " + codec;
+                    return false;
+                }
+            } else if (arg.find("--chd-hunk=") == 0) {
+                args.chdConfig.hunkSize = std::stoul(arg.substr(11));
+            } else if (arg.find("--chd-processors=") == 0) {
+                args.chdConfig.processors = std::stoul(arg.substr(17));
+            } else if (arg.find("--chd-compression=") == 0) {
+                std::string list = arg.substr(18);
+                args.chdConfig.codecs = CHD_CODEC_NONE;
+                size_t start = 0;
+                while (start <= list.size()) {
+                    size_t end = list.find(',', start);
+                    if (end == std::string::npos) end = list.size();
+                    std::string codec = list.substr(start, end - start);
+                    if (codec == "cdlz") args.chdConfig.codecs |= CHD_CODEC_CDLZ;
+                    else if (codec == "cdzl") args.chdConfig.codecs |= CHD_CODEC_CDZL;
+                    else if (codec == "cdfl") args.chdConfig.codecs |= CHD_CODEC_CDFL;
+                    else if (codec == "zstd") args.chdConfig.codecs |= CHD_CODEC_ZSTD;
+                    else {
+                        error = "Codec CHD non valido: " + codec;
+                        return false;
+                    }
+                    start = end + 1;
+                }
+            } else if (arg == "--chd-no-force") {
+                args.chdConfig.force = false;
+            } else if (arg.find("--zstd-level=") == 0) {
+                int level = std::stoi(arg.substr(13));
+                if (level < 1 || level > 19) {
+                    error = "Livello zstd non valido (1-19): " + arg.substr(13);
+                    return false;
+                }
+                args.csoConfig.zstdLevel = level;
+                args.chdConfig.zstdLevel = level;
+            } else if (arg.find("--dict=") == 0 || arg.find("--zstd-dict=") == 0) {
+                args.csoConfig.dictionary = arg.substr(arg.find('=') + 1);
+                args.chdConfig.zstdDictionary = args.csoConfig.dictionary;
+            } else if (arg.find("--train-dict=") == 0) {
+                args.trainDictionary = arg.substr(13);
+            } else if (arg.find("--dict-type=") == 0) {
+                std::string type = arg.substr(12);
+                if (type == "zstd") args.dictionaryConfig.type = DICTIONARY_ZSTD;
+                else if (type == "raw") args.dictionaryConfig.type = DICTIONARY_RAW;
+                else {
+                    error = "Tipo dizionario non valido: " + type;
+                    return false;
+                }
+            } else if (arg.find("--dict-size=") == 0) {
+                args.dictionaryConfig.size = std::stoul(arg.substr(12));
+            } else if (arg.find("--dict-samples=") == 0) {
+                args.dictionaryConfig.samplesPerFile = std::stoul(arg.substr(15));
+            } else if (arg.find("--") == 0) {
+                error = "Opzione sconosciuta: " + arg;
                 return false;
+            } else {
+                // File di input
+                args.inputFiles.push_back(arg);
             }
-        } else if (arg.find("--output=") == 0) {
-            args.outputPath = arg.substr(9);
-        } else if (arg == "--delete-input") {
-            args.generalConfig.deleteInputFiles = true;
-        } else if (arg == "--verbose") {
-            args.verbose = true;
-            args.generalConfig.verbose = true;
-        } else if (arg == "--quiet") {
-            args.quiet = true;
-        } else if (arg.find("--cso-format=") == 0) {
-            std::string format = arg.substr(13);
-            if (format == "cso1") args.csoConfig.format = CSO_FORMAT_CSO1;
-            else if (format == "cso2") args.csoConfig.format = CSO_FORMAT_CSO2;
-            else if (format == "zso") args.csoConfig.format = CSO_FORMAT_ZSO;
-            else if (format == "dax") args.csoConfig.format = CSO_FORMAT_DAX;
-            else {
-                std::cerr << "Errore: Formato CSO non valido: " << format << std::endl;
-                return false;
+        }
+    } catch (const std::exception&) {
+        error = "Valore non valido: " + current;
+        return false;
+    }
+
+    // Vale anche se --cso-format=cso2 o --cso-lz4-cost vengono dopo
+    if (args.csoNoLZ4) {
+        args.csoConfig.algorithms &= ~CSO_ALG_LZ4;
+    }
+    return true;
+}
+
+// --estimate: dimensione e tempo previsti per ogni immagine
+static int RunEstimate(UniversalCompressor::UniversalCompressor& compressor, const Arguments& args) {
+    int errorCount = 0;
+    for (const auto& inputFile : args.inputFiles) {
+        auto startTime = std::chrono::steady_clock::now();
+        CompressionEstimate estimate;
+        TaskStatus result = compressor.EstimateFile(inputFile, args.compressionType, args.estimateSamples, estimate);
+        if (result != TASK_SUCCESS) {
+            errorCount++;
+            std::cerr << "Stima non riuscita: " << inputFile << std::endl;
+            if (result == TASK_CANCELLED) {
+                break;
             }
-        } else if (arg.find("--cso-threads=") == 0) {
-            args.csoConfig.threads = std::stoul(arg.substr(14));
-        } else if (arg.find("--cso-block=") == 0) {
-            args.csoConfig.blockSize = std::stoul(arg.substr(12));
-        } else if (arg == "--cso-fast") {
-            args.csoConfig.fastMode = true;
-        } else if (arg == "--cso-no-zlib") {
-            args.csoConfig.algorithms &= ~CSO_ALG_ZLIB;
-        } else if (arg == "--cso-no-7zip") {
-            args.csoConfig.algorithms &= ~CSO_ALG_7ZIP;
-        } else if (arg.find("--chd-hunk=") == 0) {
-            args.chdConfig.hunkSize = std::stoul(arg.substr(11));
-        } else if (arg.find("--chd-processors=") == 0) {
-            args.chdConfig.processors = std::stoul(arg.substr(17));
-        } else if (arg == "--chd-no-force") {
-            args.chdConfig.force = false;
-        } else if (arg.find("--") == 0) {
-            std::cerr << "Errore: Opzione sconosciuta: " << arg << std::endl;
-            return false;
-        } else {
-            // File di input
-            args.inputFiles.push_back(arg);
+            continue;
+        }
+        if (args.quiet) {
+            continue;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        double ratio = 100.0 * (1.0 - static_cast<double>(estimate.outputSize) / estimate.inputSize);
+        double speed = (estimate.seconds > 0.0) ? estimate.inputSize / estimate.seconds / (1024.0 * 1024.0) : 0.0;
+
+        std::cout << "Stima: " << inputFile << " (" << Utils::FormatBytes(estimate.inputSize) << ")" << std::endl;
+        if (!estimate.summary.empty()) {
+            std::cout << "  " << estimate.summary << std::endl;
         }
+        std::cout << "  Output: " << Utils::FormatBytes(estimate.outputSize)
+                  << " (" << Utils::FormatBytes(estimate.outputLow) << " - "
+                  << Utils::FormatBytes(estimate.outputHigh) << ", riduzione "
+                  << std::fixed << std::setprecision(1) << ratio << "%)" << std::endl;
+        std::cout << "  Tempo: " << Utils::FormatTime(estimate.seconds)
+                  << " (" << Utils::FormatTime(estimate.secondsLow) << " - "
+                  << Utils::FormatTime(estimate.secondsHigh) << ", ~"
+                  << std::fixed << std::setprecision(0) << speed << " MB/s con "
+                  << estimate.threads << " thread, lettura esclusa)" << std::endl;
+        std::cout << "  Campioni: " << estimate.strata << " porzioni, "
+                  << Utils::FormatBytes(estimate.sampleBytes) << " in "
+                  << Utils::FormatTime(elapsed) << std::endl;
     }
-    
+    return (errorCount == 0) ? 0 : 1;
+}
+
+// Opzioni di un lavoro inviato al daemon: quelle del daemon fanno da default
+static bool ParseDaemonJob(const Arguments& defaults, const std::vector<std::string>& options,
+                           DaemonJob& job, std::string& error) {
+    Arguments args = defaults;
+    if (!ParseArguments(options, args, error)) {
+        return false;
+    }
+    if (args.showHelp || args.showVersion || args.toStdout || !args.daemonSocket.empty() ||
+        !args.trainDictionary.empty() || args.estimate) {
+        error = "Opzione non disponibile per i lavori del daemon";
+        return false;
+    }
+    if (args.inputFiles.size() != 1 || IsStdioPath(args.inputFiles[0])) {
+        error = "Ogni lavoro richiede un solo file di input (non stdin)";
+        return false;
+    }
+    const std::string& inputFile = args.inputFiles[0];
+    if (!std::filesystem::exists(inputFile)) {
+        error = "File non trovato: " + inputFile;
+        return false;
+    }
+
+    // Stesso nome di output della CLI
+    UniversalCompressor::UniversalCompressor naming;
+    naming.SetCSOConfig(args.csoConfig);
+    std::string outputPath = args.outputPath.empty() ? std::filesystem::current_path().string() : args.outputPath;
+
+    job.inputFile = inputFile;
+    job.outputFile = outputPath + "/" + naming.GenerateOutputFilename(inputFile, args.compressionType);
+    job.type = args.compressionType;
+    job.csoConfig = args.csoConfig;
+    job.chdConfig = args.chdConfig;
+    job.generalConfig = args.generalConfig;
     return true;
 }
 
+static int RunDaemon(const Arguments& args) {
+    if (!args.inputFiles.empty() || args.toStdout || !args.trainDictionary.empty()) {
+        std::cerr << "Errore: --daemon riceve i file dai client, non dalla riga di comando" << std::endl;
+        return 1;
+    }
+
+    Arguments defaults = args;
+    defaults.daemonSocket.clear();
+
+    DaemonConfig config;
+    config.socketPath = args.daemonSocket;
+    config.jobs = args.daemonJobs;
+    config.verbose = args.verbose;
+    CompressionDaemon daemon(config, [defaults](const std::vector<std::string>& options, DaemonJob& job,
+                                                std::string& error) {
+        return ParseDaemonJob(defaults, options, job, error);
+    });
+    int result = daemon.Run();
+    if (result != 0) {
+        std::cerr << "Errore: " << daemon.GetLastError() << std::endl;
+    }
+    return result;
+}
+
 int main(int argc, char* argv[]) {
     Arguments args;
     
     // Parsing argomenti
-    if (!ParseArguments(argc, argv, args)) {
+    std::string error;
+    if (!ParseArguments(std::vector<std::string>(argv + 1, argv + argc), args, error)) {
+        std::cerr << "Errore: " << error << std::endl;
         return 1;
     }
     
@@ -153,6 +492,10 @@ int main(int argc, char* argv[]) {
         ShowVersion();
         return 0;
     }
+
+    if (!args.daemonSocket.empty()) {
+        return RunDaemon(args);
+    }
     
     // Verifica che ci siano file di input
     if (args.inputFiles.empty()) {
@@ -161,6 +504,21 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    // Con --stdout l'immagine occupa stdout: tutti i messaggi vanno su stderr
+    std::ostream& out = args.toStdout ? std::cerr : std::cout;
+    if (args.toStdout && args.inputFiles.size() != 1) {
+        std::cerr << "Errore: --stdout richiede un solo file di input" << std::endl;
+        return 1;
+    }
+    if (!args.generalConfig.reuseFile.empty() && args.inputFiles.size() != 1) {
+        std::cerr << "Errore: --reuse richiede un solo file di input" << std::endl;
+        return 1;
+    }
+    if (std::count(args.inputFiles.begin(), args.inputFiles.end(), STDIO_PATH) > 1) {
+        std::cerr << "Errore: stdin può essere usato una sola volta" << std::endl;
+        return 1;
+    }
+    
     // Imposta output path se non specificato
     if (args.outputPath.empty()) {
         args.outputPath = std::filesystem::current_path().string();
@@ -168,6 +526,9 @@ int main(int argc, char* argv[]) {
     
     // Verifica che i file di input esistano
     for (const auto& file : args.inputFiles) {
+        if (IsStdioPath(file)) {
+            continue;
+        }
         if (!std::filesystem::exists(file)) {
             std::cerr << "Errore: File non trovato: " << file << std::endl;
             return 1;
@@ -186,22 +547,22 @@ int main(int argc, char* argv[]) {
     
     // Imposta callback per progresso
     if (!args.quiet) {
-        compressor.SetProgressCallback([&args](int current, int total, const std::string& status) {
+        compressor.SetProgressCallback([&args, &out](int current, int total, const std::string& status) {
             if (args.verbose) {
-                std::cout << "[" << current << "/" << total << "] " << status << std::endl;
+                out << "[" << current << "/" << total << "] " << status << std::endl;
             } else {
                 // Barra di progresso semplice
                 int barWidth = 50;
                 int progress = (current * barWidth) / total;
-                std::cout << "\r[";
+                out << "\r[";
                 for (int i = 0; i < barWidth; ++i) {
-                    if (i < progress) std::cout << "=";
-                    else if (i == progress) std::cout << ">";
-                    else std::cout << " ";
+                    if (i < progress) out << "=";
+                    else if (i == progress) out << ">";
+                    else out << " ";
                 }
-                std::cout << "] " << current << "/" << total;
-                if (current == total) std::cout << std::endl;
-                std::cout.flush();
+                out << "] " << current << "/" << total;
+                if (current == total) out << std::endl;
+                out.flush();
             }
         });
     }
@@ -210,7 +571,30 @@ int main(int argc, char* argv[]) {
     compressor.SetErrorCallback([](const std::string& error) {
         std::cerr << "Errore: " << error << std::endl;
     });
+
+    g_jobControl = &compressor.GetJobControl();
+    std::signal(SIGINT, CancelSignalHandler);
+    std::signal(SIGTERM, CancelSignalHandler);
+#ifdef SIGBREAK
+    std::signal(SIGBREAK, CancelSignalHandler);     // Ctrl+Break, inviato dalla GUI su Windows
+#endif
     
+    // Modalità addestramento: nessuna compressione
+    if (!args.trainDictionary.empty()) {
+        compressor.SetDictionaryConfig(args.dictionaryConfig);
+        TaskStatus result = compressor.TrainDictionary(args.inputFiles, args.trainDictionary);
+        if (result == TASK_SUCCESS && !args.quiet) {
+            out << "Dizionario scritto: " << args.trainDictionary << " ("
+                << Utils::FormatBytes(Utils::GetFileSize(args.trainDictionary)) << ")" << std::endl;
+        }
+        return (result == TASK_SUCCESS) ? 0 : 1;
+    }
+    
+    // Modalità stima: nessun output, un rapporto per immagine
+    if (args.estimate) {
+        return RunEstimate(compressor, args);
+    }
+
     // Statistiche
     auto startTime = std::chrono::high_resolution_clock::now();
     int successCount = 0;
@@ -221,34 +605,53 @@ int main(int argc, char* argv[]) {
     // Processa ogni file
     for (const auto& inputFile : args.inputFiles) {
         if (!args.quiet) {
-            std::cout << "Comprimendo: " << inputFile << std::endl;
+            out << "Comprimendo: " << inputFile << std::endl;
         }
         
         // Calcola dimensione input
-        uint64_t inputSize = Utils::GetFileSize(inputFile);
+        uint64_t inputSize = IsStdioPath(inputFile) ? args.generalConfig.inputSize : Utils::GetFileSize(inputFile);
         totalInputSize += inputSize;
         
         // Genera nome output
         std::string outputFile = compressor.GenerateOutputFilename(inputFile, args.compressionType);
-        std::string fullOutputPath = args.outputPath + "/" + outputFile;
+        std::string fullOutputPath = args.toStdout ? STDIO_PATH : args.outputPath + "/" + outputFile;
         
         // Comprimi
         TaskStatus result = compressor.CompressFile(inputFile, fullOutputPath, args.compressionType);
         
         if (result == TASK_SUCCESS) {
             successCount++;
+            if (args.toStdout) {
+                // La dimensione dell'immagine emessa su stdout non si può rileggere
+                if (!args.quiet) {
+                    out << "Completato: stdout" << std::endl;
+                }
+                continue;
+            }
             uint64_t outputSize = Utils::GetFileSize(fullOutputPath);
             totalOutputSize += outputSize;
             
             if (!args.quiet) {
                 double ratio = 100.0 * (1.0 - static_cast<double>(outputSize) / inputSize);
-                std::cout << "Completato: " << outputFile 
-                         << " (riduzione: " << std::fixed << std::setprecision(1) << ratio << "%)" << std::endl;
+                out << "Completato: " << outputFile 
+                    << " (riduzione: " << std::fixed << std::setprecision(1) << ratio << "%)" << std::endl;
+            }
+        } else if (result == TASK_CANCELLED) {
+            errorCount++;
+            // Senza checkpoint l'output parziale non serve a nulla
+            bool resumable = !args.toStdout && Utils::FileExists(CompressionJournal::PathFor(fullOutputPath));
+            if (!resumable && !args.toStdout && !args.generalConfig.keepIncomplete) {
+                std::error_code ignored;
+                std::filesystem::remove(fullOutputPath, ignored);
+            }
+            if (!args.quiet) {
+                out << "Annullato: " << inputFile << (resumable ? " (riprendibile con --resume)" : "") << std::endl;
             }
+            break;
         } else {
             errorCount++;
             if (!args.quiet) {
-                std::cout << "Fallito: " << inputFile << std::endl;
+                out << "Fallito: " << inputFile << std::endl;
             }
         }
     }
@@ -258,19 +661,19 @@ int main(int argc, char* argv[]) {
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
     
     if (!args.quiet) {
-        std::cout << std::endl << "=== Riepilogo ===" << std::endl;
-        std::cout << "File processati: " << args.inputFiles.size() << std::endl;
-        std::cout << "Successi: " << successCount << std::endl;
-        std::cout << "Errori: " << errorCount << std::endl;
+        out << std::endl << "=== Riepilogo ===" << std::endl;
+        out << "File processati: " << args.inputFiles.size() << std::endl;
+        out << "Successi: " << successCount << std::endl;
+        out << "Errori: " << errorCount << std::endl;
         
-        if (successCount > 0) {
+        if (successCount > 0 && !args.toStdout) {
             double totalRatio = 100.0 * (1.0 - static_cast<double>(totalOutputSize) / totalInputSize);
-            std::cout << "Dimensione input: " << Utils::FormatBytes(totalInputSize) << std::endl;
-            std::cout << "Dimensione output: " << Utils::FormatBytes(totalOutputSize) << std::endl;
-            std::cout << "Riduzione totale: " << std::fixed << std::setprecision(1) << totalRatio << "%" << std::endl;
+            out << "Dimensione input: " << Utils::FormatBytes(totalInputSize) << std::endl;
+            out << "Dimensione output: " << Utils::FormatBytes(totalOutputSize) << std::endl;
+            out << "Riduzione totale: " << std::fixed << std::setprecision(1) << totalRatio << "%" << std::endl;
         }
         
-        std::cout << "Tempo impiegato: " << Utils::FormatTime(duration.count() / 1000.0) << std::endl;
+        out << "Tempo impiegato: " << Utils::FormatTime(duration.count() / 1000.0) << std::endl;
     }
     
     return (errorCount == 0) ? 0 : 1;
@@ -0,0 +1,117 @@
+#include "numa_placement.h"
+#include <vector>
+
+#ifdef HAVE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#include <unistd.h>
+#endif
+
+namespace UniversalCompressor {
+
+namespace Numa {
+
+#ifdef HAVE_NUMA
+
+// Id libnuma dei nodi con CPU, rilevati una volta sola
+static const std::vector<int>& Nodes() {
+    static const std::vector<int> nodes = [] {
+        std::vector<int> result;
+        if (numa_available() < 0) {
+            return result;
+        }
+        struct bitmask* cpus = numa_allocate_cpumask();
+        for (int node = 0; node <= numa_max_node(); ++node) {
+            if (numa_bitmask_isbitset(numa_all_nodes_ptr, node) &&
+                numa_node_to_cpus(node, cpus) == 0 && numa_bitmask_weight(cpus) > 0) {
+                result.push_back(node);
+            }
+        }
+        numa_bitmask_free(cpus);
+        return result;
+    }();
+    return nodes;
+}
+
+bool IsAvailable() {
+    return Nodes().size() > 1;
+}
+
+uint32_t NodeCount() {
+    return IsAvailable() ? static_cast<uint32_t>(Nodes().size()) : 1;
+}
+
+void BindThread(uint32_t node) {
+    if (!IsAvailable() || node >= Nodes().size()) {
+        return;
+    }
+    numa_run_on_node(Nodes()[node]);
+    numa_set_preferred(Nodes()[node]);
+}
+
+void PlaceMemory(void* data, size_t size, uint32_t node) {
+    if (!IsAvailable() || node >= Nodes().size() || size == 0) {
+        return;
+    }
+
+    // mbind lavora su pagine intere: i bordi parziali restano dove sono
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = (reinterpret_cast<uintptr_t>(data) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(page - 1);
+    if (end <= start) {
+        return;
+    }
+
+    struct bitmask* mask = numa_allocate_nodemask();
+    numa_bitmask_setbit(mask, Nodes()[node]);
+    // Pagine già toccate (buffer azzerati): vanno spostate, non solo vincolate
+    mbind(reinterpret_cast<void*>(start), end - start, MPOL_PREFERRED,
+          mask->maskp, mask->size + 1, MPOL_MF_MOVE);
+    numa_bitmask_free(mask);
+}
+
+NodeScope::NodeScope(bool enabled, uint32_t node) : runMask_(nullptr) {
+    if (!enabled || !IsAvailable() || node >= Nodes().size()) {
+        return;
+    }
+    runMask_ = numa_get_run_node_mask();
+    BindThread(node);
+}
+
+NodeScope::~NodeScope() {
+    if (!runMask_) {
+        return;
+    }
+    struct bitmask* mask = static_cast<struct bitmask*>(runMask_);
+    numa_run_on_node_mask(mask);
+    numa_bitmask_free(mask);
+    numa_set_localalloc();
+}
+
+#else
+
+bool IsAvailable() {
+    return false;
+}
+
+uint32_t NodeCount() {
+    return 1;
+}
+
+void BindThread(uint32_t) {
+}
+
+void PlaceMemory(void*, size_t, uint32_t) {
+}
+
+NodeScope::NodeScope(bool, uint32_t) : runMask_(nullptr) {
+}
+
+NodeScope::~NodeScope() {
+}
+
+#endif
+
+} // namespace Numa
+
+} // namespace UniversalCompressor
@@ -0,0 +1,50 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace UniversalCompressor {
+
+// Posizionamento di thread e memoria sui nodi NUMA (libnuma, HAVE_NUMA).
+// I nodi sono numerati da 0 a NodeCount() - 1 e contano solo quelli con CPU.
+// Senza libnuma, o su una macchina a un solo nodo, c'è un nodo e le funzioni
+// non fanno nulla.
+namespace Numa {
+
+// libnuma presente e più di un nodo con CPU utilizzabili
+bool IsAvailable();
+uint32_t NodeCount();
+
+// Parte di appartenenza dell'elemento index su count elementi divisi in
+// shards parti contigue (es. worker o porzioni di un lotto per nodo)
+inline uint32_t ShardOf(uint32_t index, uint32_t count, uint32_t shards) {
+    return (count == 0) ? 0 : static_cast<uint32_t>(static_cast<uint64_t>(index) * shards / count);
+}
+
+// Limita il thread corrente ai CPU del nodo e ne preferisce la memoria
+void BindThread(uint32_t node);
+
+// Sposta sul nodo le pagine interamente contenute nell'intervallo
+void PlaceMemory(void* data, size_t size, uint32_t node);
+
+// Per la durata dello scope il thread corrente gira sul nodo, così i buffer
+// e i contesti codec creati (e azzerati) qui vengono allocati localmente.
+// Alla fine ripristina CPU e politica di memoria precedenti.
+class NodeScope {
+public:
+    NodeScope(bool enabled, uint32_t node);
+    ~NodeScope();
+
+    NodeScope(const NodeScope&) = delete;
+    NodeScope& operator=(const NodeScope&) = delete;
+
+private:
+    void* runMask_;     // struct bitmask* di libnuma, nullptr = nessun cambio
+};
+
+} // namespace Numa
+
+} // namespace UniversalCompressor
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,111 @@
+#include "sha1.h"
+#include <algorithm>
+#include <cstring>
+
+namespace UniversalCompressor {
+
+static inline uint32_t Rotate(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+SHA1::SHA1() {
+    Reset();
+}
+
+void SHA1::Reset() {
+    memset(&state_, 0, sizeof(state_));
+    state_.h[0] = 0x67452301;
+    state_.h[1] = 0xEFCDAB89;
+    state_.h[2] = 0x98BADCFE;
+    state_.h[3] = 0x10325476;
+    state_.h[4] = 0xC3D2E1F0;
+}
+
+void SHA1::Update(const uint8_t* data, size_t size) {
+    state_.length += size;
+
+    // Completa il blocco parziale rimasto dalla chiamata precedente
+    if (state_.bufferSize > 0) {
+        size_t fill = std::min<size_t>(64 - state_.bufferSize, size);
+        memcpy(state_.buffer + state_.bufferSize, data, fill);
+        state_.bufferSize += static_cast<uint32_t>(fill);
+        data += fill;
+        size -= fill;
+        if (state_.bufferSize < 64) {
+            return;
+        }
+        Transform(state_.buffer);
+        state_.bufferSize = 0;
+    }
+
+    for (; size >= 64; data += 64, size -= 64) {
+        Transform(data);
+    }
+
+    memcpy(state_.buffer, data, size);
+    state_.bufferSize = static_cast<uint32_t>(size);
+}
+
+void SHA1::Final(uint8_t digest[DIGEST_SIZE]) {
+    uint64_t bitLength = state_.length * 8;
+
+    // Padding: 0x80, zeri fino a 56 mod 64, lunghezza big-endian
+    uint8_t padding[72] = {0x80};
+    size_t padSize = (state_.bufferSize < 56) ? 56 - state_.bufferSize : 120 - state_.bufferSize;
+    for (int i = 0; i < 8; ++i) {
+        padding[padSize + i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+    }
+    Update(padding, padSize + 8);
+
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4 + 0] = static_cast<uint8_t>(state_.h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state_.h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state_.h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state_.h[i]);
+    }
+}
+
+void SHA1::Transform(const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) |
+               (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+               (static_cast<uint32_t>(block[i * 4 + 2]) << 8) |
+               static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 80; ++i) {
+        w[i] = Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state_.h[0], b = state_.h[1], c = state_.h[2], d = state_.h[3], e = state_.h[4];
+    for (int i = 0; i < 80; ++i) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = Rotate(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = Rotate(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state_.h[0] += a;
+    state_.h[1] += b;
+    state_.h[2] += c;
+    state_.h[3] += d;
+    state_.h[4] += e;
+}
+
+} // namespace UniversalCompressor
@@ -0,0 +1,40 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace UniversalCompressor {
+
+// Stato SHA-1 serializzabile (nessun padding: può essere salvato così com'è)
+struct SHA1State {
+    uint64_t length;        // byte elaborati
+    uint32_t h[5];
+    uint32_t bufferSize;
+    uint8_t buffer[64];
+};
+
+// SHA-1 incrementale con stato esportabile, per riprendere un digest
+// interrotto senza rileggere i dati già elaborati
+class SHA1 {
+public:
+    static const size_t DIGEST_SIZE = 20;
+
+    SHA1();
+
+    void Reset();
+    void Update(const uint8_t* data, size_t size);
+    void Final(uint8_t digest[DIGEST_SIZE]);
+
+    const SHA1State& GetState() const { return state_; }
+    void SetState(const SHA1State& state) { state_ = state; }
+
+private:
+    void Transform(const uint8_t block[64]);
+
+    SHA1State state_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // SHA1_H
@@ -0,0 +1,298 @@
+#include "stream_io.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace UniversalCompressor {
+
+// Blocco usato per scartare input e copiare lo spool su stdout
+static const size_t STREAM_COPY_CHUNK = 1024 * 1024;
+
+// fseek/ftell a 64 bit: le immagini DVD superano i 2 GB
+static int Seek64(FILE* file, uint64_t offset, int origin = SEEK_SET) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), origin);
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+static int64_t Tell64(FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+// Su Windows stdin/stdout sono in modalità testo per default
+static void SetBinaryMode(FILE* file) {
+#ifdef _WIN32
+    _setmode(_fileno(file), _O_BINARY);
+#else
+    (void)file;
+#endif
+}
+
+InputStream::InputStream()
+    : file_(nullptr), ownsFile_(false), seekable_(false), size_(0), position_(0) {
+}
+
+InputStream::~InputStream() {
+    Close();
+}
+
+bool InputStream::Open(const std::string& path, uint64_t declaredSize) {
+    Close();
+    lastError_.clear();
+
+    if (IsStdioPath(path)) {
+        SetBinaryMode(stdin);
+        file_ = stdin;
+        ownsFile_ = false;
+    } else {
+        file_ = fopen(path.c_str(), "rb");
+        ownsFile_ = true;
+        if (!file_) {
+            lastError_ = "Non posso aprire " + path;
+            return false;
+        }
+    }
+
+    // stdin rediretto da file resta seekable; pipe e socket no
+    int64_t end = (Seek64(file_, 0, SEEK_END) == 0) ? Tell64(file_) : -1;
+    seekable_ = end >= 0 && Seek64(file_, 0) == 0;
+    if (seekable_) {
+        size_ = static_cast<uint64_t>(end);
+    } else if (declaredSize > 0) {
+        size_ = declaredSize;
+    } else {
+        lastError_ = "Input non seekable: specificare la dimensione con --size";
+        Close();
+        return false;
+    }
+
+    position_ = 0;
+    return true;
+}
+
+void InputStream::Open(std::unique_ptr<InputSource> source) {
+    Close();
+    lastError_.clear();
+    source_ = std::move(source);
+    seekable_ = true;
+    size_ = source_->GetSize();
+}
+
+void InputStream::Close() {
+    if (file_ && ownsFile_) {
+        fclose(file_);
+    }
+    file_ = nullptr;
+    source_.reset();
+    ownsFile_ = false;
+    seekable_ = false;
+    size_ = 0;
+    position_ = 0;
+}
+
+size_t InputStream::ReadAt(uint64_t offset, void* buffer, size_t size) {
+    if ((!file_ && !source_) || offset >= size_) {
+        return 0;
+    }
+    size = static_cast<size_t>(std::min<uint64_t>(size, size_ - offset));
+    if (source_) {
+        return source_->ReadAt(offset, buffer, size);
+    }
+
+    if (offset != position_) {
+        if (seekable_) {
+            if (Seek64(file_, offset) != 0) {
+                return 0;
+            }
+        } else {
+            if (offset < position_) {
+                return 0;
+            }
+            // Pipe: scarta i byte fino all'offset richiesto
+            std::vector<uint8_t> discard(static_cast<size_t>(std::min<uint64_t>(offset - position_, STREAM_COPY_CHUNK)));
+            while (position_ < offset) {
+                size_t chunk = static_cast<size_t>(std::min<uint64_t>(offset - position_, discard.size()));
+                size_t skipped = fread(discard.data(), 1, chunk, file_);
+                position_ += skipped;
+                if (skipped < chunk) {
+                    return 0;
+                }
+            }
+        }
+        position_ = offset;
+    }
+
+    // fread su una pipe può restituire meno byte solo a fine flusso o per errore
+    size_t bytesRead = fread(buffer, 1, size, file_);
+    position_ += bytesRead;
+    return bytesRead;
+}
+
+bool InputStream::CheckEnd() {
+    if (!file_ || seekable_) {
+        return true;
+    }
+    uint8_t extra;
+    return position_ >= size_ && fread(&extra, 1, 1, file_) == 0;
+}
+
+// Output diretto su file
+class FileOutputStream : public OutputStream {
+public:
+    explicit FileOutputStream(FILE* file) : file_(file) {}
+
+    ~FileOutputStream() override {
+        if (file_) {
+            fclose(file_);
+        }
+    }
+
+    bool Write(const void* data, size_t size) override {
+        return fwrite(data, 1, size, file_) == size;
+    }
+
+    bool Seek(uint64_t offset) override {
+        return Seek64(file_, offset) == 0;
+    }
+
+    bool Sync() override {
+        if (fflush(file_) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file_)) == 0;
+#else
+        return fsync(fileno(file_)) == 0;
+#endif
+    }
+
+    bool Finish() override {
+        // fclose segnala gli errori di scrittura rimasti nel buffer
+        int result = fclose(file_);
+        file_ = nullptr;
+        return result == 0;
+    }
+
+private:
+    FILE* file_;
+};
+
+// Output su stdout tramite spool ad accesso casuale
+class SpoolOutputStream : public OutputStream {
+public:
+    SpoolOutputStream() : spill_(nullptr), position_(0), spillPos_(0), size_(0) {}
+
+    ~SpoolOutputStream() override {
+        if (spill_) {
+            fclose(spill_);
+        }
+    }
+
+    bool Write(const void* data, size_t size) override {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        // Inizio del file in memoria: header e indice vengono riscritti spesso qui
+        if (position_ < STREAM_SPOOL_MEMORY) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, STREAM_SPOOL_MEMORY - position_));
+            if (memory_.size() < position_ + chunk) {
+                memory_.resize(static_cast<size_t>(position_ + chunk));
+            }
+            memcpy(memory_.data() + position_, bytes, chunk);
+            position_ += chunk;
+            bytes += chunk;
+            size -= chunk;
+        }
+
+        // Il resto va nel file temporaneo, rimosso automaticamente alla chiusura
+        if (size > 0) {
+            if (!spill_ && !(spill_ = tmpfile())) {
+                return false;
+            }
+            uint64_t spillOffset = position_ - STREAM_SPOOL_MEMORY;
+            if (spillOffset != spillPos_ && Seek64(spill_, spillOffset) != 0) {
+                return false;
+            }
+            if (fwrite(bytes, 1, size, spill_) != size) {
+                return false;
+            }
+            position_ += size;
+            spillPos_ = spillOffset + size;
+        }
+
+        size_ = std::max(size_, position_);
+        return true;
+    }
+
+    bool Seek(uint64_t offset) override {
+        position_ = offset;
+        return true;
+    }
+
+    bool Sync() override {
+        // Niente da rendere persistente: lo spool non sopravvive al processo
+        return true;
+    }
+
+    bool Finish() override {
+        SetBinaryMode(stdout);
+
+        // Le zone mai scritte (salti con Seek) valgono zero come in un file
+        memory_.resize(static_cast<size_t>(std::min<uint64_t>(size_, STREAM_SPOOL_MEMORY)));
+        if (!memory_.empty() && fwrite(memory_.data(), 1, memory_.size(), stdout) != memory_.size()) {
+            return false;
+        }
+
+        if (size_ > STREAM_SPOOL_MEMORY) {
+            if (!spill_ || fflush(spill_) != 0 || Seek64(spill_, 0) != 0) {
+                return false;
+            }
+            std::vector<uint8_t> chunk(STREAM_COPY_CHUNK);
+            uint64_t remaining = size_ - STREAM_SPOOL_MEMORY;
+            while (remaining > 0) {
+                size_t toCopy = static_cast<size_t>(std::min<uint64_t>(remaining, chunk.size()));
+                size_t copied = fread(chunk.data(), 1, toCopy, spill_);
+                // Un file temporaneo più corto ha solo zeri in coda
+                std::fill(chunk.begin() + copied, chunk.begin() + toCopy, 0);
+                if (fwrite(chunk.data(), 1, toCopy, stdout) != toCopy) {
+                    return false;
+                }
+                remaining -= toCopy;
+            }
+        }
+
+        return fflush(stdout) == 0;
+    }
+
+private:
+    std::vector<uint8_t> memory_;
+    FILE* spill_;
+    uint64_t position_;
+    uint64_t spillPos_;     // posizione corrente nel file temporaneo
+    uint64_t size_;
+};
+
+std::unique_ptr<OutputStream> OutputStream::Open(const std::string& path, bool resume) {
+    if (IsStdioPath(path)) {
+        return std::make_unique<SpoolOutputStream>();
+    }
+
+    FILE* file = fopen(path.c_str(), resume ? "r+b" : "wb");
+    if (!file) {
+        return nullptr;
+    }
+    return std::make_unique<FileOutputStream>(file);
+}
+
+} // namespace UniversalCompressor
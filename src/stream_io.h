@@ -0,0 +1,91 @@
+#ifndef STREAM_IO_H
+#define STREAM_IO_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Nome che indica stdin come input o stdout come output
+static const char* const STDIO_PATH = "-";
+
+// Dati dell'output per stdout tenuti in memoria prima di usare un file temporaneo
+static const size_t STREAM_SPOOL_MEMORY = 64 * 1024 * 1024;
+
+inline bool IsStdioPath(const std::string& path) {
+    return path == STDIO_PATH;
+}
+
+// Dati di un InputStream prodotti da codice anziché letti da un file, ad
+// esempio l'immagine decompressa da un CSO o da un CHD (vedi image_source.h)
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+
+    virtual uint64_t GetSize() const = 0;
+    virtual size_t ReadAt(uint64_t offset, void* buffer, size_t size) = 0;
+};
+
+// Input letto in ordine crescente di offset: un file normale, stdin o una
+// InputSource. Su una pipe non si può tornare indietro né conoscere la
+// dimensione, che va dichiarata all'apertura (--size).
+class InputStream {
+public:
+    InputStream();
+    ~InputStream();
+
+    InputStream(const InputStream&) = delete;
+    InputStream& operator=(const InputStream&) = delete;
+
+    bool Open(const std::string& path, uint64_t declaredSize = 0);
+    void Open(std::unique_ptr<InputSource> source);   // ad accesso casuale
+    void Close();
+
+    bool IsSeekable() const { return seekable_; }
+    uint64_t GetSize() const { return size_; }
+    const std::string& GetLastError() const { return lastError_; }
+
+    // Legge fino a size byte da offset senza superare la dimensione dell'input.
+    // Sulle pipe offset può solo avanzare: i byte saltati vengono scartati.
+    size_t ReadAt(uint64_t offset, void* buffer, size_t size);
+
+    // Vero se l'input non contiene altri dati oltre la dimensione dichiarata
+    bool CheckEnd();
+
+private:
+    FILE* file_;
+    std::unique_ptr<InputSource> source_;
+    bool ownsFile_;
+    bool seekable_;
+    uint64_t size_;
+    uint64_t position_;
+    std::string lastError_;
+};
+
+// Output con accesso casuale. Su file scrive direttamente; su stdout raccoglie
+// tutto in uno spool (memoria fino a STREAM_SPOOL_MEMORY, poi file temporaneo)
+// ed emette il file completo in Finish, così header e indice possono essere
+// aggiornati alla fine come per un file normale.
+class OutputStream {
+public:
+    virtual ~OutputStream() = default;
+
+    // STDIO_PATH = stdout; resume riapre un file esistente senza troncarlo
+    static std::unique_ptr<OutputStream> Open(const std::string& path, bool resume = false);
+
+    virtual bool Write(const void* data, size_t size) = 0;
+    virtual bool Seek(uint64_t offset) = 0;
+
+    // Forza su disco i dati scritti (prima di un checkpoint del journal)
+    virtual bool Sync() = 0;
+
+    // Completa l'output; se non viene chiamato l'output su stdout è scartato
+    virtual bool Finish() = 0;
+};
+
+} // namespace UniversalCompressor
+
+#endif // STREAM_IO_H
@@ -1,7 +1,13 @@
 #include "universal_compressor.h"
+#include "auto_tuner.h"
 #include "cso_compressor.h"
 #include "chd_compressor.h"
+#include "dictionary_trainer.h"
+#include "journal.h"
+#include "stream_io.h"
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <iostream>
 #include <chrono>
 #include <algorithm>
@@ -9,8 +15,7 @@
 
 namespace UniversalCompressor {
 
-UniversalCompressor::UniversalCompressor() 
-    : cancelled_(false) {
+UniversalCompressor::UniversalCompressor() : workerPool_(nullptr), bufferPool_(nullptr) {
     // Configurazioni di default
     csoConfig_ = CSOConfig{};
     chdConfig_ = CHDConfig{};
@@ -33,6 +38,15 @@ void UniversalCompressor::SetGeneralConfig(const GeneralConfig& config) {
     generalConfig_ = config;
 }
 
+void UniversalCompressor::SetDictionaryConfig(const DictionaryConfig& config) {
+    dictionaryConfig_ = config;
+}
+
+void UniversalCompressor::SetSharedPools(WorkerPool* threads, BufferPool* buffers) {
+    workerPool_ = threads;
+    bufferPool_ = buffers;
+}
+
 void UniversalCompressor::SetProgressCallback(ProgressCallback callback) {
     progressCallback_ = callback;
 }
@@ -44,9 +58,12 @@ void UniversalCompressor::SetErrorCallback(ErrorCallback callback) {
 TaskStatus UniversalCompressor::CompressFile(const std::string& inputFile, 
                                            const std::string& outputFile, 
                                            CompressionType type) {
-    cancelled_ = false;
     lastError_.clear();
 
+    if (control_.IsCancelled()) {
+        return TASK_CANCELLED;
+    }
+
     // Validazione input
     if (!ValidateInput(inputFile)) {
         lastError_ = "File di input non valido o non esistente: " + inputFile;
@@ -65,6 +82,27 @@ TaskStatus UniversalCompressor::CompressFile(const std::string& inputFile,
         return TASK_ERROR;
     }
 
+    // Il file da riusare viene letto durante la scrittura: non può essere l'output
+    std::error_code sameFile;
+    if (!generalConfig_.reuseFile.empty() && !IsStdioPath(outputFile) &&
+        std::filesystem::equivalent(generalConfig_.reuseFile, outputFile, sameFile)) {
+        lastError_ = "L'output coincide con il file di --reuse: " + outputFile;
+        if (errorCallback_) {
+            errorCallback_(lastError_);
+        }
+        return TASK_ERROR;
+    }
+
+    // Un CSO o CHD in input viene letto mentre si scrive l'output (transcodifica)
+    if (!IsStdioPath(inputFile) && !IsStdioPath(outputFile) &&
+        std::filesystem::equivalent(inputFile, outputFile, sameFile)) {
+        lastError_ = "L'output coincide con l'input: " + outputFile;
+        if (errorCallback_) {
+            errorCallback_(lastError_);
+        }
+        return TASK_ERROR;
+    }
+
     // Notifica inizio
     if (progressCallback_) {
         progressCallback_(0, 100, "Iniziando compressione...");
@@ -94,7 +132,7 @@ TaskStatus UniversalCompressor::CompressFile(const std::string& inputFile,
         }
 
         // Elimina file di input se richiesto
-        if (generalConfig_.deleteInputFiles) {
+        if (generalConfig_.deleteInputFiles && !IsStdioPath(inputFile)) {
             try {
                 std::filesystem::remove(inputFile);
             } catch (const std::exception& e) {
@@ -112,8 +150,6 @@ TaskStatus UniversalCompressor::CompressFile(const std::string& inputFile,
 TaskStatus UniversalCompressor::CompressFiles(const std::vector<std::string>& inputFiles,
                                             const std::string& outputDir,
                                             CompressionType type) {
-    cancelled_ = false;
-    
     if (inputFiles.empty()) {
         lastError_ = "Nessun file di input specificato";
         if (errorCallback_) {
@@ -137,7 +173,7 @@ TaskStatus UniversalCompressor::CompressFiles(const std::vector<std::string>& in
     int completedFiles = 0;
     int failedFiles = 0;
 
-    for (int i = 0; i < totalFiles && !cancelled_; ++i) {
+    for (int i = 0; i < totalFiles && !control_.IsCancelled(); ++i) {
         const std::string& inputFile = inputFiles[i];
         
         // Genera nome file di output
@@ -158,7 +194,11 @@ TaskStatus UniversalCompressor::CompressFiles(const std::vector<std::string>& in
             completedFiles++;
         } else {
             failedFiles++;
-            if (!generalConfig_.keepIncomplete) {
+            // Con un checkpoint valido l'output parziale serve a --resume
+            bool resumable = Utils::FileExists(CompressionJournal::PathFor(fullOutputPath));
+            std::error_code sameFile;
+            bool isInput = std::filesystem::equivalent(inputFile, fullOutputPath, sameFile);
+            if (!generalConfig_.keepIncomplete && !resumable && !isInput) {
                 // Rimuovi file di output incompleto
                 try {
                     std::filesystem::remove(fullOutputPath);
@@ -170,7 +210,7 @@ TaskStatus UniversalCompressor::CompressFiles(const std::vector<std::string>& in
     }
 
     // Risultato finale
-    if (cancelled_) {
+    if (control_.IsCancelled()) {
         return TASK_CANCELLED;
     } else if (failedFiles == 0) {
         return TASK_SUCCESS;
@@ -184,9 +224,123 @@ TaskStatus UniversalCompressor::CompressFiles(const std::vector<std::string>& in
     }
 }
 
+TaskStatus UniversalCompressor::EstimateFile(const std::string& inputFile, CompressionType type,
+                                             uint32_t strata, CompressionEstimate& estimate) {
+    lastError_.clear();
+    if (!ValidateInput(inputFile)) {
+        lastError_ = "File di input non valido o non esistente: " + inputFile;
+        if (errorCallback_) {
+            errorCallback_(lastError_);
+        }
+        return TASK_ERROR;
+    }
+
+    try {
+        // Con --auto si stimano i parametri che la compressione userebbe
+        TaskStatus result;
+        std::string summary;
+        auto tuned = [&summary](const AutoTuner& tuner, bool ok) {
+            if (!ok) {
+                std::cerr << "Avviso: --auto ignorato: " << tuner.GetLastError() << std::endl;
+            } else {
+                summary = tuner.GetSummary();
+            }
+        };
+        if (type == COMPRESSION_CHD) {
+            CHDConfig config = chdConfig_;
+            if (generalConfig_.autoTune.enabled) {
+                AutoTuner tuner(generalConfig_.autoTune);
+                tuned(tuner, tuner.TuneCHD(inputFile, config));
+            }
+            CHDCompressor compressor(config);
+            compressor.SetDeclaredInputSize(generalConfig_.inputSize);
+            compressor.SetJobControl(&control_);
+            compressor.SetSharedPools(workerPool_, bufferPool_);
+            result = compressor.Estimate(inputFile, strata, estimate);
+        } else {
+            CSOConfig config = csoConfig_;
+            if (generalConfig_.autoTune.enabled) {
+                AutoTuner tuner(generalConfig_.autoTune);
+                tuned(tuner, tuner.TuneCSO(inputFile, config));
+            }
+            CSOCompressor compressor(config);
+            compressor.SetDeclaredInputSize(generalConfig_.inputSize);
+            compressor.SetJobControl(&control_);
+            compressor.SetSharedPools(workerPool_, bufferPool_);
+            result = compressor.Estimate(inputFile, strata, estimate);
+        }
+        estimate.summary = summary;
+        return result;
+    } catch (const std::exception& e) {
+        lastError_ = "Errore durante la stima: " + std::string(e.what());
+        if (errorCallback_) {
+            errorCallback_(lastError_);
+        }
+        return TASK_ERROR;
+    }
+}
+
+TaskStatus UniversalCompressor::TrainDictionary(const std::vector<std::string>& inputFiles,
+                                               const std::string& outputFile) {
+    lastError_.clear();
+    DictionaryTrainer trainer(dictionaryConfig_);
+
+    int totalFiles = static_cast<int>(inputFiles.size());
+    for (int i = 0; i < totalFiles; ++i) {
+        if (progressCallback_) {
+            progressCallback_(i * 100 / totalFiles, 100, "Campionando " + Utils::GetFileBasename(inputFiles[i]));
+        }
+        if (!ValidateInput(inputFiles[i]) || !trainer.AddSamples(inputFiles[i])) {
+            lastError_ = "Impossibile campionare: " + inputFiles[i];
+            if (errorCallback_) {
+                errorCallback_(lastError_);
+            }
+            return TASK_ERROR;
+        }
+    }
+
+    std::vector<uint8_t> dictionary;
+    if (!trainer.Train(dictionary)) {
+        lastError_ = trainer.GetLastError();
+        if (errorCallback_) {
+            errorCallback_(lastError_);
+        }
+        return TASK_ERROR;
+    }
+
+    std::ofstream file(outputFile, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(dictionary.data()), dictionary.size())) {
+        lastError_ = "Impossibile scrivere il dizionario: " + outputFile;
+        if (errorCallback_) {
+            errorCallback_(lastError_);
+        }
+        return TASK_ERROR;
+    }
+
+    if (progressCallback_) {
+        progressCallback_(100, 100, "Dizionario di " + Utils::FormatBytes(dictionary.size()) + " da " +
+                          std::to_string(trainer.GetSampleCount()) + " blocchi");
+    }
+    return TASK_SUCCESS;
+}
+
 TaskStatus UniversalCompressor::CompressToCSO(const std::string& inputFile, const std::string& outputFile) {
     try {
-        CSOCompressor compressor(csoConfig_);
+        // --auto: parametri scelti sui blocchi campionati di questa immagine
+        CSOConfig config = csoConfig_;
+        if (generalConfig_.autoTune.enabled) {
+            ReportProgress("Scelta automatica dei parametri...");
+            AutoTuner tuner(generalConfig_.autoTune);
+            ReportAutoTune(tuner, tuner.TuneCSO(inputFile, config));
+        }
+
+        CSOCompressor compressor(config);
+        compressor.SetCheckpointOptions(generalConfig_.checkpointInterval, generalConfig_.resume);
+        compressor.SetDeclaredInputSize(generalConfig_.inputSize);
+        compressor.SetReuseFile(generalConfig_.reuseFile);
+        compressor.SetCacheDirectory(generalConfig_.cacheDirectory);
+        compressor.SetJobControl(&control_);
+        compressor.SetSharedPools(workerPool_, bufferPool_);
         
         // Imposta callback se disponibili
         if (progressCallback_) {
@@ -207,7 +361,20 @@ TaskStatus UniversalCompressor::CompressToCSO(const std::string& inputFile, cons
 
 TaskStatus UniversalCompressor::CompressToCHD(const std::string& inputFile, const std::string& outputFile) {
     try {
-        CHDCompressor compressor(chdConfig_);
+        CHDConfig config = chdConfig_;
+        if (generalConfig_.autoTune.enabled) {
+            ReportProgress("Scelta automatica dei parametri...");
+            AutoTuner tuner(generalConfig_.autoTune);
+            ReportAutoTune(tuner, tuner.TuneCHD(inputFile, config));
+        }
+
+        CHDCompressor compressor(config);
+        compressor.SetCheckpointOptions(generalConfig_.checkpointInterval, generalConfig_.resume);
+        compressor.SetDeclaredInputSize(generalConfig_.inputSize);
+        compressor.SetReuseFile(generalConfig_.reuseFile);
+        compressor.SetCacheDirectory(generalConfig_.cacheDirectory);
+        compressor.SetJobControl(&control_);
+        compressor.SetSharedPools(workerPool_, bufferPool_);
         
         // Imposta callback se disponibili
         if (progressCallback_) {
@@ -226,7 +393,29 @@ TaskStatus UniversalCompressor::CompressToCHD(const std::string& inputFile, cons
     }
 }
 
+void UniversalCompressor::ReportProgress(const std::string& status) {
+    if (progressCallback_) {
+        progressCallback_(0, 100, status);
+    }
+}
+
+void UniversalCompressor::ReportAutoTune(const AutoTuner& tuner, bool tuned) {
+    // Senza campioni (pipe, immagine minuscola) restano i parametri indicati
+    if (!tuned) {
+        std::cerr << "Avviso: --auto ignorato: " << tuner.GetLastError() << std::endl;
+        return;
+    }
+    if (!tuner.IsTargetReached()) {
+        std::cerr << "Avviso: obiettivo di --auto non raggiungibile, scelta l'alternativa più vicina" << std::endl;
+    }
+    ReportProgress(tuner.GetSummary());
+}
+
 bool UniversalCompressor::ValidateInput(const std::string& inputFile) {
+    // stdin viene validato all'apertura (serve --size se è una pipe)
+    if (IsStdioPath(inputFile)) {
+        return true;
+    }
     return Utils::FileExists(inputFile) && IsValidInputFile(inputFile);
 }
 
@@ -246,14 +435,14 @@ bool UniversalCompressor::ValidateOutput(const std::string& outputFile) {
 }
 
 std::string UniversalCompressor::GenerateOutputFilename(const std::string& inputFile, CompressionType type) {
-    std::string basename = Utils::GetFileBasename(inputFile);
+    std::string basename = IsStdioPath(inputFile) ? "stdin" : Utils::GetFileBasename(inputFile);
     std::string extension = GetOutputExtension(type, csoConfig_.format);
     return basename + extension;
 }
 
 // Funzioni statiche
 std::vector<std::string> UniversalCompressor::GetSupportedInputFormats() {
-    return {".iso", ".bin", ".img", ".cue", ".toc", ".gdi"};
+    return {".iso", ".bin", ".img", ".cue", ".toc", ".gdi", ".cso", ".zso", ".zcso", ".chd"};
 }
 
 std::string UniversalCompressor::GetOutputExtension(CompressionType type, CSOFormat csoFormat) {
@@ -267,6 +456,8 @@ std::string UniversalCompressor::GetOutputExtension(CompressionType type, CSOFor
                     return ".zso";
                 case CSO_FORMAT_DAX:
                     return ".dax";
+                case CSO_FORMAT_ZCSO:
+                    return ".zcso";
                 default:
                     return ".cso";
             }
@@ -317,6 +508,15 @@ uint64_t GetFileSize(const std::string& filename) {
     }
 }
 
+bool ReadFileData(const std::string& filename, std::vector<uint8_t>& data) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
 std::string FormatBytes(uint64_t bytes) {
     const char* units[] = {"B", "KB", "MB", "GB", "TB"};
     int unit = 0;
@@ -1,6 +1,7 @@
 #ifndef UNIVERSAL_COMPRESSOR_H
 #define UNIVERSAL_COMPRESSOR_H
 
+#include "job_control.h"
 #include <string>
 #include <vector>
 #include <functional>
@@ -9,6 +10,10 @@
 
 namespace UniversalCompressor {
 
+class AutoTuner;
+class BufferPool;
+class WorkerPool;
+
 // Versione dell'applicazione
 static const char* VERSION = "1.0.0";
 
@@ -23,7 +28,8 @@ enum CSOFormat {
     CSO_FORMAT_CSO1,
     CSO_FORMAT_CSO2,
     CSO_FORMAT_ZSO,
-    CSO_FORMAT_DAX
+    CSO_FORMAT_DAX,
+    CSO_FORMAT_ZCSO     // variante CSO con blocchi zstd (e LZ4) per decoder moderni
 };
 
 // Algoritmi di compressione CSO
@@ -32,7 +38,20 @@ enum CSOAlgorithm {
     CSO_ALG_7ZIP    = 0x02,
     CSO_ALG_ZOPFLI  = 0x04,
     CSO_ALG_LZ4     = 0x08,
-    CSO_ALG_LIBDEFLATE = 0x10
+    CSO_ALG_LIBDEFLATE = 0x10,
+    CSO_ALG_ZSTD    = 0x20
+};
+
+// Codec dei blocchi non-LZ4 nel formato ZCSO (campo unused[0] dell'header)
+enum ZCSOCodec {
+    ZCSO_CODEC_ZSTD    = 0,
+    ZCSO_CODEC_DEFLATE = 1      // deflate raw, utile con un dizionario preset
+};
+
+// Tipo di dizionario addestrato
+enum DictionaryType {
+    DICTIONARY_ZSTD,    // dizionario zstd completo (tabelle entropiche + contenuto)
+    DICTIONARY_RAW      // solo contenuto: preset deflate/LZ4 (o zstd raw)
 };
 
 // Codec CHD
@@ -40,7 +59,8 @@ enum CHDCodec {
     CHD_CODEC_NONE   = 0x00,
     CHD_CODEC_CDLZ   = 0x01,
     CHD_CODEC_CDZL   = 0x02,
-    CHD_CODEC_CDFL   = 0x04
+    CHD_CODEC_CDFL   = 0x04,
+    CHD_CODEC_ZSTD   = 0x08
 };
 
 // Status delle operazioni
@@ -55,11 +75,17 @@ enum TaskStatus {
 struct CSOConfig {
     CSOFormat format = CSO_FORMAT_CSO1;
     uint32_t blockSize = 0;  // 0 = auto
-    uint32_t algorithms = CSO_ALG_ZLIB | CSO_ALG_7ZIP;
+    uint32_t algorithms = CSO_ALG_ZLIB | CSO_ALG_7ZIP | CSO_ALG_LIBDEFLATE | CSO_ALG_ZSTD;
     uint32_t threads = 4;
     bool fastMode = false;
-    double origCostPercent = 100.0;
+    double origCostPercent = 90.0;   // 90 = compressi solo se sotto il 90% del blocco
     double lz4CostPercent = 100.0;
+    int zstdLevel = 0;               // 0 = livello del profilo zstd
+    int lz4Level = 0;                // > 0 = livello LZ4 HC, < 0 = accelerazione LZ4 veloce, 0 = dal profilo
+    ZCSOCodec zcsoCodec = ZCSO_CODEC_ZSTD;
+    std::string dictionary;          // dizionario dei blocchi ZCSO, salvato nel file (opzionale)
+    bool fileAnalysis = true;        // classifica i blocchi dai file ISO9660/UDF
+    bool numa = false;               // worker, buffer e porzioni dei lotti per nodo NUMA
 };
 
 // Configurazione per compressione CHD
@@ -69,6 +95,50 @@ struct CHDConfig {
     uint32_t processors = 4;
     bool force = true;
     std::string template_name;
+    int zstdLevel = 0;               // 0 = livello del profilo zstd
+    std::string zstdDictionary;      // dizionario zstd addestrato (opzionale)
+    bool fileAnalysis = true;        // classifica gli hunk dai file ISO9660/UDF
+    bool numa = false;               // worker e finestra degli hunk per nodo NUMA
+};
+
+// Configurazione per l'addestramento dei dizionari
+struct DictionaryConfig {
+    DictionaryType type = DICTIONARY_ZSTD;
+    uint32_t size = 0;               // 0 = 64 KB per zstd, 32 KB (finestra deflate) per raw
+    uint32_t blockSize = 2048;       // dimensione dei blocchi campionati
+    uint32_t samplesPerFile = 4096;  // blocchi campionati da ogni immagine
+};
+
+// Obiettivo della scelta automatica dei parametri (--auto)
+enum AutoObjective {
+    AUTO_BALANCED,      // il più veloce entro l'1% del rapporto migliore
+    AUTO_MAX_RATIO,     // rapporto massimo con velocità >= target MB/s
+    AUTO_MIN_TIME       // tempo minimo con rapporto (originale/compresso) >= target
+};
+
+// Configurazione di --auto: codec, livelli, dimensione hunk e thread scelti
+// per ogni immagine provando le alternative su blocchi campionati
+struct AutoTuneConfig {
+    bool enabled = false;
+    AutoObjective objective = AUTO_BALANCED;
+    double target = 0.0;
+    uint32_t samples = 256;          // porzioni campionate nell'immagine
+};
+
+// Risultato di --estimate: output e tempo di compressione estrapolati dai
+// blocchi campionati, con intervallo di confidenza al 95%
+struct CompressionEstimate {
+    uint64_t inputSize = 0;
+    uint64_t sampleBytes = 0;        // byte compressi davvero
+    uint32_t strata = 0;
+    uint64_t outputSize = 0;
+    uint64_t outputLow = 0;
+    uint64_t outputHigh = 0;
+    uint32_t threads = 0;
+    double seconds = 0.0;            // sola compressione con threads thread, lettura esclusa
+    double secondsLow = 0.0;
+    double secondsHigh = 0.0;
+    std::string summary;             // parametri usati (con --auto, quelli scelti)
 };
 
 // Configurazione generale
@@ -78,6 +148,12 @@ struct GeneralConfig {
     bool createSubDir = false;
     bool keepIncomplete = false;
     bool verbose = false;
+    uint32_t checkpointInterval = 60;   // secondi tra i checkpoint del journal, 0 = disabilitati
+    bool resume = false;                // riprende dal journal se valido
+    uint64_t inputSize = 0;             // dimensione dell'input da pipe (--size)
+    std::string reuseFile;              // output precedente da cui copiare i blocchi (--reuse)
+    std::string cacheDirectory;         // cache dei blocchi compressi tra le immagini (--cache)
+    AutoTuneConfig autoTune;            // parametri scelti per immagine (--auto)
 };
 
 // Callback per progresso
@@ -108,6 +184,11 @@ public:
     void SetCSOConfig(const CSOConfig& config);
     void SetCHDConfig(const CHDConfig& config);
     void SetGeneralConfig(const GeneralConfig& config);
+    void SetDictionaryConfig(const DictionaryConfig& config);
+
+    // Thread e buffer condivisi tra i lavori (daemon), passati ai motori CSO e
+    // CHD; nullptr = ogni lavoro crea e libera i propri
+    void SetSharedPools(WorkerPool* threads, BufferPool* buffers);
 
     // Operazioni di compressione
     TaskStatus CompressFile(const std::string& inputFile, 
@@ -118,10 +199,24 @@ public:
                             const std::string& outputDir,
                             CompressionType type);
 
+    // Stima dimensione dell'output e tempo senza scrivere nulla (--estimate):
+    // strata porzioni dell'immagine passano per il percorso di compressione reale
+    TaskStatus EstimateFile(const std::string& inputFile, CompressionType type,
+                            uint32_t strata, CompressionEstimate& estimate);
+
+    // Addestra un dizionario condiviso campionando i blocchi delle immagini
+    TaskStatus TrainDictionary(const std::vector<std::string>& inputFiles,
+                               const std::string& outputFile);
+
     // Callback per monitoraggio
     void SetProgressCallback(ProgressCallback callback);
     void SetErrorCallback(ErrorCallback callback);
 
+    // Annullamento e pausa, anche da un altro thread. L'annullamento vale
+    // anche per i lavori successivi finché non si chiama GetJobControl().Reset()
+    void Cancel() { control_.Cancel(); }
+    JobControl& GetJobControl() { return control_; }
+
     // Utility
     static std::vector<std::string> GetSupportedInputFormats();
     static std::string GetOutputExtension(CompressionType type, CSOFormat csoFormat = CSO_FORMAT_CSO1);
@@ -135,19 +230,24 @@ private:
 
     // Utilità interne
     bool ValidateInput(const std::string& inputFile);
+    void ReportProgress(const std::string& status);
+    void ReportAutoTune(const AutoTuner& tuner, bool tuned);
     bool ValidateOutput(const std::string& outputFile);
 
     // Configurazioni
     CSOConfig csoConfig_;
     CHDConfig chdConfig_;
     GeneralConfig generalConfig_;
+    DictionaryConfig dictionaryConfig_;
 
     // Callback
     ProgressCallback progressCallback_;
     ErrorCallback errorCallback_;
 
     // Stato interno
-    bool cancelled_;
+    JobControl control_;
+    WorkerPool* workerPool_;
+    BufferPool* bufferPool_;
     std::string lastError_;
 };
 
@@ -158,6 +258,7 @@ namespace Utils {
     std::string GetFileDirectory(const std::string& filename);
     bool FileExists(const std::string& filename);
     uint64_t GetFileSize(const std::string& filename);
+    bool ReadFileData(const std::string& filename, std::vector<uint8_t>& data);
     std::string FormatBytes(uint64_t bytes);
     std::string FormatTime(double seconds);
 }
@@ -0,0 +1,308 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define UC_CPU_RELAX() _mm_pause()
+#else
+#define UC_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace UniversalCompressor {
+
+// Attesa tra gli stadi della pipeline: qualche giro attivo (un passaggio tra
+// stadi dura pochi microsecondi), poi sospensione sul condvar. Chi pubblica
+// un dato tocca il mutex solo se qualcuno sta davvero dormendo, quindi nel
+// caso normale un passaggio costa un paio di operazioni atomiche.
+class StageWaiter {
+public:
+    StageWaiter() : sleepers_(0) {}
+
+    template <typename Ready>
+    void Wait(Ready ready) {
+        for (int spin = 0; spin < SPIN_ROUNDS; ++spin) {
+            if (ready()) {
+                return;
+            }
+            if (spin < SPIN_ROUNDS / 2) {
+                UC_CPU_RELAX();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        // Dopo l'annuncio: o si vede il dato, o chi lo pubblica vede sleepers_
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!ready()) {
+            wakeup_.wait(lock);
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Da chiamare dopo aver pubblicato il dato atteso
+    void Notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_all();
+        }
+    }
+
+private:
+    static const int SPIN_ROUNDS = 128;
+
+    std::atomic<int> sleepers_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
+
+// Coda circolare limitata a più produttori e più consumatori, senza lock
+// (schema a numeri di sequenza per cella di D. Vyukov). Pensata per
+// descrittori piccoli copiati per valore: i dati restano nei buffer dei lotti.
+template <typename T>
+class BoundedQueue {
+public:
+    // La capacità viene arrotondata alla potenza di 2 successiva
+    explicit BoundedQueue(size_t capacity)
+        : enqueuePos_(0), dequeuePos_(0), closed_(false) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // false = coda piena
+    bool TryPush(const T& value) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        notEmpty_.Notify();
+        return true;
+    }
+
+    // false = coda vuota
+    bool TryPop(T& value) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->value;
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        notFull_.Notify();
+        return true;
+    }
+
+    // Bloccanti: false = coda chiusa (gli elementi rimasti vengono scartati)
+    bool Push(const T& value) {
+        for (;;) {
+            if (closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (TryPush(value)) {
+                return true;
+            }
+            notFull_.Wait([this] { return CanPush() || closed_.load(std::memory_order_acquire); });
+        }
+    }
+
+    bool Pop(T& value) {
+        for (;;) {
+            if (closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (TryPop(value)) {
+                return true;
+            }
+            notEmpty_.Wait([this] { return CanPop() || closed_.load(std::memory_order_acquire); });
+        }
+    }
+
+    // Risveglia e congeda tutti i produttori e i consumatori in attesa
+    void Close() {
+        closed_.store(true, std::memory_order_release);
+        notEmpty_.Notify();
+        notFull_.Notify();
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    bool CanPush() const {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos;
+    }
+
+    bool CanPop() const {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    // Su linee di cache distinte: produttori e consumatori non si contendono la stessa
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) std::atomic<size_t> dequeuePos_;
+    std::atomic<bool> closed_;
+    StageWaiter notEmpty_;
+    StageWaiter notFull_;
+};
+
+// Una BoundedQueue per shard (es. per nodo NUMA): ogni consumatore serve la
+// propria e prende da quelle degli altri solo quando la sua è vuota. Con un
+// solo shard equivale a una BoundedQueue.
+template <typename T>
+class ShardedQueue {
+public:
+    ShardedQueue(uint32_t shards, size_t capacity) {
+        for (uint32_t i = 0; i < shards; ++i) {
+            shards_.push_back(std::make_unique<BoundedQueue<T>>(capacity));
+        }
+    }
+
+    bool Push(uint32_t shard, const T& value) {
+        return shards_[shard % shards_.size()]->Push(value);
+    }
+
+    bool Pop(uint32_t shard, T& value) {
+        BoundedQueue<T>& own = *shards_[shard % shards_.size()];
+        if (own.TryPop(value)) {
+            return true;
+        }
+        for (auto& other : shards_) {
+            if (other.get() != &own && other->TryPop(value)) {
+                return true;
+            }
+        }
+        return own.Pop(value);
+    }
+
+    void Close() {
+        for (auto& queue : shards_) {
+            queue->Close();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<BoundedQueue<T>>> shards_;
+};
+
+// Riordino dei risultati: i worker depositano gli elementi per indice in
+// qualsiasi ordine, un solo consumatore (lo scrittore) li ritira in ordine
+// crescente. Un produttore attende solo se il suo indice supera la finestra
+// di capacità elementi oltre il prossimo da ritirare.
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t capacity, uint64_t first = 0)
+        : next_(first) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        slots_.reset(new Slot[size]);
+        for (size_t i = 0; i < size; ++i) {
+            slots_[i].ready.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+    void Put(uint64_t index, const T& value) {
+        space_.Wait([this, index] { return index <= next_.load(std::memory_order_acquire) + mask_; });
+        Slot& slot = slots_[index & mask_];
+        slot.value = value;
+        slot.ready.store(index + 1, std::memory_order_release);
+        available_.Notify();
+    }
+
+    // Solo il consumatore: false se il prossimo elemento non è ancora arrivato
+    bool TryTake(T& value) {
+        uint64_t index = next_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[index & mask_];
+        if (slot.ready.load(std::memory_order_acquire) != index + 1) {
+            return false;
+        }
+        value = slot.value;
+        next_.store(index + 1, std::memory_order_release);
+        space_.Notify();
+        return true;
+    }
+
+    void Take(T& value) {
+        while (!TryTake(value)) {
+            uint64_t index = next_.load(std::memory_order_relaxed);
+            const Slot& slot = slots_[index & mask_];
+            available_.Wait([&slot, index] { return slot.ready.load(std::memory_order_acquire) == index + 1; });
+        }
+    }
+
+    // Indice del prossimo elemento da ritirare
+    uint64_t Next() const { return next_.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> ready;    // indice + 1 dell'elemento presente
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<uint64_t> next_;
+    StageWaiter available_;
+    StageWaiter space_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // WORK_QUEUE_H
@@ -0,0 +1,183 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace UniversalCompressor {
+
+WorkerPool::WorkerPool() : idle_(0), stopping_(false) {
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Submit(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+
+    // Ogni compito ha il suo thread: uno in attesa o uno nuovo
+    if (idle_ > 0) {
+        --idle_;
+        ready_.notify_one();
+    } else {
+        threads_.emplace_back(&WorkerPool::ThreadLoop, this);
+    }
+}
+
+size_t WorkerPool::GetThreadCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return threads_.size();
+}
+
+void WorkerPool::ThreadLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+            return;
+        }
+        std::function<void()> task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+
+        task();
+
+        lock.lock();
+        ++idle_;
+    }
+}
+
+void WorkerGroup::Start(std::function<void()> task) {
+    ++started_;
+    if (!pool_) {
+        threads_.emplace_back(std::move(task));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++running_;
+    }
+    pool_->Submit([this, task = std::move(task)] {
+        task();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--running_ == 0) {
+            done_.notify_all();
+        }
+    });
+}
+
+void WorkerGroup::Join() {
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    started_ = 0;
+}
+
+BufferPool::NodeCache& BufferPool::Node(uint32_t node) {
+    if (node >= nodes_.size()) {
+        nodes_.resize(node + 1);
+    }
+    return nodes_[node];
+}
+
+std::vector<uint8_t> BufferPool::TakeBuffer(size_t size, uint32_t node) {
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& buffers = Node(node).buffers;
+        auto best = buffers.end();
+        // Oltre il doppio il buffer resta ai lavori che ne usano di grandi
+        for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+            if (it->capacity() >= size && it->capacity() / 2 <= size &&
+                (best == buffers.end() || it->capacity() < best->capacity())) {
+                best = it;
+            }
+        }
+        if (best != buffers.end()) {
+            buffer = std::move(*best);
+            buffers.erase(best);
+        }
+    }
+    // Un buffer nuovo viene toccato qui, sul nodo del thread chiamante
+    buffer.resize(size);
+    return buffer;
+}
+
+void BufferPool::ReturnBuffer(std::vector<uint8_t>&& buffer, uint32_t node) {
+    if (buffer.capacity() == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Node(node).buffers.push_back(std::move(buffer));
+}
+
+std::unique_ptr<CodecArena> BufferPool::TakeArena(uint32_t node) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& arenas = Node(node).arenas;
+    if (arenas.empty()) {
+        return std::make_unique<CodecArena>();
+    }
+    std::unique_ptr<CodecArena> arena = std::move(arenas.back());
+    arenas.pop_back();
+    return arena;
+}
+
+void BufferPool::ReturnArena(std::unique_ptr<CodecArena>&& arena, uint32_t node) {
+    if (!arena) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Node(node).arenas.push_back(std::move(arena));
+}
+
+size_t BufferPool::GetRetainedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto& node : nodes_) {
+        for (const auto& buffer : node.buffers) {
+            total += buffer.capacity();
+        }
+        for (const auto& arena : node.arenas) {
+            total += arena->GetMappedBytes();
+        }
+    }
+    return total;
+}
+
+void BufferPool::Acquire(BufferPool* pool, std::vector<uint8_t>& buffer, size_t size, uint32_t node) {
+    if (!pool || size == 0) {
+        buffer.assign(size, 0);
+        return;
+    }
+    buffer = pool->TakeBuffer(size, node);
+}
+
+void BufferPool::Release(BufferPool* pool, std::vector<uint8_t>& buffer, uint32_t node) {
+    if (pool) {
+        pool->ReturnBuffer(std::move(buffer), node);
+    }
+    std::vector<uint8_t>().swap(buffer);
+}
+
+std::unique_ptr<CodecArena> BufferPool::AcquireArena(BufferPool* pool, uint32_t node) {
+    return pool ? pool->TakeArena(node) : std::make_unique<CodecArena>();
+}
+
+void BufferPool::ReleaseArena(BufferPool* pool, std::unique_ptr<CodecArena>& arena, uint32_t node) {
+    if (pool) {
+        pool->ReturnArena(std::move(arena), node);
+    }
+    arena.reset();
+}
+
+} // namespace UniversalCompressor
@@ -0,0 +1,115 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "codec_arena.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace UniversalCompressor {
+
+// Thread di lavoro che sopravvivono ai lavori (daemon): un compito va a un
+// thread libero e se non ce ne sono se ne crea uno, che poi resta in attesa
+// del compito successivo. I worker di un motore restano occupati per tutto il
+// lavoro, quindi il pool cresce fino al massimo di worker contemporanei e non
+// fa mai attendere un lavoro per un thread.
+class WorkerPool {
+public:
+    WorkerPool();
+    ~WorkerPool();      // attende i compiti in corso e termina i thread
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(std::function<void()> task);
+
+    size_t GetThreadCount() const;
+
+private:
+    void ThreadLoop();
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    size_t idle_;           // thread in attesa non ancora destinati a un compito
+    bool stopping_;
+};
+
+// Worker di un motore per la durata di un lavoro: sul pool se presente,
+// altrimenti thread propri come nella CLI
+class WorkerGroup {
+public:
+    explicit WorkerGroup(WorkerPool* pool = nullptr) : pool_(pool), started_(0), running_(0) {}
+    ~WorkerGroup() { Join(); }
+
+    WorkerGroup(const WorkerGroup&) = delete;
+    WorkerGroup& operator=(const WorkerGroup&) = delete;
+
+    void SetPool(WorkerPool* pool) { pool_ = pool; }
+
+    // Start, Join e IsEmpty solo dal thread che possiede il gruppo
+    void Start(std::function<void()> task);
+    void Join();
+    bool IsEmpty() const { return started_ == 0; }
+
+private:
+    WorkerPool* pool_;
+    size_t started_;        // compiti avviati dall'ultimo Join
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t running_;        // compiti sul pool non ancora terminati
+};
+
+// Buffer e arene dei codec riusati tra i lavori (daemon): a fine lavoro i
+// motori li restituiscono invece di liberarli, così il lavoro successivo non
+// rialloca né ritocca la memoria. Separati per nodo NUMA, perché la memoria
+// resta dove è stata toccata la prima volta. Trattiene al massimo quanto
+// serviva ai lavori contemporanei più grandi.
+class BufferPool {
+public:
+    BufferPool() = default;
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // size byte, contenuto non definito: il più piccolo buffer che basta (fino
+    // al doppio di size) o uno nuovo
+    std::vector<uint8_t> TakeBuffer(size_t size, uint32_t node = 0);
+    void ReturnBuffer(std::vector<uint8_t>&& buffer, uint32_t node = 0);
+
+    // Arena vuota (tutti i contesti che la usavano sono stati distrutti)
+    std::unique_ptr<CodecArena> TakeArena(uint32_t node = 0);
+    void ReturnArena(std::unique_ptr<CodecArena>&& arena, uint32_t node = 0);
+
+    size_t GetRetainedBytes() const;
+
+    // Per i motori: con pool nullptr (CLI) il buffer viene allocato azzerato
+    // e liberato, l'arena creata e distrutta
+    static void Acquire(BufferPool* pool, std::vector<uint8_t>& buffer, size_t size, uint32_t node = 0);
+    static void Release(BufferPool* pool, std::vector<uint8_t>& buffer, uint32_t node = 0);
+    static std::unique_ptr<CodecArena> AcquireArena(BufferPool* pool, uint32_t node = 0);
+    static void ReleaseArena(BufferPool* pool, std::unique_ptr<CodecArena>& arena, uint32_t node = 0);
+
+private:
+    struct NodeCache {
+        std::vector<std::vector<uint8_t>> buffers;
+        std::vector<std::unique_ptr<CodecArena>> arenas;
+    };
+
+    NodeCache& Node(uint32_t node);
+
+    mutable std::mutex mutex_;
+    std::vector<NodeCache> nodes_;
+};
+
+} // namespace UniversalCompressor
+
+#endif // WORKER_POOL_H